@@ -0,0 +1,39 @@
+// Shared layout of the broadcast SHM ring (one writer, many readers)
+//
+// The publisher and every subscriber map the same segment, so both binaries
+// take the header from here. Each SubscriberSlot owns a whole cache line and
+// `head` sits on its own, so one reader's cursor store never invalidates the
+// line another reader or the publisher is polling.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t MSG_SIZE = 64;
+constexpr size_t RING_SIZE = 1024;
+constexpr size_t MAX_SUBSCRIBERS = 16;
+constexpr size_t CACHE_LINE = 128;
+
+struct alignas(CACHE_LINE) SubscriberSlot {
+    std::atomic<uint32_t> active; // 0 = not reading, 1 = attached, 2 = registering
+    std::atomic<int32_t> pid;     // Owning process, 0 = free; used to reap crashed readers
+    std::atomic<uint64_t> cursor; // Next sequence this subscriber will read
+};
+
+struct ShmHeader {
+    alignas(CACHE_LINE) std::atomic<uint64_t> head; // Producer index
+    alignas(CACHE_LINE) std::atomic<bool> initialized; // Initialization flag
+    SubscriberSlot subs[MAX_SUBSCRIBERS];
+    // messages follow
+};
+
+static_assert(sizeof(SubscriberSlot) == CACHE_LINE, "one subscriber slot per cache line");
+static_assert(sizeof(ShmHeader) % CACHE_LINE == 0, "messages must start on a cache line");
+
+struct ShmMsg {
+    uint64_t seq;
+    uint64_t t_ns;
+    char payload[MSG_SIZE - 16];
+};
@@ -0,0 +1,282 @@
+// SHM Broadcast Publisher: one writer, many readers over a single ring
+// Usage: ./shm_broadcast_publisher <shm_name> <count> [min_subscribers] [--stream]
+//
+// Each subscriber registers in the slot table in the header and keeps its own
+// read cursor. The publisher writes every message exactly once and applies
+// back-pressure based on the slowest registered cursor.
+//
+// By default every message waits until all readers have consumed it (fan-out
+// RTT). --stream publishes back to back instead, so the ring fills and only
+// the slowest reader holds the writer back; it reports how often and for how
+// long the ring was full, and which slot was the slowest each time.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/clock.hpp"
+#include "../common/stats.hpp"
+#include "shm_broadcast.hpp"
+
+using namespace std;
+using pubsub::now_ns;
+using ns = chrono::nanoseconds;
+using clk = chrono::high_resolution_clock;
+
+constexpr size_t MAX_BACKOFF = 1000; // Maximum backoff iterations
+constexpr uint64_t REAP_INTERVAL_NS = 50000000; // Stall time between checks for dead subscribers
+
+class ExponentialBackoff {
+private:
+    int current_delay;
+    int max_delay;
+
+public:
+    ExponentialBackoff(int initial = 1, int max = MAX_BACKOFF)
+        : current_delay(initial), max_delay(max) {}
+
+    void wait() {
+        for (int i = 0; i < current_delay; ++i) {
+            std::this_thread::yield();
+        }
+        current_delay = min(current_delay * 2, max_delay);
+    }
+
+    void reset() {
+        current_delay = 1;
+    }
+};
+
+// Slowest cursor among attached subscribers; returns `head` when nobody is attached.
+// `slowest_slot` gets the slot holding it, or MAX_SUBSCRIBERS if none is behind.
+static uint64_t min_cursor(ShmHeader* hdr, uint64_t head, size_t* attached = nullptr,
+                           size_t* slowest_slot = nullptr) {
+    uint64_t slowest = head;
+    size_t n = 0, at = MAX_SUBSCRIBERS;
+    for (size_t s = 0; s < MAX_SUBSCRIBERS; ++s) {
+        if (hdr->subs[s].active.load(memory_order_seq_cst) != 1) continue;
+        uint64_t cursor = hdr->subs[s].cursor.load(memory_order_acquire);
+        if (cursor < slowest) slowest = cursor, at = s;
+        ++n;
+    }
+    if (attached) *attached = n;
+    if (slowest_slot) *slowest_slot = at;
+    return slowest;
+}
+
+// Release slots whose owner has exited without detaching, so a crashed reader
+// cannot stall the publisher forever.
+// A slot is owned from the moment its pid is set, whatever `active` says.
+static void reap_dead_subscribers(ShmHeader* hdr) {
+    for (size_t s = 0; s < MAX_SUBSCRIBERS; ++s) {
+        pid_t pid = hdr->subs[s].pid.load(memory_order_acquire);
+        if (pid > 0 && kill(pid, 0) < 0 && errno == ESRCH) {
+            cerr << "Reaping dead subscriber pid=" << pid << " in slot " << s << "\n";
+            hdr->subs[s].active.store(0, memory_order_release);
+            hdr->subs[s].pid.store(0, memory_order_release);
+        }
+    }
+}
+
+// Reaps dead subscribers every REAP_INTERVAL_NS of one stall. Going by elapsed
+// time rather than poll count keeps the bound independent of the backoff.
+class ReapTimer {
+private:
+    uint64_t deadline = 0;
+
+public:
+    void poll(ShmHeader* hdr) {
+        uint64_t t = now_ns();
+        if (deadline == 0) {
+            deadline = t + REAP_INTERVAL_NS;
+        } else if (t >= deadline) {
+            reap_dead_subscribers(hdr);
+            deadline = t + REAP_INTERVAL_NS;
+        }
+    }
+};
+
+// Streaming: no per-message wait, so the publisher only stops when it is
+// RING_SIZE ahead of the slowest reader. Ends once every reader has drained.
+static void run_stream(ShmHeader* hdr, ShmMsg* msgs, uint64_t count) {
+    ExponentialBackoff backoff;
+    uint64_t head = hdr->head.load(memory_order_acquire);
+    uint64_t end = head + count;
+    uint64_t cached_min = min_cursor(hdr, head);
+    uint64_t full_waits = 0, stall_ns = 0;
+    uint64_t throttled[MAX_SUBSCRIBERS] = {}; // Full-ring waits per slowest slot
+
+    auto start = clk::now();
+    while (head < end) {
+        if (head - cached_min >= RING_SIZE) {
+            size_t slowest = MAX_SUBSCRIBERS;
+            cached_min = min_cursor(hdr, head, nullptr, &slowest);
+            if (head - cached_min >= RING_SIZE) {
+                ++full_waits;
+                if (slowest < MAX_SUBSCRIBERS) ++throttled[slowest];
+                uint64_t stall_start = now_ns();
+                ReapTimer reap;
+                while (head - cached_min >= RING_SIZE) {
+                    reap.poll(hdr);
+                    backoff.wait();
+                    cached_min = min_cursor(hdr, head);
+                }
+                backoff.reset();
+                stall_ns += now_ns() - stall_start;
+            }
+        }
+
+        ShmMsg &m = msgs[head % RING_SIZE];
+        m.seq = head;
+        m.t_ns = now_ns();
+        hdr->head.store(++head, memory_order_release);
+    }
+
+    // Drain: the run is over once the slowest reader has caught up
+    size_t attached = 0;
+    ReapTimer reap;
+    while (min_cursor(hdr, head, &attached) < head) {
+        reap.poll(hdr);
+        backoff.wait();
+    }
+    double elapsed_s = chrono::duration<double>(clk::now() - start).count();
+
+    cout << "SHM broadcast stream subscribers=" << attached
+         << " count=" << count
+         << " elapsed_s=" << elapsed_s
+         << " msgs_per_sec=" << (count / elapsed_s)
+         << " full_waits=" << full_waits
+         << " stall_ms=" << stall_ns / 1e6
+         << " throttled_by=";
+    const char* sep = "";
+    for (size_t s = 0; s < MAX_SUBSCRIBERS; ++s) {
+        if (!throttled[s]) continue;
+        cout << sep << "slot" << s << ":" << throttled[s];
+        sep = ",";
+    }
+    if (!*sep) cout << "none";
+    cout << "\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <shm_name> <count> [min_subscribers] [--stream]\n";
+        return 1;
+    }
+
+    string name = "/tmp/" + string(argv[1]);
+    int count = stoi(argv[2]);
+    size_t min_subscribers = 1;
+    bool stream = false;
+    for (int a = 3; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "--stream") stream = true;
+        else if (arg.rfind("--", 0) != 0) min_subscribers = stoul(arg);
+        else {
+            cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    size_t total_size = sizeof(ShmHeader) + RING_SIZE * sizeof(ShmMsg);
+
+    // Use a regular file for shared memory on macOS
+    int fd = open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) { perror("open"); return 1; }
+
+    if (ftruncate(fd, total_size) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return 1;
+    }
+
+    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap"); return 1; }
+
+    auto hdr = reinterpret_cast<ShmHeader*>(base);
+    auto msgs = reinterpret_cast<ShmMsg*>((char*)base + sizeof(ShmHeader));
+
+    // Initialize header if first time
+    bool expected = false;
+    if (hdr->initialized.compare_exchange_strong(expected, true)) {
+        hdr->head.store(0, memory_order_relaxed);
+    }
+
+    ExponentialBackoff backoff;
+
+    // Wait for the requested number of readers before measuring
+    cout << "Waiting for " << min_subscribers << " subscriber(s) on " << name << "\n";
+    while (true) {
+        size_t attached = 0;
+        min_cursor(hdr, hdr->head.load(memory_order_acquire), &attached);
+        if (attached >= min_subscribers) break;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    if (stream) {
+        run_stream(hdr, msgs, count);
+        munmap(base, total_size);
+        close(fd);
+        return 0;
+    }
+
+    pubsub::Histogram rtts; // ns
+
+    uint64_t head = hdr->head.load(memory_order_acquire);
+    uint64_t cached_min = min_cursor(hdr, head);
+    size_t attached = 0;
+
+    for (uint64_t i = 0; i < (uint64_t)count; ++i) {
+        // Wait for space: only the slowest reader can hold the ring back
+        ReapTimer reap;
+        while (head - cached_min >= RING_SIZE) {
+            cached_min = min_cursor(hdr, head);
+            if (head - cached_min < RING_SIZE) break;
+            reap.poll(hdr);
+            backoff.wait();
+        }
+        backoff.reset();
+
+        ShmMsg &m = msgs[head % RING_SIZE];
+        m.seq = head;
+        uint64_t send_ns = now_ns();
+        m.t_ns = send_ns;
+
+        // One release store makes the message visible to every reader
+        hdr->head.store(++head, memory_order_release);
+
+        // Wait until every attached reader has consumed it (fan-out RTT)
+        reap = ReapTimer();
+        while (true) {
+            cached_min = min_cursor(hdr, head, &attached);
+            if (cached_min >= head) break;
+            reap.poll(hdr);
+            backoff.wait();
+        }
+        backoff.reset();
+
+        uint64_t recv_ns = now_ns();
+        rtts.record(recv_ns - send_ns);
+    }
+
+    cout << "SHM broadcast pub subscribers=" << attached;
+    pubsub::print_rtt_fields(cout, pubsub::summarize(rtts));
+    cout << "\n";
+
+    munmap(base, total_size);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,159 @@
+// SHM Broadcast Subscriber: attaches to a broadcast ring with its own cursor
+// Usage: ./shm_broadcast_subscriber <shm_name> [--slow-us=N]
+//
+// Any number of subscribers (up to MAX_SUBSCRIBERS) may attach to the same
+// ring; each one sees every message published after it registered.
+//
+// --slow-us=N  spend N µs on each message, to play the slow reader that
+//              throttles shm_broadcast_publisher --stream
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../common/clock.hpp"
+#include "shm_broadcast.hpp"
+
+using namespace std;
+using pubsub::now_ns;
+using ns = chrono::nanoseconds;
+using clk = chrono::high_resolution_clock;
+
+constexpr size_t MAX_BACKOFF = 1000; // Maximum backoff iterations
+
+class ExponentialBackoff {
+private:
+    int current_delay;
+    int max_delay;
+
+public:
+    ExponentialBackoff(int initial = 1, int max = MAX_BACKOFF)
+        : current_delay(initial), max_delay(max) {}
+
+    void wait() {
+        for (int i = 0; i < current_delay; ++i) {
+            std::this_thread::yield();
+        }
+        current_delay = min(current_delay * 2, max_delay);
+    }
+
+    void reset() {
+        current_delay = 1;
+    }
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int) { stop_requested = 1; }
+
+// Claim a free slot and start reading at the current head. The slot is taken
+// by CASing our pid into it, so the publisher can reap it from the first
+// instant even if we die mid-registration. The cursor is parked before the
+// slot goes active and re-read after, so the publisher never sees an active
+// slot whose cursor is ahead of what it may overwrite.
+static int register_subscriber(ShmHeader* hdr) {
+    int32_t self = getpid();
+    for (size_t s = 0; s < MAX_SUBSCRIBERS; ++s) {
+        int32_t expected = 0;
+        if (!hdr->subs[s].pid.compare_exchange_strong(expected, self, memory_order_acq_rel)) continue;
+        hdr->subs[s].active.store(2, memory_order_relaxed);
+        hdr->subs[s].cursor.store(hdr->head.load(memory_order_acquire), memory_order_relaxed);
+        hdr->subs[s].active.store(1, memory_order_seq_cst);
+        hdr->subs[s].cursor.store(hdr->head.load(memory_order_seq_cst), memory_order_release);
+        return (int)s;
+    }
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <shm_name> [--slow-us=N]\n";
+        return 1;
+    }
+
+    string name = "/tmp/" + string(argv[1]);
+    uint64_t slow_ns = 0;
+    for (int a = 2; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg.rfind("--slow-us=", 0) == 0) slow_ns = stoull(arg.substr(10)) * 1000;
+        else {
+            cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    size_t total_size = sizeof(ShmHeader) + RING_SIZE * sizeof(ShmMsg);
+
+    int fd = open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) { perror("open"); return 1; }
+
+    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap"); return 1; }
+
+    auto hdr = reinterpret_cast<ShmHeader*>(base);
+    auto msgs = reinterpret_cast<ShmMsg*>((char*)base + sizeof(ShmHeader));
+
+    int slot = register_subscriber(hdr);
+    if (slot < 0) {
+        cerr << "No free subscriber slot (max " << MAX_SUBSCRIBERS << ")\n";
+        return 1;
+    }
+    SubscriberSlot& me = hdr->subs[slot];
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    cout << "shm_broadcast_sub started on " << name << " slot=" << slot << "\n";
+
+    ExponentialBackoff backoff;
+    uint64_t cursor = me.cursor.load(memory_order_relaxed);
+    uint64_t cached_head = hdr->head.load(memory_order_acquire);
+    uint64_t processed_count = 0;
+
+    while (!stop_requested) {
+        if (cursor == cached_head) {
+            cached_head = hdr->head.load(memory_order_acquire);
+            if (cursor == cached_head) {
+                backoff.wait();
+                continue;
+            }
+        }
+
+        // Drain everything published so far without reloading head
+        while (cursor < cached_head) {
+            ShmMsg &m = msgs[cursor % RING_SIZE];
+            (void)m; // Process: just consume the message
+            if (slow_ns) {
+                uint64_t start = now_ns();
+                while (now_ns() - start < slow_ns) { /* busy-wait: simulated per-message work */ }
+            }
+            ++cursor;
+            me.cursor.store(cursor, memory_order_release);
+            processed_count++;
+
+            if (processed_count % 1000 == 0) {
+                cout << "Processed " << processed_count << " messages\n";
+            }
+        }
+        backoff.reset();
+    }
+
+    // Detach so the publisher stops waiting on this cursor
+    me.active.store(0, memory_order_release);
+    me.pid.store(0, memory_order_release);
+    cout << "shm_broadcast_sub slot=" << slot << " detached after " << processed_count << " messages\n";
+
+    munmap(base, total_size);
+    close(fd);
+    return 0;
+}
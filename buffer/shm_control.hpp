@@ -0,0 +1,175 @@
+// Versioned control block and process lifecycle for the improved SHM ring
+//
+// The control block sits at offset 0 of the segment, ahead of the ring
+// header. It records what the segment holds (magic, version, layout, slot
+// size, capacity) and who is using it (publisher/subscriber pid + heartbeat).
+//
+// Publisher start: claim the publisher slot (refused if a live publisher owns
+// it). A compatible segment is resumed as-is -- the publisher continues from
+// the stored head, so nothing already published is lost -- otherwise the ring
+// is reset. Either way `generation` is bumped.
+//
+// Subscriber: wait for the segment and a live publisher, claim the subscriber
+// slot, consume from the stored tail. If the publisher dies or the generation
+// changes, drain what is left, unmap and attach again.
+//
+// Liveness is "pid exists and heartbeat younger than HEARTBEAT_TIMEOUT", which
+// also catches hung processes and recycled pids.
+
+#pragma once
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+constexpr uint64_t SEGMENT_MAGIC = 0x314d485342555350ULL; // "PSUBSHM1"
+constexpr uint32_t SEGMENT_VERSION = 2; // Bump on any change to the segment layout
+constexpr size_t CONTROL_ALIGN = 128;
+constexpr auto HEARTBEAT_INTERVAL = std::chrono::milliseconds(100);
+constexpr auto HEARTBEAT_TIMEOUT = std::chrono::milliseconds(1000);
+constexpr auto ATTACH_POLL = std::chrono::milliseconds(10);
+
+struct PeerSlot {
+    std::atomic<int32_t> pid;           // 0 when unclaimed
+    std::atomic<uint64_t> heartbeat_ns; // monotonic_ns() of the last beat
+    std::atomic<uint64_t> generation;   // Generation this peer is attached to
+};
+
+// What the ring after the control block looks like
+struct SegmentGeometry {
+    uint32_t layout;
+    uint32_t slot_size;
+    uint64_t capacity;
+    uint32_t wait_strategy; // wait_strategy_id(); both sides must block the same way
+};
+
+struct ControlBlock {
+    alignas(CONTROL_ALIGN) std::atomic<uint64_t> magic; // SEGMENT_MAGIC once the fields below are valid
+    std::atomic<uint64_t> generation; // Bumped on every publisher (re)start
+    uint32_t version;
+    SegmentGeometry geometry;
+    alignas(CONTROL_ALIGN) PeerSlot publisher;
+    alignas(CONTROL_ALIGN) PeerSlot subscriber;
+};
+
+// CLOCK_MONOTONIC is system-wide, so heartbeats compare across processes
+inline uint64_t monotonic_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline bool process_alive(pid_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+inline bool peer_alive(const PeerSlot& slot) {
+    pid_t pid = slot.pid.load(std::memory_order_acquire);
+    uint64_t beat = slot.heartbeat_ns.load(std::memory_order_relaxed);
+    uint64_t timeout_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(HEARTBEAT_TIMEOUT).count();
+    return process_alive(pid) && monotonic_ns() - beat < timeout_ns;
+}
+
+// True once the subscriber is alive and attached to the current generation
+inline bool subscriber_ready(const ControlBlock& ctl) {
+    return peer_alive(ctl.subscriber) &&
+           ctl.subscriber.generation.load(std::memory_order_acquire) ==
+               ctl.generation.load(std::memory_order_acquire);
+}
+
+inline bool geometry_matches(const ControlBlock& ctl, const SegmentGeometry& geo) {
+    return ctl.version == SEGMENT_VERSION &&
+           ctl.geometry.layout == geo.layout &&
+           ctl.geometry.slot_size == geo.slot_size &&
+           ctl.geometry.capacity == geo.capacity &&
+           ctl.geometry.wait_strategy == geo.wait_strategy;
+}
+
+// Takes `slot` for this process unless another live process holds it
+inline bool claim_slot(PeerSlot& slot, const char* role) {
+    pid_t self = getpid();
+    while (true) {
+        int32_t owner = slot.pid.load(std::memory_order_acquire);
+        if (owner != 0 && owner != self && peer_alive(slot)) {
+            std::cerr << "Segment already has a live " << role << " (pid " << owner << ")\n";
+            return false;
+        }
+        // Beat first so a racing claimant sees a live owner once the CAS lands
+        slot.heartbeat_ns.store(monotonic_ns(), std::memory_order_relaxed);
+        if (slot.pid.compare_exchange_strong(owner, self, std::memory_order_acq_rel)) return true;
+    }
+}
+
+// Publisher side. Claims the segment, then resumes a compatible ring or
+// resets an incompatible/uninitialised one with reset_ring(). Returns false
+// if another publisher is alive.
+template <typename ResetRing>
+bool claim_publisher(ControlBlock& ctl, const SegmentGeometry& geo, ResetRing reset_ring) {
+    if (!claim_slot(ctl.publisher, "publisher")) return false;
+
+    bool valid = ctl.magic.load(std::memory_order_acquire) == SEGMENT_MAGIC;
+    if (valid && geometry_matches(ctl, geo)) {
+        uint64_t gen = ctl.generation.fetch_add(1, std::memory_order_acq_rel) + 1;
+        std::cout << "Resuming segment (generation " << gen << ")\n";
+        return true;
+    }
+
+    // Hide the header while it is rewritten; subscribers wait for the magic
+    ctl.magic.store(0, std::memory_order_release);
+    ctl.version = SEGMENT_VERSION;
+    ctl.geometry = geo;
+    reset_ring();
+    ctl.generation.fetch_add(1, std::memory_order_relaxed);
+    ctl.magic.store(SEGMENT_MAGIC, std::memory_order_release);
+    return true;
+}
+
+inline void release_publisher(ControlBlock& ctl) {
+    ctl.publisher.pid.store(0, std::memory_order_release);
+}
+
+// Subscriber side. Waits for a valid header with a live publisher; returns
+// false (after saying why) if the segment holds a ring we cannot read.
+inline bool wait_for_publisher(const ControlBlock& ctl, const SegmentGeometry& geo) {
+    while (ctl.magic.load(std::memory_order_acquire) != SEGMENT_MAGIC || !peer_alive(ctl.publisher)) {
+        std::this_thread::sleep_for(ATTACH_POLL);
+    }
+    if (!geometry_matches(ctl, geo)) {
+        std::cerr << "Incompatible segment: version " << ctl.version << " layout " << ctl.geometry.layout
+                  << " slot_size " << ctl.geometry.slot_size << " capacity " << ctl.geometry.capacity
+                  << " wait_strategy " << ctl.geometry.wait_strategy << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Background thread that refreshes our heartbeat every HEARTBEAT_INTERVAL and
+// runs `tick` (used to watch the peer). Stops and joins on destruction.
+class Heartbeat {
+private:
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+public:
+    template <typename Tick>
+    Heartbeat(PeerSlot& self, Tick tick)
+        : thread([this, &self, tick]() mutable {
+              while (!stopping.load(std::memory_order_relaxed)) {
+                  self.heartbeat_ns.store(monotonic_ns(), std::memory_order_relaxed);
+                  tick();
+                  std::this_thread::sleep_for(HEARTBEAT_INTERVAL);
+              }
+          }) {}
+
+    explicit Heartbeat(PeerSlot& self) : Heartbeat(self, [] {}) {}
+
+    ~Heartbeat() {
+        stopping.store(true, std::memory_order_relaxed);
+        thread.join();
+    }
+};
@@ -0,0 +1,133 @@
+// Shared layout and protocol of the MPMC SHM ring (many writers, many readers)
+//
+// The publisher, the subscriber and shm_mpmc_bench all map the same segment,
+// so every binary takes the header, the slot layout and the enqueue/dequeue
+// protocol from here. Producers and consumers each claim a slot with one CAS
+// on their own cursor; the slot's sequence number says whose turn it is
+// (Vyukov bounded MPMC queue).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "../common/clock.hpp"
+
+constexpr size_t MSG_SIZE = 64;
+constexpr size_t RING_SIZE = 1024; // Must be a power of two
+constexpr size_t RING_MASK = RING_SIZE - 1;
+constexpr size_t CACHE_LINE = 64;
+constexpr size_t MAX_BACKOFF = 1000; // Maximum backoff iterations
+
+static_assert((RING_SIZE & RING_MASK) == 0, "RING_SIZE must be a power of two");
+
+enum : uint32_t { RING_UNINIT = 0, RING_INITIALIZING = 1, RING_READY = 2 };
+
+struct ShmHeader {
+    alignas(CACHE_LINE) std::atomic<uint64_t> enqueue_pos; // Next slot producers claim
+    alignas(CACHE_LINE) std::atomic<uint64_t> dequeue_pos; // Next slot consumers claim
+    alignas(CACHE_LINE) std::atomic<uint32_t> state;       // RING_UNINIT -> RING_READY
+    // slots follow
+};
+
+struct ShmMsg {
+    uint64_t seq;
+    uint64_t t_ns;
+    char payload[MSG_SIZE - 16];
+};
+
+struct alignas(CACHE_LINE) MpmcSlot {
+    std::atomic<uint64_t> sequence; // == pos: free for producer, == pos + 1: ready for consumer
+    ShmMsg msg;
+};
+
+class ExponentialBackoff {
+private:
+    int current_delay;
+    int max_delay;
+
+public:
+    ExponentialBackoff(int initial = 1, int max = MAX_BACKOFF)
+        : current_delay(initial), max_delay(max) {}
+
+    void wait() {
+        for (int i = 0; i < current_delay; ++i) {
+            std::this_thread::yield();
+        }
+        current_delay = std::min(current_delay * 2, max_delay);
+    }
+
+    void reset() {
+        current_delay = 1;
+    }
+};
+
+// Empty ring: every slot free for the producer of lap 0. Only safe while no
+// producer or consumer is using the ring.
+inline void seed_ring(ShmHeader* hdr, MpmcSlot* slots) {
+    for (size_t i = 0; i < RING_SIZE; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    hdr->enqueue_pos.store(0, std::memory_order_relaxed);
+    hdr->dequeue_pos.store(0, std::memory_order_relaxed);
+}
+
+// First process to attach seeds the per-slot sequence numbers; everyone else
+// waits until the ring is marked ready.
+inline void init_ring(ShmHeader* hdr, MpmcSlot* slots) {
+    uint32_t expected = RING_UNINIT;
+    if (hdr->state.compare_exchange_strong(expected, RING_INITIALIZING)) {
+        seed_ring(hdr, slots);
+        hdr->state.store(RING_READY, std::memory_order_release);
+    }
+    while (hdr->state.load(std::memory_order_acquire) != RING_READY) {
+        std::this_thread::yield();
+    }
+}
+
+// Returns false when the ring is full.
+inline bool try_enqueue(ShmHeader* hdr, MpmcSlot* slots, uint64_t seq) {
+    uint64_t pos = hdr->enqueue_pos.load(std::memory_order_relaxed);
+    MpmcSlot* slot;
+    while (true) {
+        slot = &slots[pos & RING_MASK];
+        uint64_t slot_seq = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)slot_seq - (int64_t)pos;
+        if (diff == 0) {
+            if (hdr->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = hdr->enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->msg.seq = seq;
+    slot->msg.t_ns = pubsub::now_ns();
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+// Returns false when the ring is empty.
+inline bool try_dequeue(ShmHeader* hdr, MpmcSlot* slots, ShmMsg& out) {
+    uint64_t pos = hdr->dequeue_pos.load(std::memory_order_relaxed);
+    MpmcSlot* slot;
+    while (true) {
+        slot = &slots[pos & RING_MASK];
+        uint64_t slot_seq = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)slot_seq - (int64_t)(pos + 1);
+        if (diff == 0) {
+            if (hdr->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = hdr->dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+    out = slot->msg;
+    // Hand the slot back to producers for the next lap
+    slot->sequence.store(pos + RING_SIZE, std::memory_order_release);
+    return true;
+}
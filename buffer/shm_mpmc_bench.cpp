@@ -0,0 +1,158 @@
+// SHM MPMC throughput benchmark: scales producers and consumers on one segment
+// Usage: ./shm_mpmc_bench <shm_name> <count_per_producer> [max_procs]
+//
+// For every producer/consumer combination in 1, 2, 3, ... max_procs (default 8)
+// the benchmark forks that many producer and consumer processes over the same
+// mmap'd MPMC ring and reports the aggregate msgs/sec.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "shm_mpmc.hpp"
+
+using namespace std;
+using clk = chrono::high_resolution_clock;
+
+// Start barrier and completion tracking shared by all forked workers
+struct BenchControl {
+    alignas(CACHE_LINE) std::atomic<uint32_t> ready;
+    std::atomic<uint32_t> go;
+    alignas(CACHE_LINE) std::atomic<uint32_t> producers_done;
+    alignas(CACHE_LINE) std::atomic<uint64_t> consumed;
+};
+
+// Reset the ring between runs; only called while no worker is attached.
+static void reset_ring(ShmHeader* hdr, BenchControl* ctl, MpmcSlot* slots) {
+    seed_ring(hdr, slots);
+    ctl->ready.store(0, memory_order_relaxed);
+    ctl->go.store(0, memory_order_relaxed);
+    ctl->producers_done.store(0, memory_order_relaxed);
+    ctl->consumed.store(0, memory_order_relaxed);
+    hdr->state.store(RING_READY, memory_order_release);
+}
+
+static void wait_for_go(BenchControl* ctl) {
+    ctl->ready.fetch_add(1, memory_order_acq_rel);
+    while (ctl->go.load(memory_order_acquire) == 0) {
+        this_thread::yield();
+    }
+}
+
+static void run_producer(ShmHeader* hdr, BenchControl* ctl, MpmcSlot* slots, uint64_t count) {
+    wait_for_go(ctl);
+    ExponentialBackoff backoff;
+    for (uint64_t i = 0; i < count; ++i) {
+        while (!try_enqueue(hdr, slots, i)) backoff.wait();
+        backoff.reset();
+    }
+    ctl->producers_done.fetch_add(1, memory_order_release);
+}
+
+static void run_consumer(ShmHeader* hdr, BenchControl* ctl, MpmcSlot* slots, uint32_t producers) {
+    wait_for_go(ctl);
+    ExponentialBackoff backoff;
+    uint64_t local = 0;
+    ShmMsg m;
+    while (true) {
+        if (try_dequeue(hdr, slots, m)) {
+            ++local;
+            backoff.reset();
+            continue;
+        }
+        // Once every producer has finished, an empty ring means we are done
+        if (ctl->producers_done.load(memory_order_acquire) == producers) {
+            if (!try_dequeue(hdr, slots, m)) break;
+            ++local;
+            continue;
+        }
+        backoff.wait();
+    }
+    ctl->consumed.fetch_add(local, memory_order_acq_rel);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <shm_name> <count_per_producer> [max_procs]\n";
+        return 1;
+    }
+
+    string name = "/tmp/" + string(argv[1]);
+    uint64_t count = stoull(argv[2]);
+    uint32_t max_procs = argc > 3 ? stoul(argv[3]) : 8;
+
+    size_t total_size = sizeof(ShmHeader) + sizeof(BenchControl) + RING_SIZE * sizeof(MpmcSlot);
+
+    // Use a regular file for shared memory on macOS
+    int fd = open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) { perror("open"); return 1; }
+
+    if (ftruncate(fd, total_size) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return 1;
+    }
+
+    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap"); return 1; }
+
+    auto hdr = reinterpret_cast<ShmHeader*>(base);
+    auto ctl = reinterpret_cast<BenchControl*>((char*)base + sizeof(ShmHeader));
+    auto slots = reinterpret_cast<MpmcSlot*>((char*)base + sizeof(ShmHeader) + sizeof(BenchControl));
+
+    cout << "SHM MPMC throughput benchmark on " << name
+         << " (" << count << " msgs per producer, ring=" << RING_SIZE << ")\n";
+
+    for (uint32_t producers = 1; producers <= max_procs; ++producers) {
+        for (uint32_t consumers = 1; consumers <= max_procs; ++consumers) {
+            reset_ring(hdr, ctl, slots);
+
+            vector<pid_t> children;
+            for (uint32_t p = 0; p < producers; ++p) {
+                pid_t pid = fork();
+                if (pid == 0) { run_producer(hdr, ctl, slots, count); _exit(0); }
+                children.push_back(pid);
+            }
+            for (uint32_t c = 0; c < consumers; ++c) {
+                pid_t pid = fork();
+                if (pid == 0) { run_consumer(hdr, ctl, slots, producers); _exit(0); }
+                children.push_back(pid);
+            }
+
+            while (ctl->ready.load(memory_order_acquire) < producers + consumers) {
+                this_thread::yield();
+            }
+            auto start = clk::now();
+            ctl->go.store(1, memory_order_release);
+
+            for (pid_t pid : children) {
+                int status;
+                waitpid(pid, &status, 0);
+            }
+            double elapsed_s = chrono::duration<double>(clk::now() - start).count();
+
+            uint64_t expected = count * producers;
+            uint64_t consumed = ctl->consumed.load(memory_order_acquire);
+            cout << "SHM MPMC bench producers=" << producers
+                 << " consumers=" << consumers
+                 << " msgs=" << consumed
+                 << " elapsed_s=" << elapsed_s
+                 << " msgs_per_sec=" << (consumed / elapsed_s)
+                 << (consumed == expected ? "" : " MISMATCH") << "\n";
+        }
+    }
+
+    munmap(base, total_size);
+    close(fd);
+    return 0;
+}
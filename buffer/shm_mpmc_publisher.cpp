@@ -0,0 +1,79 @@
+// SHM MPMC Publisher: any number of producers share one bounded ring
+// Usage: ./shm_mpmc_publisher <shm_name> <count>
+//
+// Producers claim slots with a single CAS on enqueue_pos. Each slot carries a
+// sequence number that tells producers and consumers whose turn it is, so no
+// process ever waits on another's cursor store (Vyukov bounded MPMC queue).
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "shm_mpmc.hpp"
+
+using namespace std;
+using clk = chrono::high_resolution_clock;
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <shm_name> <count>\n";
+        return 1;
+    }
+
+    string name = "/tmp/" + string(argv[1]);
+    int count = stoi(argv[2]);
+
+    size_t total_size = sizeof(ShmHeader) + RING_SIZE * sizeof(MpmcSlot);
+
+    // Use a regular file for shared memory on macOS
+    int fd = open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) { perror("open"); return 1; }
+
+    if (ftruncate(fd, total_size) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return 1;
+    }
+
+    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap"); return 1; }
+
+    auto hdr = reinterpret_cast<ShmHeader*>(base);
+    auto slots = reinterpret_cast<MpmcSlot*>((char*)base + sizeof(ShmHeader));
+
+    init_ring(hdr, slots);
+
+    // Tag sequence numbers with our pid so consumers can tell producers apart
+    uint64_t tag = (uint64_t)getpid() << 32;
+
+    ExponentialBackoff backoff;
+    uint64_t full_waits = 0;
+
+    auto start = clk::now();
+    for (uint64_t i = 0; i < (uint64_t)count; ++i) {
+        while (!try_enqueue(hdr, slots, tag | i)) {
+            ++full_waits;
+            backoff.wait();
+        }
+        backoff.reset();
+    }
+    double elapsed_s = chrono::duration<double>(clk::now() - start).count();
+
+    cout << "SHM MPMC pub pid=" << getpid()
+         << " count=" << count
+         << " elapsed_s=" << elapsed_s
+         << " msgs_per_sec=" << (count / elapsed_s)
+         << " full_waits=" << full_waits << "\n";
+
+    munmap(base, total_size);
+    close(fd);
+    return 0;
+}
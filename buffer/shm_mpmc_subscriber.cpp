@@ -0,0 +1,84 @@
+// SHM MPMC Subscriber: one of any number of consumers sharing one ring
+// Usage: ./shm_mpmc_subscriber <shm_name>
+//
+// Consumers claim work with a single CAS on dequeue_pos; every message is
+// delivered to exactly one consumer.
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "shm_mpmc.hpp"
+
+using namespace std;
+using pubsub::now_ns;
+using clk = chrono::high_resolution_clock;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int) { stop_requested = 1; }
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <shm_name>\n";
+        return 1;
+    }
+
+    string name = "/tmp/" + string(argv[1]);
+
+    size_t total_size = sizeof(ShmHeader) + RING_SIZE * sizeof(MpmcSlot);
+
+    int fd = open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) { perror("open"); return 1; }
+
+    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap"); return 1; }
+
+    auto hdr = reinterpret_cast<ShmHeader*>(base);
+    auto slots = reinterpret_cast<MpmcSlot*>((char*)base + sizeof(ShmHeader));
+
+    init_ring(hdr, slots);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    cout << "shm_mpmc_sub pid=" << getpid() << " started on " << name << "\n";
+
+    ExponentialBackoff backoff;
+    uint64_t processed_count = 0;
+    double latency_sum_us = 0;
+
+    while (!stop_requested) {
+        ShmMsg m;
+        if (try_dequeue(hdr, slots, m)) {
+            uint64_t recv_ns = now_ns();
+            latency_sum_us += (recv_ns - m.t_ns) / 1000.0;
+            processed_count++;
+            backoff.reset();
+
+            if (processed_count % 1000 == 0) {
+                cout << "Processed " << processed_count << " messages\n";
+            }
+        } else {
+            backoff.wait();
+        }
+    }
+
+    cout << "SHM MPMC sub pid=" << getpid()
+         << " count=" << processed_count
+         << " avg_one_way_us=" << (processed_count ? latency_sum_us / processed_count : 0.0) << "\n";
+
+    munmap(base, total_size);
+    close(fd);
+    return 0;
+}
@@ -7,16 +7,16 @@
 #include <unistd.h>
 
 #include <atomic>
-#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <string>
 #include <thread>
-#include <vector>
+
+#include "../common/clock.hpp"
+#include "../common/stats.hpp"
 
 using namespace std;
-using ns = chrono::nanoseconds;
-using clk = chrono::high_resolution_clock;
+using pubsub::now_ns;
 
 constexpr size_t MSG_SIZE = 64;
 constexpr size_t RING_SIZE = 1024;
@@ -43,6 +43,11 @@ int main(int argc, char** argv) {
     // Use a regular file for shared memory on macOS
     int fd = open(name.c_str(), O_CREAT | O_RDWR, 0600);
     if (fd < 0) { perror("open"); return 1; }
+
+    // A file we just created (or an empty leftover) has no ring in it yet
+    struct stat st{};
+    if (fstat(fd, &st) < 0) { perror("fstat"); close(fd); return 1; }
+    bool fresh = st.st_size == 0;
     
     if (ftruncate(fd, total_size) < 0) { 
         perror("ftruncate"); 
@@ -56,38 +61,42 @@ int main(int argc, char** argv) {
     auto hdr = reinterpret_cast<ShmHeader*>(base);
     auto msgs = reinterpret_cast<ShmMsg*>((char*)base + sizeof(ShmHeader));
 
-    // initialize indices if first time (naively)
-    hdr->head = 0;
-    hdr->tail = 0;
+    // Only a fresh segment is zeroed; an existing one may have a subscriber
+    // attached, so we continue from its head instead of resetting under it
+    if (fresh) {
+        hdr->head = 0;
+        hdr->tail = 0;
+    }
+    uint64_t start = hdr->head;
 
-    vector<double> rtts;
-    rtts.reserve(count);
+    pubsub::Histogram rtts;
 
     for (uint64_t i = 0; i < (uint64_t)count; ++i) {
         // wait for space
         while ((hdr->head - hdr->tail) >= RING_SIZE) { /* busy-wait */ }
         uint64_t idx = hdr->head % RING_SIZE;
         ShmMsg &m = msgs[idx];
+        // Keep the send time locally: the slot is shared, and a subscriber
+        // that echoes into t_ns may already have overwritten it
+        uint64_t send_ns = now_ns();
         m.seq = i;
-        m.t_ns = (uint64_t)chrono::duration_cast<ns>(clk::now().time_since_epoch()).count();
+        m.t_ns = send_ns;
         // publish (release)
         __atomic_thread_fence(__ATOMIC_RELEASE);
         hdr->head++;
 
         // wait for consumer to process and increment tail
-        while (hdr->tail <= i) {
+        while (hdr->tail <= start + i) {
             this_thread::yield();
         }
         
-        // Calculate RTT (simplified - just measure time since we sent)
-        uint64_t now_ns = (uint64_t)chrono::duration_cast<ns>(clk::now().time_since_epoch()).count();
-        double rtt_us = (now_ns - m.t_ns) / 1000.0;
-        rtts.push_back(rtt_us);
+        // RTT: time since we sent
+        rtts.record(now_ns() - send_ns);
     }
 
-    double sum = 0;
-    for (double v : rtts) sum += v;
-    cout << "SHM pub count=" << rtts.size() << " avg_RTT_us=" << (sum / rtts.size()) << " avg_one_way_us=" << (sum / rtts.size() / 2.0) << "\n";
+    cout << "SHM pub";
+    pubsub::print_rtt_fields(cout, pubsub::summarize(rtts));
+    cout << "\n";
 
     munmap(base, total_size);
     close(fd);
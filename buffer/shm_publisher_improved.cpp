@@ -1,155 +1,438 @@
 // Improved SHM Publisher with std::atomic_ref and better synchronization
-// Usage: ./shm_publisher_improved <shm_name> <count>
+// Usage: ./shm_publisher_improved <shm_name> <count> [--layout=aligned|packed] [--stream]
+//                                 [--wait=backoff|spin|yield|futex] [--interval-us=N]
+//                                 [--backing=shm|file|memfd] [--huge=none|thp|hugetlb] [--prefault] [--numa-node=N]
+//
+// Default mode is ping-pong RTT. --stream pushes <count> messages per batch
+// size (1..MAX_BATCH) through publish_batch() without waiting for each one
+// and reports msgs/sec and GB/s. --interval-us idles between pings so the
+// CPU cost of each wait strategy while idle shows up in the report.
+// The first round trip (which takes the page faults on an unprefaulted
+// segment) is reported as first_RTT_us and kept out of the steady-state stats.
+//
+// The segment starts with a versioned ControlBlock (shm_control.hpp). A
+// restarted publisher resumes a compatible ring from its stored head instead
+// of resetting it under an attached subscriber.
 
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "../common/clock.hpp"
+#include "../common/stats.hpp"
+#include "shm_control.hpp"
+#include "shm_segment.hpp"
+#include "shm_wait_strategy.hpp"
+
 using namespace std;
+using pubsub::now_ns;
 using ns = chrono::nanoseconds;
 using clk = chrono::high_resolution_clock;
 
 constexpr size_t MSG_SIZE = 64;
 constexpr size_t RING_SIZE = 1024;
-constexpr size_t MAX_BACKOFF = 1000; // Maximum backoff iterations
+constexpr size_t MAX_BATCH = 256; // Largest batch the streaming benchmark tries
+// Cursors are padded to two cache lines so the adjacent-line prefetcher does
+// not pull the other side's cursor in with ours.
+constexpr size_t CACHE_LINE = 128;
 
-struct ShmHeader {
+// Original layout: both cursors share one cache line. The header is only
+// padded to a whole line so the slots after it stay aligned for ShmMsg.
+struct alignas(64) PackedShmHeader {
     std::atomic<uint64_t> head; // Producer index
     std::atomic<uint64_t> tail; // Consumer index
-    std::atomic<bool> initialized; // Initialization flag
+    WaitPoint data_ready;  // Subscriber sleeps here waiting for head
+    WaitPoint space_ready; // Publisher sleeps here waiting for tail
     // messages follow
 };
 
-struct ShmMsg {
+// Producer and consumer cursors on separate lines; slots start aligned
+struct AlignedShmHeader {
+    alignas(CACHE_LINE) std::atomic<uint64_t> head; // Producer index
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail; // Consumer index
+    alignas(CACHE_LINE) WaitPoint data_ready;  // Subscriber sleeps here waiting for head
+    alignas(CACHE_LINE) WaitPoint space_ready; // Publisher sleeps here waiting for tail
+    // messages follow
+};
+
+struct alignas(64) ShmMsg {
     uint64_t seq;
     uint64_t t_ns;
     char payload[MSG_SIZE - 16];
 };
 
-class ExponentialBackoff {
+static_assert((sizeof(ControlBlock) + sizeof(PackedShmHeader)) % alignof(ShmMsg) == 0,
+              "packed slots must start aligned for ShmMsg");
+static_assert((sizeof(ControlBlock) + sizeof(AlignedShmHeader)) % alignof(ShmMsg) == 0,
+              "aligned slots must start aligned for ShmMsg");
+
+// Baseline for before/after comparisons: shared line, remote cursor reloaded every time
+struct PackedLayout {
+    using Header = PackedShmHeader;
+    static constexpr const char* name = "packed";
+    static constexpr uint32_t id = 1; // Recorded in the ControlBlock geometry
+    static constexpr bool cache_remote_cursor = false;
+};
+
+// Separate lines and a locally cached copy of the consumer's tail
+struct AlignedLayout {
+    using Header = AlignedShmHeader;
+    static constexpr const char* name = "aligned";
+    static constexpr uint32_t id = 2;
+    static constexpr bool cache_remote_cursor = true;
+};
+
+template <typename Layout>
+size_t segment_size() {
+    return sizeof(ControlBlock) + sizeof(typename Layout::Header) + RING_SIZE * sizeof(ShmMsg);
+}
+
+template <typename Layout>
+SegmentGeometry segment_geometry(uint32_t wait_strategy) {
+    return {Layout::id, (uint32_t)sizeof(ShmMsg), RING_SIZE, wait_strategy};
+}
+
+// User + system CPU seconds of this process
+static double self_cpu_seconds() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// User + system CPU seconds of another process, from /proc/<pid>/stat
+// (fields 14 and 15); -1 where /proc is unavailable.
+static double process_cpu_seconds(pid_t pid) {
+    if (pid <= 0) return -1;
+    ifstream stat("/proc/" + to_string(pid) + "/stat");
+    string line;
+    if (!getline(stat, line)) return -1;
+    size_t paren = line.rfind(')');
+    if (paren == string::npos) return -1;
+    istringstream fields(line.substr(paren + 2));
+    string field;
+    unsigned long long utime = 0, stime = 0;
+    // State is field 3; utime/stime are fields 14/15
+    for (int i = 3; i <= 15 && fields >> field; ++i) {
+        if (i == 14) utime = stoull(field);
+        if (i == 15) stime = stoull(field);
+    }
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+// Producer side of the SPSC ring. publish_batch() does one space check and
+// one release store of head for the whole batch instead of one per message.
+template <typename Layout, typename Wait>
+class RingProducer {
 private:
-    int current_delay;
-    int max_delay;
-    
+    using Header = typename Layout::Header;
+    Header* hdr;
+    ShmMsg* msgs;
+    uint64_t head;        // Local copy of hdr->head (we are the only writer)
+    uint64_t cached_tail; // Reloaded only when the batch does not fit
+    Wait waiter;
+
 public:
-    ExponentialBackoff(int initial = 1, int max = MAX_BACKOFF) 
-        : current_delay(initial), max_delay(max) {}
-    
-    void wait() {
-        for (int i = 0; i < current_delay; ++i) {
-            std::this_thread::yield();
+    explicit RingProducer(void* base)
+        : hdr(reinterpret_cast<Header*>(base)),
+          msgs(reinterpret_cast<ShmMsg*>((char*)base + sizeof(Header))),
+          head(hdr->head.load(memory_order_acquire)),
+          cached_tail(hdr->tail.load(memory_order_acquire)) {}
+
+    // Copies up to n messages into the ring and publishes them together.
+    // Returns how many fitted; 0 means the ring is full.
+    size_t publish_batch(const ShmMsg* batch, size_t n) {
+        size_t room = RING_SIZE - (head - cached_tail);
+        if (room < n || !Layout::cache_remote_cursor) {
+            cached_tail = hdr->tail.load(memory_order_acquire);
+            room = RING_SIZE - (head - cached_tail);
         }
-        current_delay = min(current_delay * 2, max_delay);
+        n = min(n, room);
+        if (n == 0) return 0;
+
+        size_t idx = head % RING_SIZE;
+        size_t first = min(n, RING_SIZE - idx);
+        memcpy(&msgs[idx], batch, first * sizeof(ShmMsg));
+        memcpy(&msgs[0], batch + first, (n - first) * sizeof(ShmMsg));
+
+        head += n;
+        hdr->head.store(head, memory_order_release);
+        notify<Wait>(hdr->data_ready);
+        return n;
     }
-    
-    void reset() {
-        current_delay = 1;
+
+    // Block (per the wait strategy) until the consumer has released `pos`
+    void wait_consumed(uint64_t pos) {
+        waiter.wait_until(hdr->space_ready, [&] {
+            cached_tail = hdr->tail.load(memory_order_acquire);
+            return cached_tail >= pos;
+        });
+    }
+
+    // Block until at least one slot is free
+    void wait_for_space() {
+        wait_consumed(head + 1 - RING_SIZE);
     }
+
+    uint64_t position() const { return head; }
 };
 
-int main(int argc, char** argv) {
-    if (argc < 3) { 
-        cerr << "Usage: " << argv[0] << " <shm_name> <count>\n"; 
-        return 1; 
+// Claims the segment for this publisher; an incompatible or uninitialised
+// ring is reset, a compatible one is resumed where the last publisher stopped.
+template <typename Layout>
+bool claim_ring(ControlBlock* ctl, void* ring, uint32_t wait_strategy) {
+    auto hdr = reinterpret_cast<typename Layout::Header*>(ring);
+    return claim_publisher(*ctl, segment_geometry<Layout>(wait_strategy), [hdr] {
+        hdr->head.store(0, memory_order_relaxed);
+        hdr->tail.store(0, memory_order_relaxed);
+        for (WaitPoint* wp : {&hdr->data_ready, &hdr->space_ready}) {
+            wp->seq.store(0, memory_order_relaxed);
+            wp->waiters.store(0, memory_order_relaxed);
+        }
+    });
+}
+
+// Streaming throughput: no ping-pong, the publisher only waits when the ring
+// is full, and once at the end for the consumer to drain.
+template <typename Layout, typename Wait>
+void run_stream(ControlBlock* ctl, void* base, int count) {
+    RingProducer<Layout, Wait> producer(base);
+    vector<ShmMsg> batch(MAX_BATCH);
+
+    // As in ping-pong, start the clock only once a live subscriber has
+    // attached, so the first batch size does not include its startup
+    while (!subscriber_ready(*ctl)) {
+        this_thread::sleep_for(chrono::milliseconds(1));
     }
-    
-    string name = "/tmp/" + string(argv[1]);
-    int count = stoi(argv[2]);
 
-    size_t total_size = sizeof(ShmHeader) + RING_SIZE * sizeof(ShmMsg);
+    for (size_t batch_size = 1; batch_size <= MAX_BATCH; batch_size *= 2) {
+        uint64_t first_seq = producer.position();
+        uint64_t sent = 0;
+        auto start = clk::now();
+
+        while (sent < (uint64_t)count) {
+            size_t n = min<uint64_t>(batch_size, count - sent);
+            // One timestamp per batch keeps the clock off the per-message path
+            uint64_t t_ns = now_ns();
+            for (size_t k = 0; k < n; ++k) {
+                batch[k].seq = first_seq + sent + k;
+                batch[k].t_ns = t_ns;
+            }
+            size_t done = 0;
+            while (done < n) {
+                size_t published = producer.publish_batch(&batch[done], n - done);
+                if (published == 0) {
+                    producer.wait_for_space();
+                    continue;
+                }
+                done += published;
+            }
+            sent += n;
+        }
+
+        // Wait for the consumer to drain the ring
+        producer.wait_consumed(producer.position());
 
-    // Use a regular file for shared memory on macOS
-    int fd = open(name.c_str(), O_CREAT | O_RDWR, 0600);
-    if (fd < 0) { perror("open"); return 1; }
-    
-    if (ftruncate(fd, total_size) < 0) { 
-        perror("ftruncate"); 
-        close(fd);
-        return 1; 
+        double elapsed_s = chrono::duration<double>(clk::now() - start).count();
+        double msgs_per_sec = count / elapsed_s;
+        double gb_per_sec = (double)count * sizeof(ShmMsg) / elapsed_s / 1e9;
+        cout << "SHM stream layout=" << Layout::name
+             << " wait=" << Wait::name
+             << " batch=" << batch_size
+             << " count=" << count
+             << " msgs_per_sec=" << msgs_per_sec
+             << " GB_per_sec=" << gb_per_sec << "\n";
     }
-    
-    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (base == MAP_FAILED) { perror("mmap"); return 1; }
+}
 
-    auto hdr = reinterpret_cast<ShmHeader*>(base);
-    auto msgs = reinterpret_cast<ShmMsg*>((char*)base + sizeof(ShmHeader));
+struct PingPongResult {
+    double first_rtt_us = 0;
+    pubsub::Histogram rtts; // ns, without the first round trip
+    double wall_s;
+    double pub_cpu_s;
+    double sub_cpu_s; // -1 if the subscriber's CPU time could not be read
+};
 
-    // Initialize header if first time
-    bool expected = false;
-    if (hdr->initialized.compare_exchange_strong(expected, true)) {
-        hdr->head.store(0, memory_order_relaxed);
-        hdr->tail.store(0, memory_order_relaxed);
+template <typename Layout, typename Wait>
+PingPongResult run_pingpong(ControlBlock* ctl, void* base, int count, int interval_us) {
+    auto hdr = reinterpret_cast<typename Layout::Header*>(base);
+    auto msgs = reinterpret_cast<ShmMsg*>((char*)base + sizeof(typename Layout::Header));
+
+    PingPongResult result;
+
+    Wait waiter;
+    // Hold the first message until a live subscriber has attached, so
+    // first_RTT_us measures the cold message rather than the attach
+    while (!subscriber_ready(*ctl)) {
+        this_thread::sleep_for(chrono::milliseconds(1));
     }
 
-    vector<double> rtts;
-    rtts.reserve(count);
-    
-    ExponentialBackoff backoff;
+    // CPU accounting starts once the first round trip proves the subscriber is attached
+    pid_t sub_pid = -1;
+    double sub_cpu_start = -1;
+    double pub_cpu_start = self_cpu_seconds();
+    auto wall_start = clk::now();
+
+    // We own head, so keep it in a register; tail is only reloaded when the
+    // cached copy says the ring is full.
+    uint64_t head = hdr->head.load(memory_order_acquire);
+    uint64_t cached_tail = hdr->tail.load(memory_order_acquire);
 
     for (uint64_t i = 0; i < (uint64_t)count; ++i) {
-        // Wait for space with exponential backoff
-        while (true) {
-            uint64_t current_head = hdr->head.load(memory_order_acquire);
-            uint64_t current_tail = hdr->tail.load(memory_order_acquire);
-            
-            if ((current_head - current_tail) < RING_SIZE) {
-                break;
+        if (interval_us > 0) {
+            this_thread::sleep_for(chrono::microseconds(interval_us));
+        }
+
+        // Wait for space
+        if constexpr (Layout::cache_remote_cursor) {
+            if (head - cached_tail >= RING_SIZE) {
+                waiter.wait_until(hdr->space_ready, [&] {
+                    cached_tail = hdr->tail.load(memory_order_acquire);
+                    return head - cached_tail < RING_SIZE;
+                });
             }
-            backoff.wait();
+        } else {
+            waiter.wait_until(hdr->space_ready, [&] {
+                uint64_t current_head = hdr->head.load(memory_order_acquire);
+                uint64_t current_tail = hdr->tail.load(memory_order_acquire);
+                return (current_head - current_tail) < RING_SIZE;
+            });
+            head = hdr->head.load(memory_order_acquire);
         }
-        
-        uint64_t idx = hdr->head.load(memory_order_acquire) % RING_SIZE;
-        ShmMsg &m = msgs[idx];
-        m.seq = i;
-        m.t_ns = (uint64_t)chrono::duration_cast<ns>(clk::now().time_since_epoch()).count();
-        
+
+        ShmMsg &m = msgs[head % RING_SIZE];
+        m.seq = head;
+        uint64_t send_ns = now_ns();
+        m.t_ns = send_ns;
+
         // Publish with release semantics
-        hdr->head.store(hdr->head.load(memory_order_acquire) + 1, memory_order_release);
-        backoff.reset();
-
-        // Wait for consumer to process with exponential backoff
-        while (true) {
-            uint64_t current_tail = hdr->tail.load(memory_order_acquire);
-            if (current_tail > i) {
-                break;
-            }
-            backoff.wait();
+        hdr->head.store(++head, memory_order_release);
+        notify<Wait>(hdr->data_ready);
+
+        // Wait for consumer to process
+        waiter.wait_until(hdr->space_ready, [&] {
+            cached_tail = hdr->tail.load(memory_order_acquire);
+            return cached_tail >= head;
+        });
+
+        // RTT from our own send timestamp, not the slot the consumer may reuse
+        uint64_t recv_ns = now_ns();
+        // The first round trip pays for page faults and cold caches; it is
+        // reported on its own and kept out of the steady-state distribution
+        if (i == 0) result.first_rtt_us = (recv_ns - send_ns) / 1000.0;
+        if (i > 0 || count == 1) result.rtts.record(recv_ns - send_ns);
+
+        if (i == 0) {
+            sub_pid = ctl->subscriber.pid.load(memory_order_acquire);
+            sub_cpu_start = process_cpu_seconds(sub_pid);
+            pub_cpu_start = self_cpu_seconds();
+            wall_start = clk::now();
+        }
+    }
+
+    result.wall_s = chrono::duration<double>(clk::now() - wall_start).count();
+    result.pub_cpu_s = self_cpu_seconds() - pub_cpu_start;
+    double sub_cpu_end = process_cpu_seconds(sub_pid);
+    result.sub_cpu_s = (sub_cpu_start < 0 || sub_cpu_end < 0) ? -1 : sub_cpu_end - sub_cpu_start;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <shm_name> <count> [--layout=aligned|packed] [--stream]"
+             << " [--wait=backoff|spin|yield|futex] [--interval-us=N]"
+             << " [--backing=shm|file|memfd] [--huge=none|thp|hugetlb] [--prefault] [--numa-node=N]\n";
+        return 1;
+    }
+
+    string name = argv[1];
+    int count = stoi(argv[2]);
+    string layout = "aligned";
+    string wait = "backoff";
+    bool stream = false;
+    int interval_us = 0;
+    SegmentOptions seg_opts;
+    for (int a = 3; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg.rfind("--layout=", 0) == 0) layout = arg.substr(9);
+        else if (arg.rfind("--wait=", 0) == 0) wait = arg.substr(7);
+        else if (arg.rfind("--interval-us=", 0) == 0) interval_us = stoi(arg.substr(14));
+        else if (arg == "--stream") stream = true;
+        else if (!parse_segment_option(arg, seg_opts)) {
+            cerr << "Unknown option: " << arg << "\n";
+            return 1;
         }
-        
-        // Calculate RTT (simplified - just measure time since we sent)
-        uint64_t now_ns = (uint64_t)chrono::duration_cast<ns>(clk::now().time_since_epoch()).count();
-        double rtt_us = (now_ns - m.t_ns) / 1000.0;
-        rtts.push_back(rtt_us);
-    }
-
-    // Calculate statistics
-    double sum = 0;
-    for (double v : rtts) sum += v;
-    double avg = sum / rtts.size();
-    
-    // Sort for percentiles
-    sort(rtts.begin(), rtts.end());
-    double median = rtts[rtts.size() / 2];
-    double p95 = rtts[static_cast<size_t>(rtts.size() * 0.95)];
-    double p99 = rtts[static_cast<size_t>(rtts.size() * 0.99)];
-    
-    cout << "SHM pub count=" << rtts.size() 
-         << " avg_RTT_us=" << avg 
-         << " median_RTT_us=" << median
-         << " p95_RTT_us=" << p95
-         << " p99_RTT_us=" << p99
-         << " avg_one_way_us=" << (avg/2.0) << "\n";
-
-    munmap(base, total_size);
-    close(fd);
+    }
+    if (layout != "aligned" && layout != "packed") {
+        cerr << "Unknown layout: " << layout << "\n";
+        return 1;
+    }
+    uint32_t wait_id = wait_strategy_id(wait);
+    if (wait_id == 0) {
+        cerr << "Unknown wait strategy: " << wait << "\n";
+        return 1;
+    }
+
+    size_t total_size = layout == "aligned" ? segment_size<AlignedLayout>() : segment_size<PackedLayout>();
+
+    Segment seg = create_segment(name, total_size, seg_opts);
+    if (!seg.base) return 1;
+    auto ctl = reinterpret_cast<ControlBlock*>(seg.base);
+    void* base = (char*)seg.base + sizeof(ControlBlock);
+
+    bool claimed = layout == "aligned" ? claim_ring<AlignedLayout>(ctl, base, wait_id)
+                                       : claim_ring<PackedLayout>(ctl, base, wait_id);
+    if (!claimed) {
+        release_segment(seg);
+        return 1;
+    }
+
+    PingPongResult result;
+    bool known;
+    {
+        Heartbeat heartbeat(ctl->publisher);
+        known = dispatch_wait_strategy(wait, [&](auto strategy) {
+            using Wait = decltype(strategy);
+            if (stream) {
+                if (layout == "aligned") run_stream<AlignedLayout, Wait>(ctl, base, count);
+                else run_stream<PackedLayout, Wait>(ctl, base, count);
+            } else {
+                result = layout == "aligned" ? run_pingpong<AlignedLayout, Wait>(ctl, base, count, interval_us)
+                                             : run_pingpong<PackedLayout, Wait>(ctl, base, count, interval_us);
+            }
+        });
+    }
+    release_publisher(*ctl);
+    if (!known) {
+        cerr << "Unknown wait strategy: " << wait << "\n";
+        release_segment(seg);
+        return 1;
+    }
+    if (stream) {
+        release_segment(seg);
+        return 0;
+    }
+
+    cout << "SHM pub layout=" << layout
+         << " wait=" << wait
+         << " backing=" << backing_name(seg_opts.backing)
+         << " huge=" << huge_name(seg_opts.huge)
+         << " prefault=" << (seg_opts.prefault ? 1 : 0)
+         << " first_RTT_us=" << result.first_rtt_us;
+    pubsub::print_rtt_fields(cout, pubsub::summarize(result.rtts));
+    cout << " wall_s=" << result.wall_s
+         << " pub_cpu_s=" << result.pub_cpu_s
+         << " sub_cpu_s=" << result.sub_cpu_s << "\n";
+
+    release_segment(seg);
     return 0;
 }
@@ -0,0 +1,379 @@
+// Shared-memory segment allocation for the SHM rings
+//
+// Backings (--backing=):
+//   file   regular file under /tmp/ (portable; the original macOS behaviour)
+//   shm    POSIX shm_open(), i.e. tmpfs under /dev/shm on Linux (default on Linux)
+//   memfd  anonymous memfd_create(); the creator serves the fd to attachers
+//          over an abstract unix socket with SCM_RIGHTS (Linux only)
+// Page options:
+//   --huge=thp      madvise(MADV_HUGEPAGE) on the mapping
+//   --huge=hugetlb  explicit huge pages (MFD_HUGETLB; memfd backing only)
+//   --prefault      MAP_POPULATE (or a touch pass after mbind()/madvise()) +
+//                   mlock so the first messages do not fault
+//   --numa-node=N   mbind() the pages to NUMA node N before they are touched
+//                   (pages already there are migrated; Linux only; the
+//                   segment fails if the bind does)
+//
+// Errors are reported with perror() and signalled by a null `base`, matching
+// how the binaries handle open()/mmap() failures. attach_segment() can
+// instead wait for the owner to create the segment, so subscribers may start first.
+
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+enum class SegmentBacking { File, PosixShm, Memfd };
+enum class HugePages { None, Thp, HugeTlb };
+
+struct SegmentOptions {
+#ifdef __linux__
+    SegmentBacking backing = SegmentBacking::PosixShm;
+#else
+    SegmentBacking backing = SegmentBacking::File;
+#endif
+    HugePages huge = HugePages::None;
+    bool prefault = false;
+    int numa_node = -1; // -1: wherever the first touch lands
+};
+
+struct Segment {
+    void* base = nullptr;
+    size_t size = 0;
+    int fd = -1;
+};
+
+constexpr size_t DEFAULT_HUGE_PAGE = 2 << 20;
+
+// Consumes a segment option from the command line; returns false if `arg` is not one.
+inline bool parse_segment_option(const std::string& arg, SegmentOptions& opts) {
+    if (arg == "--backing=file") opts.backing = SegmentBacking::File;
+    else if (arg == "--backing=shm") opts.backing = SegmentBacking::PosixShm;
+    else if (arg == "--backing=memfd") opts.backing = SegmentBacking::Memfd;
+    else if (arg == "--huge=none") opts.huge = HugePages::None;
+    else if (arg == "--huge=thp") opts.huge = HugePages::Thp;
+    else if (arg == "--huge=hugetlb") opts.huge = HugePages::HugeTlb;
+    else if (arg == "--prefault") opts.prefault = true;
+    else if (arg.rfind("--numa-node=", 0) == 0) opts.numa_node = std::stoi(arg.substr(12));
+    else return false;
+    return true;
+}
+
+inline const char* backing_name(SegmentBacking b) {
+    switch (b) {
+        case SegmentBacking::File: return "file";
+        case SegmentBacking::PosixShm: return "shm";
+        case SegmentBacking::Memfd: return "memfd";
+    }
+    return "?";
+}
+
+inline const char* huge_name(HugePages h) {
+    switch (h) {
+        case HugePages::None: return "none";
+        case HugePages::Thp: return "thp";
+        case HugePages::HugeTlb: return "hugetlb";
+    }
+    return "?";
+}
+
+// Hugepagesize from /proc/meminfo, or 2 MiB if it cannot be read
+inline size_t huge_page_size() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+    size_t kb;
+    std::string unit;
+    while (meminfo >> key >> kb) {
+        if (key == "Hugepagesize:") return kb * 1024;
+        std::getline(meminfo, unit);
+    }
+    return DEFAULT_HUGE_PAGE;
+}
+
+// Mapping length for a requested size: whole pages, whole huge pages if asked
+inline size_t segment_length(size_t size, const SegmentOptions& opts) {
+    size_t page = opts.huge == HugePages::None ? (size_t)sysconf(_SC_PAGESIZE) : huge_page_size();
+    return (size + page - 1) / page * page;
+}
+
+// Abstract-namespace socket the memfd owner serves its fd on
+inline sockaddr_un memfd_socket_address(const std::string& name, socklen_t& len) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::string path = "pubsub-shm-" + name;
+    // Leading NUL selects the abstract namespace: nothing to clean up on exit
+    std::memcpy(addr.sun_path + 1, path.c_str(), std::min(path.size(), sizeof(addr.sun_path) - 2));
+    len = (socklen_t)(offsetof(sockaddr_un, sun_path) + 1 + std::min(path.size(), sizeof(addr.sun_path) - 2));
+    return addr;
+}
+
+// Hands `fd` to every process that connects, for as long as we live
+inline bool serve_fd(const std::string& name, int fd) {
+    int srv = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (srv < 0) { perror("socket"); return false; }
+    socklen_t len;
+    sockaddr_un addr = memfd_socket_address(name, len);
+    if (bind(srv, (sockaddr*)&addr, len) < 0) { perror("bind"); close(srv); return false; }
+    if (listen(srv, 16) < 0) { perror("listen"); close(srv); return false; }
+
+    std::thread([srv, fd]() {
+        while (true) {
+            int client = accept(srv, nullptr, nullptr);
+            if (client < 0) continue;
+            char byte = 0;
+            iovec iov{&byte, 1};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+            msghdr msg{};
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+            if (sendmsg(client, &msg, 0) < 0) perror("sendmsg");
+            close(client);
+        }
+    }).detach();
+    return true;
+}
+
+constexpr auto OWNER_POLL = std::chrono::milliseconds(10);
+
+// Connects to the memfd owner and receives its fd; -1 on failure. With
+// `wait`, retries until the owner is listening.
+inline int receive_fd(const std::string& name, bool wait) {
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) { perror("socket"); return -1; }
+    socklen_t len;
+    sockaddr_un addr = memfd_socket_address(name, len);
+    while (connect(sock, (sockaddr*)&addr, len) < 0) {
+        if (!wait || (errno != ECONNREFUSED && errno != ENOENT)) {
+            perror("connect");
+            close(sock);
+            return -1;
+        }
+        std::this_thread::sleep_for(OWNER_POLL);
+    }
+
+    char byte;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    int fd = -1;
+    if (recvmsg(sock, &msg, 0) > 0) {
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_type == SCM_RIGHTS) std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    if (fd < 0) std::cerr << "No fd received from memfd owner\n";
+    close(sock);
+    return fd;
+}
+
+// Binds the mapping's pages to one NUMA node; pages already faulted in
+// elsewhere are moved. mbind() is called directly so there is no libnuma
+// dependency. Returns false if the node was asked for but cannot be bound.
+inline bool bind_to_node(const Segment& seg, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+    constexpr int MODE_BIND = 2;        // MPOL_BIND
+    constexpr unsigned FLAG_MOVE = 1u << 1; // MPOL_MF_MOVE
+    unsigned long mask[16] = {};
+    if (node < 0 || node >= (int)(sizeof(mask) * 8)) {
+        std::cerr << "--numa-node=" << node << " out of range\n";
+        return false;
+    }
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    if (syscall(SYS_mbind, seg.base, seg.size, MODE_BIND, mask, sizeof(mask) * 8, FLAG_MOVE) < 0) {
+        perror("mbind");
+        return false;
+    }
+    return true;
+#else
+    (void)seg;
+    (void)node;
+    std::cerr << "--numa-node is only available on Linux\n";
+    return false;
+#endif
+}
+
+inline bool map_fd(Segment& seg, const SegmentOptions& opts) {
+    int flags = MAP_SHARED;
+    bool populated = false;
+#ifdef MAP_POPULATE
+    // MAP_POPULATE faults pages in during mmap(), before mbind() or
+    // madvise(MADV_HUGEPAGE) could apply; those cases are touched below instead
+    if (opts.prefault && opts.numa_node < 0 && opts.huge != HugePages::Thp) {
+        flags |= MAP_POPULATE;
+        populated = true;
+    }
+#endif
+    seg.base = mmap(nullptr, seg.size, PROT_READ | PROT_WRITE, flags, seg.fd, 0);
+    if (seg.base == MAP_FAILED) {
+        perror("mmap");
+        seg.base = nullptr;
+        return false;
+    }
+    if (opts.numa_node >= 0 && !bind_to_node(seg, opts.numa_node)) {
+        munmap(seg.base, seg.size);
+        seg.base = nullptr;
+        return false;
+    }
+#ifdef MADV_HUGEPAGE
+    if (opts.huge == HugePages::Thp && madvise(seg.base, seg.size, MADV_HUGEPAGE) < 0) {
+        perror("madvise(MADV_HUGEPAGE)");
+    }
+#endif
+    if (opts.prefault) {
+        // Without MAP_POPULATE, write-fault every page in. The peer may already
+        // be using the segment, so the touch is an atomic add of zero rather
+        // than a plain read-modify-write that could store back a stale value.
+        // THP steps by base pages: the mapping need not start huge-page aligned,
+        // and a touch inside an already-faulted huge page costs nothing.
+        if (!populated) {
+            char* p = static_cast<char*>(seg.base);
+            size_t page = opts.huge == HugePages::HugeTlb ? huge_page_size() : (size_t)sysconf(_SC_PAGESIZE);
+            for (size_t off = 0; off < seg.size; off += page) {
+                reinterpret_cast<std::atomic<uint64_t>*>(p + off)->fetch_add(0, std::memory_order_relaxed);
+            }
+        }
+        // Locking needs CAP_IPC_LOCK or a big enough RLIMIT_MEMLOCK; not fatal
+        if (mlock(seg.base, seg.size) < 0) perror("mlock (continuing unlocked)");
+    }
+    return true;
+}
+
+// Opens the backing object for `name`. `create` makes it (and sizes it) if
+// needed; otherwise `wait` retries until the owner has created and sized it.
+inline int open_backing(const std::string& name, size_t length, bool create, bool wait,
+                        const SegmentOptions& opts) {
+    int fd = -1;
+    int flags = create ? (O_CREAT | O_RDWR) : O_RDWR;
+    switch (opts.backing) {
+        case SegmentBacking::File: {
+            std::string path = "/tmp/" + name;
+            while ((fd = open(path.c_str(), flags, 0600)) < 0 && wait && errno == ENOENT) {
+                std::this_thread::sleep_for(OWNER_POLL);
+            }
+            if (fd < 0) perror("open");
+            break;
+        }
+        case SegmentBacking::PosixShm: {
+            std::string path = "/" + name;
+            while ((fd = shm_open(path.c_str(), flags, 0600)) < 0 && wait && errno == ENOENT) {
+                std::this_thread::sleep_for(OWNER_POLL);
+            }
+            if (fd < 0) perror("shm_open");
+            break;
+        }
+        case SegmentBacking::Memfd: {
+#if defined(__linux__) && defined(SYS_memfd_create)
+            if (!create) return receive_fd(name, wait);
+            unsigned int flags = MFD_CLOEXEC;
+            if (opts.huge == HugePages::HugeTlb) flags |= MFD_HUGETLB;
+            fd = (int)syscall(SYS_memfd_create, name.c_str(), flags);
+            if (fd < 0) perror("memfd_create");
+#else
+            std::cerr << "memfd backing is only available on Linux\n";
+#endif
+            break;
+        }
+    }
+    if (fd < 0) return -1;
+    if (opts.huge == HugePages::HugeTlb && opts.backing != SegmentBacking::Memfd) {
+        std::cerr << "--huge=hugetlb requires --backing=memfd\n";
+        close(fd);
+        return -1;
+    }
+    if (create) {
+        struct stat st{};
+        fstat(fd, &st);
+        if ((size_t)st.st_size < length && ftruncate(fd, length) < 0) {
+            perror("ftruncate");
+            close(fd);
+            return -1;
+        }
+    }
+    // Mapping past the end of a file the owner has not sized yet would SIGBUS
+    struct stat st{};
+    while (wait && fstat(fd, &st) == 0 && (size_t)st.st_size < length) {
+        std::this_thread::sleep_for(OWNER_POLL);
+    }
+    return fd;
+}
+
+inline void release_segment(Segment& seg) {
+    if (seg.base) munmap(seg.base, seg.size);
+    if (seg.fd >= 0) close(seg.fd);
+    seg.base = nullptr;
+    seg.fd = -1;
+}
+
+// Creates (or reopens) the segment as its owner. For memfd backing the fd is
+// then served to subscribers until this process exits; serving starts only
+// once the mapping succeeded, so a failed segment is never handed out.
+inline Segment create_segment(const std::string& name, size_t size, const SegmentOptions& opts) {
+    Segment seg;
+    seg.size = segment_length(size, opts);
+    seg.fd = open_backing(name, seg.size, true, false, opts);
+    if (seg.fd < 0) return seg;
+    if (!map_fd(seg, opts) ||
+        (opts.backing == SegmentBacking::Memfd && !serve_fd(name, seg.fd))) {
+        release_segment(seg);
+    }
+    return seg;
+}
+
+// Attaches to a segment created by create_segment() with the same options.
+// With `wait_for_owner`, blocks until the segment exists instead of failing.
+inline Segment attach_segment(const std::string& name, size_t size, const SegmentOptions& opts,
+                              bool wait_for_owner = false) {
+    Segment seg;
+    seg.size = segment_length(size, opts);
+    seg.fd = open_backing(name, seg.size, false, wait_for_owner, opts);
+    if (seg.fd < 0) return seg;
+    if (!map_fd(seg, opts)) release_segment(seg);
+    return seg;
+}
+
+// Whether a named (file or shm) segment exists; memfd segments have no name
+inline bool segment_exists(const std::string& name, const SegmentOptions& opts) {
+    struct stat st{};
+    if (opts.backing == SegmentBacking::File) return stat(("/tmp/" + name).c_str(), &st) == 0;
+    if (opts.backing != SegmentBacking::PosixShm) return false;
+    int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+    if (fd >= 0) close(fd);
+    return fd >= 0;
+}
+
+// Unlinks a named segment; processes that still map it keep their mapping
+inline void remove_segment(const std::string& name, const SegmentOptions& opts) {
+    if (opts.backing == SegmentBacking::File) unlink(("/tmp/" + name).c_str());
+    else if (opts.backing == SegmentBacking::PosixShm) shm_unlink(("/" + name).c_str());
+}
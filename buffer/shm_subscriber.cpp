@@ -1,11 +1,13 @@
 // Usage: ./shm_subscriber <shm_name>
 // Consumer polls ring buffer, echoes by updating t_ns to its timestamp.
+// May be started before the publisher: waits for the segment to be created.
 
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <chrono>
 #include <cstring>
 #include <iostream>
@@ -36,8 +38,16 @@ int main(int argc, char** argv) {
 
     size_t total_size = sizeof(ShmHeader) + RING_SIZE * sizeof(ShmMsg);
 
-    int fd = open(name.c_str(), O_RDWR, 0600);
+    int fd;
+    while ((fd = open(name.c_str(), O_RDWR, 0600)) < 0 && errno == ENOENT) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
     if (fd < 0) { perror("open"); return 1; }
+    // Mapping before the publisher has sized the file would SIGBUS on access
+    struct stat st{};
+    while (fstat(fd, &st) == 0 && (size_t)st.st_size < total_size) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
     void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     if (base == MAP_FAILED) { perror("mmap"); return 1; }
 
@@ -1,11 +1,15 @@
 // Improved SHM Subscriber with std::atomic_ref and better synchronization
-// Usage: ./shm_subscriber_improved <shm_name>
+// Usage: ./shm_subscriber_improved <shm_name> [--layout=aligned|packed] [--batch=N]
+//                                  [--wait=backoff|spin|yield|futex]
+//                                  [--backing=shm|file|memfd] [--huge=none|thp|hugetlb] [--prefault] [--numa-node=N]
+//
+// Segment options must match the publisher's; see shm_segment.hpp.
+// May start before the publisher: it waits for the segment, and if the
+// publisher dies or restarts it drains the ring and attaches again.
 
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstring>
@@ -13,96 +17,228 @@
 #include <string>
 #include <thread>
 
+#include "shm_control.hpp"
+#include "shm_segment.hpp"
+#include "shm_wait_strategy.hpp"
+
 using namespace std;
 using ns = chrono::nanoseconds;
 using clk = chrono::high_resolution_clock;
 
 constexpr size_t MSG_SIZE = 64;
 constexpr size_t RING_SIZE = 1024;
-constexpr size_t MAX_BACKOFF = 1000; // Maximum backoff iterations
+// Cursors are padded to two cache lines so the adjacent-line prefetcher does
+// not pull the other side's cursor in with ours.
+constexpr size_t CACHE_LINE = 128;
 
-struct ShmHeader {
+// Original layout: both cursors share one cache line. The header is only
+// padded to a whole line so the slots after it stay aligned for ShmMsg.
+struct alignas(64) PackedShmHeader {
     std::atomic<uint64_t> head; // Producer index
     std::atomic<uint64_t> tail; // Consumer index
-    std::atomic<bool> initialized; // Initialization flag
+    WaitPoint data_ready;  // Subscriber sleeps here waiting for head
+    WaitPoint space_ready; // Publisher sleeps here waiting for tail
+};
+
+// Producer and consumer cursors on separate lines; slots start aligned
+struct AlignedShmHeader {
+    alignas(CACHE_LINE) std::atomic<uint64_t> head; // Producer index
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail; // Consumer index
+    alignas(CACHE_LINE) WaitPoint data_ready;  // Subscriber sleeps here waiting for head
+    alignas(CACHE_LINE) WaitPoint space_ready; // Publisher sleeps here waiting for tail
 };
 
-struct ShmMsg {
+struct alignas(64) ShmMsg {
     uint64_t seq;
     uint64_t t_ns;
     char payload[MSG_SIZE - 16];
 };
 
-class ExponentialBackoff {
+static_assert((sizeof(ControlBlock) + sizeof(PackedShmHeader)) % alignof(ShmMsg) == 0,
+              "packed slots must start aligned for ShmMsg");
+static_assert((sizeof(ControlBlock) + sizeof(AlignedShmHeader)) % alignof(ShmMsg) == 0,
+              "aligned slots must start aligned for ShmMsg");
+
+// Baseline for before/after comparisons: shared line, remote cursor reloaded every time
+struct PackedLayout {
+    using Header = PackedShmHeader;
+    static constexpr const char* name = "packed";
+    static constexpr uint32_t id = 1; // Recorded in the ControlBlock geometry
+    static constexpr bool cache_remote_cursor = false;
+};
+
+// Separate lines and a locally cached copy of the producer's head
+struct AlignedLayout {
+    using Header = AlignedShmHeader;
+    static constexpr const char* name = "aligned";
+    static constexpr uint32_t id = 2;
+    static constexpr bool cache_remote_cursor = true;
+};
+
+template <typename Layout>
+size_t segment_size() {
+    return sizeof(ControlBlock) + sizeof(typename Layout::Header) + RING_SIZE * sizeof(ShmMsg);
+}
+
+template <typename Layout>
+SegmentGeometry segment_geometry(uint32_t wait_strategy) {
+    return {Layout::id, (uint32_t)sizeof(ShmMsg), RING_SIZE, wait_strategy};
+}
+
+// Consumer side of the SPSC ring. consume_batch() hands up to max_n
+// messages to the callback in place and frees them with one release store.
+template <typename Layout, typename Wait>
+class RingConsumer {
 private:
-    int current_delay;
-    int max_delay;
-    
+    using Header = typename Layout::Header;
+    Header* hdr;
+    const ShmMsg* msgs;
+    uint64_t tail;        // Local copy of hdr->tail (we are the only reader)
+    uint64_t cached_head; // Reloaded only when the ring looks empty
+    Wait waiter;
+
 public:
-    ExponentialBackoff(int initial = 1, int max = MAX_BACKOFF) 
-        : current_delay(initial), max_delay(max) {}
-    
-    void wait() {
-        for (int i = 0; i < current_delay; ++i) {
-            std::this_thread::yield();
+    explicit RingConsumer(void* base)
+        : hdr(reinterpret_cast<Header*>(base)),
+          msgs(reinterpret_cast<const ShmMsg*>((char*)base + sizeof(Header))),
+          tail(hdr->tail.load(memory_order_acquire)),
+          cached_head(hdr->head.load(memory_order_acquire)) {}
+
+    // Returns the number of messages consumed; 0 means the ring was empty.
+    template <typename Callback>
+    size_t consume_batch(size_t max_n, Callback&& callback) {
+        if (tail == cached_head || !Layout::cache_remote_cursor) {
+            cached_head = hdr->head.load(memory_order_acquire);
         }
-        current_delay = min(current_delay * 2, max_delay);
+        size_t n = min<uint64_t>(cached_head - tail, max_n);
+        if (n == 0) return 0;
+
+        for (size_t k = 0; k < n; ++k) {
+            callback(msgs[(tail + k) % RING_SIZE]);
+        }
+        tail += n;
+        hdr->tail.store(tail, memory_order_release);
+        notify<Wait>(hdr->space_ready);
+        return n;
     }
-    
-    void reset() {
-        current_delay = 1;
+
+    // Block (per the wait strategy) until the producer has published more,
+    // or until `lost` is raised by the heartbeat thread
+    void wait_for_data(const atomic<bool>& lost) {
+        waiter.wait_until(hdr->data_ready, [&] {
+            cached_head = hdr->head.load(memory_order_acquire);
+            return cached_head != tail || lost.load(memory_order_relaxed);
+        });
     }
 };
 
+// Consumes until the publisher dies or a new one takes over the segment.
+// Everything already published is drained before returning.
+template <typename Layout, typename Wait>
+void run_consumer(ControlBlock* ctl, void* base, size_t max_batch, uint64_t& processed_count) {
+    auto hdr = reinterpret_cast<typename Layout::Header*>(base);
+    RingConsumer<Layout, Wait> consumer(base);
+    uint64_t next_report = processed_count - processed_count % 1000 + 1000;
+
+    uint64_t generation = ctl->generation.load(memory_order_acquire);
+    ctl->subscriber.generation.store(generation, memory_order_release);
+    atomic<bool> lost{false};
+    Heartbeat heartbeat(ctl->subscriber, [&] {
+        if (lost.load(memory_order_relaxed)) return;
+        if (!peer_alive(ctl->publisher) || ctl->generation.load(memory_order_acquire) != generation) {
+            lost.store(true, memory_order_relaxed);
+            // Kick a futex-sleeping consumer so it sees `lost`
+            FutexWait::wake(hdr->data_ready);
+        }
+    });
+
+    while (true) {
+        size_t n = consumer.consume_batch(max_batch, [](const ShmMsg& m) {
+            (void)m; // Process: just consume the message
+        });
+        if (n == 0) {
+            if (lost.load(memory_order_relaxed)) return;
+            // No new messages, block per the wait strategy
+            consumer.wait_for_data(lost);
+            continue;
+        }
+        processed_count += n;
+        
+        if (processed_count >= next_report) {
+            cout << "Processed " << processed_count << " messages\n";
+            next_report = processed_count - processed_count % 1000 + 1000;
+        }
+    }
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) { 
-        cerr << "Usage: " << argv[0] << " <shm_name>\n"; 
+        cerr << "Usage: " << argv[0] << " <shm_name> [--layout=aligned|packed] [--batch=N]"
+             << " [--wait=backoff|spin|yield|futex]"
+             << " [--backing=shm|file|memfd] [--huge=none|thp|hugetlb] [--prefault] [--numa-node=N]\n";
         return 1; 
     }
     
-    string name = "/tmp/" + string(argv[1]);
-
-    size_t total_size = sizeof(ShmHeader) + RING_SIZE * sizeof(ShmMsg);
+    string name = argv[1];
+    string layout = "aligned";
+    string wait = "backoff";
+    size_t max_batch = 256;
+    SegmentOptions seg_opts;
+    for (int a = 2; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg.rfind("--layout=", 0) == 0) layout = arg.substr(9);
+        else if (arg.rfind("--wait=", 0) == 0) wait = arg.substr(7);
+        else if (arg.rfind("--batch=", 0) == 0) max_batch = max<size_t>(1, stoul(arg.substr(8)));
+        else if (!parse_segment_option(arg, seg_opts)) {
+            cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+    if (layout != "aligned" && layout != "packed") {
+        cerr << "Unknown layout: " << layout << "\n";
+        return 1;
+    }
+    uint32_t wait_id = wait_strategy_id(wait);
+    if (wait_id == 0) {
+        cerr << "Unknown wait strategy: " << wait << "\n";
+        return 1;
+    }
 
-    int fd = open(name.c_str(), O_RDWR, 0600);
-    if (fd < 0) { perror("open"); return 1; }
+    size_t total_size = layout == "aligned" ? segment_size<AlignedLayout>() : segment_size<PackedLayout>();
+    SegmentGeometry geometry = layout == "aligned" ? segment_geometry<AlignedLayout>(wait_id)
+                                                   : segment_geometry<PackedLayout>(wait_id);
+    uint64_t processed_count = 0;
     
-    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-    if (base == MAP_FAILED) { perror("mmap"); return 1; }
-
-    auto hdr = reinterpret_cast<ShmHeader*>(base);
-    auto msgs = reinterpret_cast<ShmMsg*>((char*)base + sizeof(ShmHeader));
+    // Attach, consume until the publisher goes away, then attach again: a
+    // restarted publisher may have a new segment (memfd) or resume this one
+    while (true) {
+        Segment seg = attach_segment(name, total_size, seg_opts, /*wait_for_owner=*/true);
+        if (!seg.base) return 1;
+        auto ctl = reinterpret_cast<ControlBlock*>(seg.base);
+        void* base = (char*)seg.base + sizeof(ControlBlock);
 
-    cout << "shm_sub_improved started on " << name << "\n";
-    
-    ExponentialBackoff backoff;
-    uint64_t processed_count = 0;
+        if (!wait_for_publisher(*ctl, geometry) || !claim_slot(ctl->subscriber, "subscriber")) {
+            release_segment(seg);
+            return 1;
+        }
 
-    while (true) {
-        // Check for new messages with exponential backoff
-        uint64_t current_head = hdr->head.load(memory_order_acquire);
-        uint64_t current_tail = hdr->tail.load(memory_order_acquire);
+        cout << "shm_sub_improved attached to " << name << " layout=" << layout << " wait=" << wait
+             << " backing=" << backing_name(seg_opts.backing)
+             << " generation=" << ctl->generation.load(memory_order_acquire) << "\n";
         
-        if (current_tail < current_head) {
-            // Process message
-            uint64_t idx = current_tail % RING_SIZE;
-            ShmMsg &m = msgs[idx];
-            
-            // Process: just consume the message
-            hdr->tail.store(current_tail + 1, memory_order_release);
-            processed_count++;
-            backoff.reset();
-            
-            if (processed_count % 1000 == 0) {
-                cout << "Processed " << processed_count << " messages\n";
+        bool known = dispatch_wait_strategy(wait, [&](auto strategy) {
+            using Wait = decltype(strategy);
+            if (layout == "aligned") {
+                run_consumer<AlignedLayout, Wait>(ctl, base, max_batch, processed_count);
+            } else {
+                run_consumer<PackedLayout, Wait>(ctl, base, max_batch, processed_count);
             }
-        } else {
-            // No new messages, use exponential backoff
-            backoff.wait();
+        });
+        release_segment(seg);
+        if (!known) {
+            cerr << "Unknown wait strategy: " << wait << "\n";
+            return 1;
         }
+        cout << "Publisher gone after " << processed_count << " messages, reattaching\n";
     }
-
-    munmap(base, total_size);
-    close(fd);
-    return 0;
 }
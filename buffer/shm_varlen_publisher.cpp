@@ -0,0 +1,234 @@
+// SHM Variable-Length Publisher: length-prefixed records in a byte ring
+// Usage: ./shm_varlen_publisher <shm_name> <count> [min_size] [max_size]
+//
+// Unlike the fixed 64-byte ShmMsg rings, records here take only as many bytes
+// as their payload needs (rounded to RECORD_ALIGN). Writers reserve space in
+// place, fill it and commit; nothing is copied through an intermediate buffer.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/clock.hpp"
+#include "../common/stats.hpp"
+
+using namespace std;
+using pubsub::now_ns;
+using ns = chrono::nanoseconds;
+using clk = chrono::high_resolution_clock;
+
+constexpr size_t RING_BYTES = 1 << 20; // Must be a power of two
+constexpr size_t RING_MASK = RING_BYTES - 1;
+constexpr size_t RECORD_ALIGN = 8;
+constexpr size_t MAX_BACKOFF = 1000; // Maximum backoff iterations
+constexpr size_t CACHE_LINE = 128;
+
+static_assert((RING_BYTES & RING_MASK) == 0, "RING_BYTES must be a power of two");
+
+struct ShmHeader {
+    alignas(CACHE_LINE) std::atomic<uint64_t> head; // Bytes committed by the producer
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail; // Bytes released by the consumer
+    alignas(CACHE_LINE) std::atomic<bool> initialized; // Initialization flag
+    // byte ring follows
+};
+
+enum : uint32_t { REC_DATA = 0, REC_PADDING = 1 };
+
+// Prefix of every record; `len` is the payload length for data records and
+// the number of skipped bytes (including this prefix) for padding records.
+struct RecordHeader {
+    uint32_t len;
+    uint32_t type;
+};
+
+// Header every benchmark payload starts with
+struct VarMsg {
+    uint64_t seq;
+    uint64_t t_ns;
+};
+
+static constexpr size_t record_bytes(size_t payload_len) {
+    return (sizeof(RecordHeader) + payload_len + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+}
+
+// Largest payload whose whole record (header included) fits in half the ring,
+// so padding plus the record always fits once the ring drains
+constexpr size_t MAX_RECORD = (RING_BYTES / 2 - sizeof(RecordHeader)) & ~(RECORD_ALIGN - 1);
+static_assert(record_bytes(MAX_RECORD) <= RING_BYTES / 2, "MAX_RECORD must fit after a wrap");
+
+class ExponentialBackoff {
+private:
+    int current_delay;
+    int max_delay;
+
+public:
+    ExponentialBackoff(int initial = 1, int max = MAX_BACKOFF)
+        : current_delay(initial), max_delay(max) {}
+
+    void wait() {
+        for (int i = 0; i < current_delay; ++i) {
+            std::this_thread::yield();
+        }
+        current_delay = min(current_delay * 2, max_delay);
+    }
+
+    void reset() {
+        current_delay = 1;
+    }
+};
+
+// Single-producer side of the byte ring. reserve() hands out a pointer into
+// the ring itself; commit() publishes it with one release store.
+class ByteRingProducer {
+private:
+    ShmHeader* hdr;
+    char* data;
+    uint64_t head;         // Local copy of hdr->head (we are the only writer)
+    uint64_t cached_tail;  // Reloaded only when the ring looks full
+    uint64_t pending_head; // Where head moves on commit()
+    RecordHeader* pending = nullptr;
+    ExponentialBackoff backoff;
+
+    bool has_space(uint64_t bytes) {
+        if (head + bytes - cached_tail <= RING_BYTES) return true;
+        cached_tail = hdr->tail.load(memory_order_acquire);
+        return head + bytes - cached_tail <= RING_BYTES;
+    }
+
+public:
+    ByteRingProducer(ShmHeader* h, char* d)
+        : hdr(h), data(d),
+          head(h->head.load(memory_order_acquire)),
+          cached_tail(h->tail.load(memory_order_acquire)),
+          pending_head(head) {}
+
+    // Blocks until `len` contiguous payload bytes are free. If the record would
+    // straddle the end of the ring, the remainder is filled with a padding
+    // record and the payload starts at offset 0.
+    char* reserve(size_t len) {
+        if (len > MAX_RECORD) return nullptr;
+        size_t need = record_bytes(len);
+        size_t offset = head & RING_MASK;
+        size_t contiguous = RING_BYTES - offset;
+        size_t pad = need > contiguous ? contiguous : 0;
+
+        while (!has_space(pad + need)) backoff.wait();
+        backoff.reset();
+
+        if (pad) {
+            auto rec = reinterpret_cast<RecordHeader*>(data + offset);
+            rec->len = (uint32_t)pad;
+            rec->type = REC_PADDING;
+            offset = 0;
+        }
+        pending = reinterpret_cast<RecordHeader*>(data + offset);
+        pending->len = (uint32_t)len;
+        pending->type = REC_DATA;
+        pending_head = head + pad + need;
+        return reinterpret_cast<char*>(pending + 1);
+    }
+
+    void commit() {
+        head = pending_head;
+        pending = nullptr;
+        hdr->head.store(head, memory_order_release);
+    }
+
+    uint64_t position() const { return head; }
+};
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " <shm_name> <count> [min_size] [max_size]\n";
+        return 1;
+    }
+
+    string name = "/tmp/" + string(argv[1]);
+    int count = stoi(argv[2]);
+    size_t min_size = argc > 3 ? stoul(argv[3]) : 40;
+    size_t max_size = argc > 4 ? stoul(argv[4]) : 8192;
+    min_size = max(min_size, sizeof(VarMsg));
+    max_size = max(max_size, min_size);
+    if (max_size > MAX_RECORD) {
+        cerr << "max_size must be <= " << MAX_RECORD << "\n";
+        return 1;
+    }
+
+    size_t total_size = sizeof(ShmHeader) + RING_BYTES;
+
+    // Use a regular file for shared memory on macOS
+    int fd = open(name.c_str(), O_CREAT | O_RDWR, 0600);
+    if (fd < 0) { perror("open"); return 1; }
+
+    if (ftruncate(fd, total_size) < 0) {
+        perror("ftruncate");
+        close(fd);
+        return 1;
+    }
+
+    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap"); return 1; }
+
+    auto hdr = reinterpret_cast<ShmHeader*>(base);
+    auto data = reinterpret_cast<char*>(base) + sizeof(ShmHeader);
+
+    // Initialize header if first time
+    bool expected = false;
+    if (hdr->initialized.compare_exchange_strong(expected, true)) {
+        hdr->head.store(0, memory_order_relaxed);
+        hdr->tail.store(0, memory_order_relaxed);
+    }
+
+    ByteRingProducer producer(hdr, data);
+
+    // Pre-draw sizes so the RNG stays off the timed path
+    mt19937_64 rng(42);
+    uniform_int_distribution<size_t> size_dist(min_size, max_size);
+    vector<size_t> sizes(count);
+    for (auto& s : sizes) s = size_dist(rng);
+
+    pubsub::Histogram rtts; // ns
+    uint64_t total_bytes = 0;
+
+    ExponentialBackoff backoff;
+
+    for (uint64_t i = 0; i < (uint64_t)count; ++i) {
+        size_t len = sizes[i];
+        char* payload = producer.reserve(len);
+
+        uint64_t send_ns = now_ns();
+        VarMsg stamp{i, send_ns};
+        memcpy(payload, &stamp, sizeof(stamp));
+        memset(payload + sizeof(stamp), (int)(i & 0xff), len - sizeof(stamp));
+        producer.commit();
+        total_bytes += len;
+
+        // Wait for consumer to release the record
+        while (hdr->tail.load(memory_order_acquire) < producer.position()) {
+            backoff.wait();
+        }
+        backoff.reset();
+
+        uint64_t recv_ns = now_ns();
+        rtts.record(recv_ns - send_ns);
+    }
+
+    cout << "SHM varlen pub avg_payload_B=" << (count ? total_bytes / count : 0);
+    pubsub::print_rtt_fields(cout, pubsub::summarize(rtts));
+    cout << "\n";
+
+    munmap(base, total_size);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,179 @@
+// SHM Variable-Length Subscriber: reads length-prefixed records in place
+// Usage: ./shm_varlen_subscriber <shm_name>
+//
+// peek() returns a view straight into the ring; release() frees the record
+// for the producer once we are done with it.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+using ns = chrono::nanoseconds;
+using clk = chrono::high_resolution_clock;
+
+constexpr size_t RING_BYTES = 1 << 20; // Must be a power of two
+constexpr size_t RING_MASK = RING_BYTES - 1;
+constexpr size_t RECORD_ALIGN = 8;
+constexpr size_t MAX_BACKOFF = 1000; // Maximum backoff iterations
+constexpr size_t CACHE_LINE = 128;
+
+static_assert((RING_BYTES & RING_MASK) == 0, "RING_BYTES must be a power of two");
+
+struct ShmHeader {
+    alignas(CACHE_LINE) std::atomic<uint64_t> head; // Bytes committed by the producer
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail; // Bytes released by the consumer
+    alignas(CACHE_LINE) std::atomic<bool> initialized; // Initialization flag
+};
+
+enum : uint32_t { REC_DATA = 0, REC_PADDING = 1 };
+
+// Prefix of every record; `len` is the payload length for data records and
+// the number of skipped bytes (including this prefix) for padding records.
+struct RecordHeader {
+    uint32_t len;
+    uint32_t type;
+};
+
+// Header every benchmark payload starts with
+struct VarMsg {
+    uint64_t seq;
+    uint64_t t_ns;
+};
+
+static constexpr size_t record_bytes(size_t payload_len) {
+    return (sizeof(RecordHeader) + payload_len + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+}
+
+class ExponentialBackoff {
+private:
+    int current_delay;
+    int max_delay;
+
+public:
+    ExponentialBackoff(int initial = 1, int max = MAX_BACKOFF)
+        : current_delay(initial), max_delay(max) {}
+
+    void wait() {
+        for (int i = 0; i < current_delay; ++i) {
+            std::this_thread::yield();
+        }
+        current_delay = min(current_delay * 2, max_delay);
+    }
+
+    void reset() {
+        current_delay = 1;
+    }
+};
+
+struct RecordView {
+    const char* data;
+    size_t len;
+};
+
+// Single-consumer side of the byte ring. Padding records are skipped inside
+// peek(), so callers only ever see data records.
+class ByteRingConsumer {
+private:
+    ShmHeader* hdr;
+    const char* data;
+    uint64_t tail;        // Local copy of hdr->tail (we are the only reader)
+    uint64_t cached_head; // Reloaded only when the ring looks empty
+    size_t current_bytes = 0;
+
+public:
+    ByteRingConsumer(ShmHeader* h, const char* d)
+        : hdr(h), data(d),
+          tail(h->tail.load(memory_order_acquire)),
+          cached_head(h->head.load(memory_order_acquire)) {}
+
+    // Returns false when no record is available.
+    bool peek(RecordView& out) {
+        while (true) {
+            if (tail == cached_head) {
+                cached_head = hdr->head.load(memory_order_acquire);
+                if (tail == cached_head) return false;
+            }
+            auto rec = reinterpret_cast<const RecordHeader*>(data + (tail & RING_MASK));
+            if (rec->type == REC_PADDING) {
+                tail += rec->len;
+                continue;
+            }
+            out.data = reinterpret_cast<const char*>(rec + 1);
+            out.len = rec->len;
+            current_bytes = record_bytes(rec->len);
+            return true;
+        }
+    }
+
+    void release() {
+        tail += current_bytes;
+        current_bytes = 0;
+        hdr->tail.store(tail, memory_order_release);
+    }
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <shm_name>\n";
+        return 1;
+    }
+
+    string name = "/tmp/" + string(argv[1]);
+
+    size_t total_size = sizeof(ShmHeader) + RING_BYTES;
+
+    int fd = open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) { perror("open"); return 1; }
+
+    void* base = mmap(nullptr, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) { perror("mmap"); return 1; }
+
+    auto hdr = reinterpret_cast<ShmHeader*>(base);
+    auto data = reinterpret_cast<const char*>(base) + sizeof(ShmHeader);
+
+    cout << "shm_varlen_sub started on " << name << "\n";
+
+    ByteRingConsumer consumer(hdr, data);
+    ExponentialBackoff backoff;
+    uint64_t processed_count = 0;
+    uint64_t processed_bytes = 0;
+    uint64_t expected_seq = 0;
+
+    while (true) {
+        RecordView rec;
+        if (!consumer.peek(rec)) {
+            backoff.wait();
+            continue;
+        }
+
+        // Process: check the sequence number in place, without copying the payload
+        VarMsg stamp;
+        memcpy(&stamp, rec.data, sizeof(stamp));
+        if (stamp.seq != expected_seq && stamp.seq != 0) {
+            cerr << "Sequence gap: expected " << expected_seq << " got " << stamp.seq << "\n";
+        }
+        expected_seq = stamp.seq + 1;
+        processed_bytes += rec.len;
+        consumer.release();
+        processed_count++;
+        backoff.reset();
+
+        if (processed_count % 1000 == 0) {
+            cout << "Processed " << processed_count << " messages ("
+                 << processed_bytes << " bytes)\n";
+        }
+    }
+
+    munmap(base, total_size);
+    close(fd);
+    return 0;
+}
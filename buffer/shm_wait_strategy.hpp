@@ -0,0 +1,172 @@
+// Wait strategies for the improved SHM ring
+//
+// Both sides of the ring pick one of these at compile time (the binaries
+// dispatch on --wait=...). A strategy blocks in wait_until() until `ready()`
+// holds; the other side calls notify<Strategy>() after every cursor store so
+// that sleeping strategies can be woken. Only FutexWait needs the notify, and
+// it only costs a syscall when a waiter has announced itself.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+constexpr int SPIN_LIMIT = 1000;        // Polls before a spin-then-X strategy gives up the CPU
+constexpr int MAX_BACKOFF_YIELDS = 1000; // Cap for BackoffWait's doubling
+
+// One per direction in the shared header. `seq` is the futex word: notifiers
+// bump it so a waiter that read the old value never sleeps through a wake.
+struct WaitPoint {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> waiters;
+};
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+// Pure busy-poll with a pause hint: lowest wake-up latency, one full core per waiter.
+struct BusySpinWait {
+    static constexpr const char* name = "spin";
+    static constexpr uint32_t id = 1;
+    static constexpr bool needs_notify = false;
+
+    template <typename Ready>
+    void wait_until(WaitPoint&, Ready ready) {
+        while (!ready()) cpu_relax();
+    }
+};
+
+// Spin briefly, then hand the core back to the scheduler between polls.
+struct SpinYieldWait {
+    static constexpr const char* name = "yield";
+    static constexpr uint32_t id = 2;
+    static constexpr bool needs_notify = false;
+
+    template <typename Ready>
+    void wait_until(WaitPoint&, Ready ready) {
+        for (int i = 0; i < SPIN_LIMIT; ++i) {
+            if (ready()) return;
+            cpu_relax();
+        }
+        while (!ready()) std::this_thread::yield();
+    }
+};
+
+// The original ExponentialBackoff: doubling bursts of yields, never sleeps.
+struct BackoffWait {
+    static constexpr const char* name = "backoff";
+    static constexpr uint32_t id = 3;
+    static constexpr bool needs_notify = false;
+
+    template <typename Ready>
+    void wait_until(WaitPoint&, Ready ready) {
+        int delay = 1;
+        while (!ready()) {
+            for (int i = 0; i < delay; ++i) std::this_thread::yield();
+            delay = std::min(delay * 2, MAX_BACKOFF_YIELDS);
+        }
+    }
+};
+
+// Spin briefly, then sleep in the kernel on the WaitPoint's futex word until
+// the other side notifies. Idle waiters cost no CPU.
+struct FutexWait {
+    static constexpr const char* name = "futex";
+    static constexpr uint32_t id = 4;
+    static constexpr bool needs_notify = true;
+
+    template <typename Ready>
+    void wait_until(WaitPoint& wp, Ready ready) {
+        for (int i = 0; i < SPIN_LIMIT; ++i) {
+            if (ready()) return;
+            cpu_relax();
+        }
+        while (true) {
+            // Read the futex word before announcing ourselves: any notify that
+            // lands after this point changes it and makes FUTEX_WAIT return.
+            uint32_t seen = wp.seq.load(std::memory_order_acquire);
+            wp.waiters.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (ready()) {
+                wp.waiters.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            sleep_on(wp, seen);
+            wp.waiters.fetch_sub(1, std::memory_order_relaxed);
+            if (ready()) return;
+        }
+    }
+
+    static void wake(WaitPoint& wp) {
+        wp.seq.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+        // Not FUTEX_PRIVATE: the word lives in a mapping shared across processes
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&wp.seq), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+    }
+
+private:
+    static void sleep_on(WaitPoint& wp, uint32_t seen) {
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&wp.seq), FUTEX_WAIT, seen, nullptr, nullptr, 0);
+#else
+        (void)wp;
+        (void)seen;
+        std::this_thread::yield();
+#endif
+    }
+};
+
+// Call after publishing a cursor the other side may be waiting on. The fence
+// orders our cursor store before the waiter-count load (pairs with the
+// waiter's seq_cst fetch_add), so either we see the waiter or it sees the data.
+template <typename Wait>
+inline void notify(WaitPoint& wp) {
+    if constexpr (Wait::needs_notify) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (wp.waiters.load(std::memory_order_relaxed) != 0) {
+            Wait::wake(wp);
+        }
+    } else {
+        (void)wp;
+    }
+}
+
+// Calls fn(Strategy{}) for the strategy named on the command line; false if unknown.
+template <typename Fn>
+inline bool dispatch_wait_strategy(const std::string& name, Fn&& fn) {
+    if (name == BusySpinWait::name) { fn(BusySpinWait{}); return true; }
+    if (name == SpinYieldWait::name) { fn(SpinYieldWait{}); return true; }
+    if (name == BackoffWait::name) { fn(BackoffWait{}); return true; }
+    if (name == FutexWait::name) { fn(FutexWait{}); return true; }
+    return false;
+}
+
+// Strategy id recorded in the segment so both sides agree on it (a sleeping
+// waiter is only woken by a peer whose notify() is not compiled out); 0 if unknown.
+inline uint32_t wait_strategy_id(const std::string& name) {
+    uint32_t id = 0;
+    dispatch_wait_strategy(name, [&](auto strategy) { id = decltype(strategy)::id; });
+    return id;
+}
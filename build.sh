@@ -41,7 +41,11 @@ echo "Available executables:"
 echo "  UDP:           udp_publisher, udp_subscriber"
 echo "  Shared Memory: shm_publisher, shm_subscriber"
 echo "  Improved SHM:  shm_publisher_improved, shm_subscriber_improved"
-echo "  ZeroMQ:        zmq_publisher, zmq_subscriber"
+echo "  Broadcast SHM: shm_broadcast_publisher, shm_broadcast_subscriber"
+echo "  MPMC SHM:      shm_mpmc_publisher, shm_mpmc_subscriber, shm_mpmc_bench"
+echo "  Varlen SHM:    shm_varlen_publisher, shm_varlen_subscriber"
+echo "  ZeroMQ:        zmq_publisher, zmq_subscriber, zmq_proxy"
+echo "  Common:        pubsub_bench (one driver over udp, shm and zmq), topic_bench (shared-memory topic registry)"
 echo "  Test Harness:  latency_test"
 echo ""
 echo "To run all tests:"
@@ -50,5 +54,6 @@ echo ""
 echo "To run individual tests:"
 echo "  make run_udp_test"
 echo "  make run_shm_test"
+echo "  make run_shm_mpmc_bench"
 echo "  make run_zmq_test"
 echo "  make run_all_tests"
@@ -0,0 +1,136 @@
+// Usage: ./pubsub_bench pub <udp|shm|zmq> <address> <count> [--warmup=N] [--rate=R] [--payload=B]
+//                          [--hgrm=FILE] [--results=FILE] [placement options]
+//        ./pubsub_bench sub <udp|shm|zmq> <address> [placement options]
+// One ping-pong benchmark over any transport in common/: the same driver,
+// message, clock and statistics for all of them, so their numbers compare
+// directly. Addresses (see transport.hpp):
+//
+//   ./pubsub_bench sub udp 5555               ./pubsub_bench pub udp 127.0.0.1:5555 10000
+//   ./pubsub_bench sub shm bench_shm          ./pubsub_bench pub shm bench_shm 10000
+//   ./pubsub_bench sub zmq tcp://*:5556       ./pubsub_bench pub zmq tcp://127.0.0.1:5556 10000
+//
+// --warmup=N   untimed round trips before the measured ones (default 1000)
+// --rate=R     open loop: send R msg/s on a fixed schedule whatever the
+//              replies do, timing each reply from its ping's due time (see
+//              run_open_loop() in driver.hpp); prints the rate achieved
+// --payload=B  B bytes of payload after each Msg (default 0, at most 65000),
+//              from a pre-generated pool; the subscriber checksums each one
+//              and the publisher validates the echo (see payload.hpp)
+// --hgrm=FILE  also write the RTT percentile distribution (HdrHistogram
+//              .hgrm text, µs) to FILE
+// --results=FILE  also write the RTT histogram in Histogram::encode() form,
+//              which latency_test reads back to merge and compare runs
+//
+// Placement options (see topology.hpp), on either side:
+// --cpu=N        pin to CPU N before the transport starts any threads
+// --fifo         run SCHED_FIFO, if permitted
+// --mlock        mlockall() once the transport is set up, if permitted
+// --numa-node=N  shm only: mbind() the segment to NUMA node N (the publisher
+//              creates it, so pass it there)
+// --nt-stores    shm only: copy payloads into the segment with non-temporal
+//              stores (pass it to both sides: each copies its own direction)
+//
+// The publisher first prints a "Clock" line: the clock behind every timestamp
+// (see clock.hpp) and what one read of it costs.
+
+#include <iostream>
+#include <string>
+
+#include <type_traits>
+
+#include "driver.hpp"
+#include "shm_transport.hpp"
+#include "topology.hpp"
+#include "udp_transport.hpp"
+#include "zmq_transport.hpp"
+
+using namespace std;
+using namespace pubsub;
+
+constexpr uint64_t DEFAULT_WARMUP = 1000;
+
+struct PlacementOptions {
+    int cpu = -1;
+    bool fifo = false;
+    bool mlock = false;
+    int numa_node = -1;
+    bool nt_stores = false;
+};
+
+template <typename Transport>
+static Transport open_transport(Role role, const string& address, const PlacementOptions& p) {
+    if constexpr (is_same_v<Transport, ShmTransport>) {
+        SegmentOptions opts;
+        opts.numa_node = p.numa_node;
+        return ShmTransport(role, address, opts);
+    } else {
+        if (p.numa_node >= 0) cerr << "--numa-node only applies to shm\n";
+        if (p.nt_stores) cerr << "--nt-stores only applies to shm\n";
+        return Transport(role, address);
+    }
+}
+
+template <typename Transport>
+static int run(Role role, const string& address, const BenchOptions& o, const PlacementOptions& p) {
+    if (o.payload > Transport::max_payload) {
+        cerr << Transport::name << " carries at most " << Transport::max_payload << " bytes of payload\n";
+        return 1;
+    }
+    bool pinned = p.cpu >= 0 && pin_to_cpu(p.cpu);
+    bool fifo = p.fifo && set_realtime();
+    Transport t = open_transport<Transport>(role, address, p);
+    if (!t.ok()) return 1;
+    if constexpr (is_same_v<Transport, ShmTransport>) t.use_nontemporal_stores(p.nt_stores);
+    bool locked = p.mlock && lock_memory();
+    if (role == Role::Subscriber) return run_subscriber(t);
+    cout << "Clock";
+    print_clock_fields(cout);
+    cout << "\n";
+    cout << "Placement cpu=" << (pinned ? to_string(p.cpu) : "any") << " fifo=" << (fifo ? "yes" : "no")
+         << " mlock=" << (locked ? "yes" : "no")
+         << " numa_node=" << (is_same_v<Transport, ShmTransport> && p.numa_node >= 0 ? to_string(p.numa_node) : "any")
+         << " nt_stores=" << (is_same_v<Transport, ShmTransport> && p.nt_stores && have_nontemporal_stores() ? "yes" : "no")
+         << "\n";
+    return o.rate > 0 ? run_open_loop(t, o) : run_publisher(t, o);
+}
+
+int main(int argc, char** argv) {
+    string role_arg = argc > 1 ? argv[1] : "";
+    if (argc < 4 || (role_arg != "pub" && role_arg != "sub") || (role_arg == "pub" && argc < 5)) {
+        cerr << "Usage: " << argv[0] << " pub <udp|shm|zmq> <address> <count> [--warmup=N] [--rate=R] [--payload=B]"
+             << " [--hgrm=FILE] [--results=FILE] [--cpu=N] [--fifo] [--mlock] [--numa-node=N] [--nt-stores]\n"
+             << "       " << argv[0] << " sub <udp|shm|zmq> <address> [--cpu=N] [--fifo] [--mlock] [--numa-node=N]"
+             << " [--nt-stores]\n";
+        return 1;
+    }
+    Role role = role_arg == "pub" ? Role::Publisher : Role::Subscriber;
+    string transport = argv[2];
+    string address = argv[3];
+    BenchOptions o;
+    PlacementOptions p;
+    o.count = role == Role::Publisher ? stoull(argv[4]) : 0;
+    o.warmup = DEFAULT_WARMUP;
+    for (int a = role == Role::Publisher ? 5 : 4; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg.rfind("--warmup=", 0) == 0) o.warmup = stoull(arg.substr(9));
+        else if (arg.rfind("--rate=", 0) == 0) o.rate = stod(arg.substr(7));
+        else if (arg.rfind("--payload=", 0) == 0) o.payload = stoull(arg.substr(10));
+        else if (arg.rfind("--hgrm=", 0) == 0) o.hgrm_path = arg.substr(7);
+        else if (arg.rfind("--results=", 0) == 0) o.results_path = arg.substr(10);
+        else if (arg.rfind("--cpu=", 0) == 0) p.cpu = stoi(arg.substr(6));
+        else if (arg == "--fifo") p.fifo = true;
+        else if (arg == "--mlock") p.mlock = true;
+        else if (arg.rfind("--numa-node=", 0) == 0) p.numa_node = stoi(arg.substr(12));
+        else if (arg == "--nt-stores") p.nt_stores = true;
+        else {
+            cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (transport == UdpTransport::name) return run<UdpTransport>(role, address, o, p);
+    if (transport == ShmTransport::name) return run<ShmTransport>(role, address, o, p);
+    if (transport == ZmqTransport::name) return run<ZmqTransport>(role, address, o, p);
+    cerr << "Unknown transport " << transport << " (udp, shm or zmq)\n";
+    return 1;
+}
@@ -0,0 +1,341 @@
+// Clock shared by every binary and transport
+//
+// All timestamps that cross a process boundary (Msg::t_ns, one-way latency)
+// come from now_ns(), so publishers and subscribers on one host read the same
+// clock. Durations are kept in integer nanoseconds until they are printed.
+//
+// now_ns() reads the TSC when it is invariant (constant rate, running in every
+// C-state) and in step across the CPUs this process may run on. A TSC read
+// costs a fraction of clock_gettime(), which matters when the latency being
+// measured is itself tens of ns. Ticks are converted to ns with a rate and
+// base measured against CLOCK_MONOTONIC_RAW over CALIBRATION_NS.
+//
+// Every process must convert the same way, or one-way latencies between them
+// pick up the difference between two calibrations (a few ppm, i.e. µs per
+// second of uptime). So the first process after boot saves its calibration to
+// CALIBRATION_FILE, and every later one loads it before main() and only
+// checks that each CPU it may run on still agrees with it. Once uptime has
+// carried the saved base out of tolerance, the next process re-derives the
+// rate over that whole span and saves the result.
+//
+// Without a usable TSC (not x86-64, not invariant, CPUs out of step, or
+// PUBSUB_CLOCK=monotonic in the environment) now_ns() is clock_gettime()
+// on CLOCK_MONOTONIC_RAW, the same timeline.
+
+#pragma once
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define PUBSUB_HAVE_TSC 1
+#endif
+
+namespace pubsub {
+
+using clk = std::chrono::high_resolution_clock;
+
+constexpr uint64_t CALIBRATION_NS = 100000000; // Spacing of the two calibration points (once per boot)
+constexpr int CALIBRATION_SAMPLES = 64;        // Per point: the tightest bracket wins
+constexpr uint64_t TSC_SYNC_TOLERANCE_NS = 1000; // Worst allowed TSC vs. clock offset on any CPU
+constexpr const char* CALIBRATION_FILE = "/dev/shm/pubsub_tsc_calibration";
+
+enum class ClockSource { Tsc, Monotonic };
+
+struct ClockCalibration {
+    ClockSource source = ClockSource::Monotonic;
+    const char* fallback_reason = ""; // Why not the TSC, as one word
+    bool rdtscp = false;
+    uint64_t tsc_base = 0; // now_ns() = ns_base + (tsc - tsc_base) * ns_per_tick
+    uint64_t ns_base = 0;
+    double ns_per_tick = 0;
+    bool shared = false;      // Loaded from CALIBRATION_FILE rather than measured here
+    int cpus_checked = 0;     // CPUs whose TSC was compared with the clock
+    uint64_t max_skew_ns = 0; // Largest offset found among them
+};
+
+inline uint64_t monotonic_raw_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#ifdef PUBSUB_HAVE_TSC
+// RDTSCP (or LFENCE; RDTSC) waits for earlier instructions to finish, so a
+// stamp taken after an operation doesn't read before it completes
+inline uint64_t read_tsc(bool rdtscp) {
+    if (rdtscp) {
+        unsigned aux;
+        return __rdtscp(&aux);
+    }
+    _mm_lfence();
+    return __rdtsc();
+}
+
+// For brackets around code: nothing after the stamp starts before it
+inline uint64_t read_tsc_fenced(bool rdtscp) {
+    uint64_t t = read_tsc(rdtscp);
+    _mm_lfence();
+    return t;
+}
+
+// CPUID 0x80000007 EDX bit 8: the TSC ticks at a constant rate in every
+// P- and C-state
+inline bool tsc_invariant() {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007) return false;
+    __get_cpuid(0x80000007, &a, &b, &c, &d);
+    return d & (1u << 8);
+}
+
+inline bool have_rdtscp() {
+    unsigned a, b, c, d;
+    return __get_cpuid(0x80000001, &a, &b, &c, &d) && (d & (1u << 27));
+}
+
+namespace detail {
+
+// A (tsc, ns) pair taken as close together as this CPU allows: of several
+// TSC-clock-TSC brackets, the narrowest one, with the TSC at its middle
+inline void sample_tsc_clock(bool rdtscp, uint64_t& tsc, uint64_t& ns) {
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < CALIBRATION_SAMPLES; ++i) {
+        uint64_t t0 = read_tsc_fenced(rdtscp);
+        uint64_t n = monotonic_raw_ns();
+        uint64_t t1 = read_tsc_fenced(rdtscp);
+        if (t1 - t0 < best) {
+            best = t1 - t0;
+            tsc = t0 + (t1 - t0) / 2;
+            ns = n;
+        }
+    }
+}
+
+// Offset of each allowed CPU's TSC from the calibrated clock, measured on a
+// thread pinned there; the largest is the skew
+inline void check_cpus(ClockCalibration& c) {
+    c.cpus_checked = 0;
+    c.max_skew_ns = 0;
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        uint64_t skew = 0;
+        std::thread probe([&] {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(one), &one) != 0) return;
+            uint64_t tsc = 0, ns = 0;
+            sample_tsc_clock(c.rdtscp, tsc, ns);
+            double predicted = (double)c.ns_base + ((double)tsc - (double)c.tsc_base) * c.ns_per_tick;
+            skew = (uint64_t)std::abs(predicted - (double)ns);
+        });
+        probe.join();
+        ++c.cpus_checked;
+        c.max_skew_ns = std::max(c.max_skew_ns, skew);
+    }
+}
+
+inline void measure(ClockCalibration& c) {
+    uint64_t tsc0 = 0, ns0 = 0, tsc1 = 0, ns1 = 0;
+    sample_tsc_clock(c.rdtscp, tsc0, ns0);
+    std::this_thread::sleep_for(std::chrono::nanoseconds(CALIBRATION_NS));
+    sample_tsc_clock(c.rdtscp, tsc1, ns1);
+    c.ns_per_tick = tsc1 > tsc0 && ns1 > ns0 ? (double)(ns1 - ns0) / (double)(tsc1 - tsc0) : 0;
+    c.tsc_base = tsc1;
+    c.ns_base = ns1;
+    c.shared = false;
+}
+
+// CALIBRATION_FILE: the calibration, valid for the boot it names
+struct SavedCalibration {
+    char boot_id[40];
+    double ns_per_tick;
+    uint64_t tsc_base;
+    uint64_t ns_base;
+};
+
+inline std::string boot_id() {
+    char id[40] = {};
+    int fd = open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+    if (fd < 0) return "";
+    ssize_t n = read(fd, id, sizeof(id) - 1);
+    close(fd);
+    return n > 0 ? std::string(id, strnlen(id, sizeof(id))) : "";
+}
+
+inline bool load(ClockCalibration& c, const std::string& boot) {
+    SavedCalibration saved;
+    int fd = open(CALIBRATION_FILE, O_RDONLY);
+    if (fd < 0) return false;
+    bool ok = read(fd, &saved, sizeof(saved)) == (ssize_t)sizeof(saved) &&
+              strncmp(saved.boot_id, boot.c_str(), sizeof(saved.boot_id)) == 0 && saved.ns_per_tick > 0;
+    close(fd);
+    if (!ok) return false;
+    c.ns_per_tick = saved.ns_per_tick;
+    c.tsc_base = saved.tsc_base;
+    c.ns_base = saved.ns_base;
+    c.shared = true;
+    return true;
+}
+
+// Writes `c` to a file of its own, to be linked or renamed into place
+inline std::string write_temp(const ClockCalibration& c, const std::string& boot) {
+    SavedCalibration saved{};
+    strncpy(saved.boot_id, boot.c_str(), sizeof(saved.boot_id) - 1);
+    saved.ns_per_tick = c.ns_per_tick;
+    saved.tsc_base = c.tsc_base;
+    saved.ns_base = c.ns_base;
+    std::string tmp = std::string(CALIBRATION_FILE) + "." + std::to_string(getpid());
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return "";
+    bool written = write(fd, &saved, sizeof(saved)) == (ssize_t)sizeof(saved);
+    close(fd);
+    if (!written) unlink(tmp.c_str());
+    return written ? tmp : "";
+}
+
+// Publishes `c` unless another process got there first, in which case its
+// calibration is loaded instead: link() never replaces an existing file, so
+// every process ends up with the same one
+inline void save_or_adopt(ClockCalibration& c, const std::string& boot) {
+    std::string tmp = write_temp(c, boot);
+    if (tmp.empty()) return;
+    if (link(tmp.c_str(), CALIBRATION_FILE) != 0 && errno == EEXIST) {
+        ClockCalibration other = c;
+        if (load(other, boot)) c = other;
+        else if (unlink(CALIBRATION_FILE) == 0) link(tmp.c_str(), CALIBRATION_FILE); // Stale: an earlier boot's
+    }
+    unlink(tmp.c_str());
+}
+
+// Replaces a shared calibration that no longer fits. A rate measured over
+// CALIBRATION_NS is only good to a fraction of a ppm, so after long enough
+// uptime the saved base drifts past TSC_SYNC_TOLERANCE_NS. The rate is then
+// re-derived over the whole span since that base, which is far more precise,
+// and every process started from now on picks it up.
+inline void refine(ClockCalibration& c, const std::string& boot) {
+    uint64_t tsc = 0, ns = 0;
+    sample_tsc_clock(c.rdtscp, tsc, ns);
+    if (tsc > c.tsc_base && ns >= c.ns_base + CALIBRATION_NS) {
+        c.ns_per_tick = (double)(ns - c.ns_base) / (double)(tsc - c.tsc_base);
+        c.tsc_base = tsc;
+        c.ns_base = ns;
+        c.shared = false;
+    } else {
+        measure(c); // The TSC went backwards or was rescaled: start over
+    }
+    if (c.ns_per_tick <= 0 || boot.empty()) return;
+    std::string tmp = write_temp(c, boot);
+    if (!tmp.empty() && rename(tmp.c_str(), CALIBRATION_FILE) != 0) unlink(tmp.c_str());
+}
+
+} // namespace detail
+#endif
+
+inline ClockCalibration calibrate_clock() {
+    ClockCalibration c;
+    const char* forced = getenv("PUBSUB_CLOCK");
+    if (forced && strcmp(forced, "monotonic") == 0) {
+        c.fallback_reason = "forced";
+        return c;
+    }
+#ifdef PUBSUB_HAVE_TSC
+    if (!tsc_invariant()) {
+        c.fallback_reason = "not_invariant";
+        return c;
+    }
+    c.rdtscp = have_rdtscp();
+    std::string boot = detail::boot_id();
+    if (!detail::load(c, boot)) {
+        detail::measure(c);
+        if (c.ns_per_tick <= 0) {
+            c.fallback_reason = "not_advancing";
+            return c;
+        }
+        if (!boot.empty()) detail::save_or_adopt(c, boot);
+    }
+    detail::check_cpus(c);
+    if (c.max_skew_ns > TSC_SYNC_TOLERANCE_NS && c.shared) {
+        detail::refine(c, boot);
+        detail::check_cpus(c);
+    }
+    if (c.ns_per_tick <= 0 || c.max_skew_ns > TSC_SYNC_TOLERANCE_NS) {
+        c.fallback_reason = "cpus_out_of_step";
+        return c;
+    }
+    c.source = ClockSource::Tsc;
+#else
+    c.fallback_reason = "no_tsc";
+#endif
+    return c;
+}
+
+inline const ClockCalibration& clock_calibration() {
+    static const ClockCalibration c = calibrate_clock();
+    return c;
+}
+
+namespace detail {
+// Calibrates before main(), so the first timed message doesn't pay for it
+inline const ClockCalibration& startup_calibration = clock_calibration();
+} // namespace detail
+
+inline uint64_t now_ns() {
+#ifdef PUBSUB_HAVE_TSC
+    const ClockCalibration& c = clock_calibration();
+    if (c.source == ClockSource::Tsc) {
+        return c.ns_base + (int64_t)((double)(int64_t)(read_tsc(c.rdtscp) - c.tsc_base) * c.ns_per_tick);
+    }
+#endif
+    return monotonic_raw_ns();
+}
+
+// Mean cost of one call to `read`, timed over `reads` back-to-back calls
+template <typename Read>
+double clock_read_cost_ns(Read read, int reads = 1000000) {
+    uint64_t sink = 0;
+    uint64_t start = monotonic_raw_ns();
+    for (int i = 0; i < reads; ++i) sink += read();
+    uint64_t elapsed = monotonic_raw_ns() - start;
+    asm volatile("" : : "r"(sink)); // Keep the reads
+    return (double)elapsed / reads;
+}
+
+// " clock=... tsc_ghz=... calibration=... cpus_checked=... max_skew_ns=... now_ns_cost_ns=...
+// clock_gettime_cost_ns=...": which clock now_ns() uses and what a read of
+// it costs next to clock_gettime(), each preceded by a space
+inline void print_clock_fields(std::ostream& out) {
+    const ClockCalibration& c = clock_calibration();
+    out << " clock=" << (c.source == ClockSource::Tsc ? "tsc" : "monotonic");
+    if (c.source == ClockSource::Tsc) {
+        out << " tsc_ghz=" << 1.0 / c.ns_per_tick
+            << " calibration=" << (c.shared ? "shared" : "local")
+            << " cpus_checked=" << c.cpus_checked
+            << " max_skew_ns=" << c.max_skew_ns;
+    } else {
+        out << " fallback=" << c.fallback_reason;
+    }
+    out << " now_ns_cost_ns=" << clock_read_cost_ns(now_ns)
+        << " clock_gettime_cost_ns=" << clock_read_cost_ns(monotonic_raw_ns);
+}
+
+} // namespace pubsub
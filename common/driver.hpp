@@ -0,0 +1,252 @@
+// One ping-pong driver for every transport (see transport.hpp)
+//
+// run_publisher() sends `warmup` untimed messages, then `count` timed ones,
+// each after the previous reply. The send time is kept in a local variable
+// and the RTT is taken against it, so nothing depends on what the peer left
+// in a shared buffer. A reply with the wrong sequence number (a late one
+// whose ping already timed out) is skipped. RTTs go into a Histogram, so
+// memory stays fixed however large `count` is. Every ping carries `payload`
+// bytes from a PayloadPool (payload.hpp), generated before the first send.
+// The subscriber reads and checksums each one before echoing it, and the
+// publisher checks every echo; one that doesn't match counts in
+// bad_payloads. payload_MB_per_s is the payload moved both ways over the
+// measured run. run_open_loop() sends on a fixed schedule instead (see
+// below). run_subscriber() echoes forever.
+//
+// Besides the result line on stdout, the RTT histogram can be written as a
+// .hgrm percentile distribution (`hgrm_path`) and in encode()'s binary form
+// (`results_path`), which latency_test reads back to merge repeated runs.
+
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "clock.hpp"
+#include "payload.hpp"
+#include "stats.hpp"
+#include "transport.hpp"
+
+namespace pubsub {
+
+struct BenchOptions {
+    uint64_t count = 0;
+    uint64_t warmup = 0;       // Untimed round trips first
+    double rate = 0;           // msg/s for run_open_loop()
+    size_t payload = 0;        // Bytes after each Msg
+    std::string hgrm_path;     // .hgrm percentile distribution, if set
+    std::string results_path;  // Histogram::encode() bytes, if set
+};
+
+// Writes `h` as a .hgrm percentile distribution; nothing to do without a path
+inline bool write_hgrm(const Histogram& h, const std::string& path) {
+    if (path.empty()) return true;
+    std::ofstream out(path);
+    h.print_percentile_distribution(out);
+    if (!out) std::cerr << "Could not write " << path << "\n";
+    return (bool)out;
+}
+
+// Writes `h` encoded, for another process to decode_add(); nothing to do
+// without a path
+inline bool write_results(const Histogram& h, const std::string& path) {
+    if (path.empty()) return true;
+    std::vector<char> bytes;
+    h.encode(bytes);
+    std::ofstream out(path, std::ios::binary);
+    out.write(bytes.data(), (std::streamsize)bytes.size());
+    if (!out) std::cerr << "Could not write " << path << "\n";
+    return (bool)out;
+}
+
+inline bool write_outputs(const Histogram& h, const BenchOptions& o) {
+    bool hgrm_ok = write_hgrm(h, o.hgrm_path);
+    return write_results(h, o.results_path) && hgrm_ok;
+}
+
+// Payload bytes moved per second in both directions by `replies` round trips
+// over `elapsed_ns`
+inline double payload_mb_per_s(size_t payload, uint64_t replies, uint64_t elapsed_ns) {
+    return elapsed_ns ? 2.0 * payload * replies * 1e3 / elapsed_ns : 0;
+}
+
+template <typename Transport>
+int run_publisher(Transport& t, const BenchOptions& o) {
+    Histogram rtts;
+    uint64_t lost = 0, bad = 0;
+    PayloadPool pool(o.payload);
+    std::vector<char> echo(Transport::max_payload);
+    uint64_t start_ns = 0, end_ns = 0;
+
+    for (uint64_t seq = 0; seq < o.warmup + o.count; ++seq) {
+        uint64_t send_ns = now_ns();
+        if (seq == o.warmup) start_ns = send_ns;
+        if (!t.send(Msg{seq, send_ns}, pool.get(seq), o.payload)) {
+            std::cerr << Transport::name << ": send failed\n";
+            return 1;
+        }
+        Msg reply{};
+        size_t len = 0;
+        bool answered = false;
+        while (t.recv(reply, echo.data(), &len)) {
+            if (reply.seq == seq) {
+                answered = true;
+                break;
+            }
+        }
+        uint64_t recv_ns = end_ns = now_ns();
+        if (!answered) {
+            ++lost;
+            continue;
+        }
+        if (seq >= o.warmup) rtts.record(recv_ns - send_ns);
+        bad += !pool.check_echo(seq, echo.data(), len);
+    }
+
+    if (lost) std::cerr << lost << " pings timed out after " << RECV_TIMEOUT_MS << " ms\n";
+    if (bad) std::cerr << bad << " echoed payloads failed validation\n";
+    if (!rtts.count()) {
+        std::cerr << "No replies received\n";
+        return 1;
+    }
+    LatencySummary s = summarize(rtts);
+    std::cout << "Bench ping-pong transport=" << Transport::name << " warmup=" << o.warmup
+              << " payload=" << o.payload;
+    print_rtt_fields(std::cout, s);
+    std::cout << " payload_MB_per_s=" << payload_mb_per_s(o.payload, rtts.count(), end_ns - start_ns)
+              << " bad_payloads=" << bad << " lost=" << lost << "\n";
+    return write_outputs(rtts, o) && !bad ? 0 : 1;
+}
+
+// Open-loop load (run_open_loop): ping `seq` is due at start + seq / rate and
+// its latency runs from that due time, not from when it actually went out.
+// A stalled transport makes sends late, and the lateness is counted, instead
+// of being hidden by a closed loop that simply waits (coordinated omission).
+// In-flight pings are capped below the smallest transport queue (the SHM ring,
+// ZeroMQ's default HWM), so a saturated transport slows the sender rather
+// than deadlocking it; those late sends show up in the latency too. Every
+// transport here delivers in order, so an unanswered ping older than an
+// answered one was dropped; only a ping at the front waits out the timeout.
+// Large payloads also cap the bytes in flight, below the SHM data area.
+// The sender spins for the next due time, but yields while it is more than
+// OPEN_LOOP_YIELD_NS away so a subscriber on the same core still runs.
+constexpr uint64_t OPEN_LOOP_MAX_IN_FLIGHT = 512;
+constexpr uint64_t OPEN_LOOP_MAX_IN_FLIGHT_BYTES = 2 << 20;
+constexpr uint64_t OPEN_LOOP_YIELD_NS = 20000;
+
+template <typename Transport>
+int run_open_loop(Transport& t, const BenchOptions& o) {
+    struct Slot {
+        uint64_t send_ns;
+        bool answered;
+    };
+    std::vector<Slot> window(OPEN_LOOP_MAX_IN_FLIGHT);
+    const uint64_t max_in_flight =
+        std::max<uint64_t>(1, std::min(OPEN_LOOP_MAX_IN_FLIGHT, OPEN_LOOP_MAX_IN_FLIGHT_BYTES / (o.payload + 64)));
+    PayloadPool pool(o.payload);
+    std::vector<char> echo(Transport::max_payload);
+    const uint64_t count = o.count, warmup = o.warmup;
+    const double period_ns = 1e9 / o.rate;
+    const uint64_t total = warmup + count;
+    const uint64_t timeout_ns = (uint64_t)RECV_TIMEOUT_MS * 1000000;
+    Histogram response; // From the due time: what a caller on that schedule would see
+    Histogram service;  // From the actual send time: what a closed loop would report
+    uint64_t sent = 0, oldest = 0, lost = 0, bad = 0, max_lag_ns = 0; // Pings [oldest, sent) are in flight
+    uint64_t answered_end = 0; // One past the newest answered ping
+    uint64_t start = now_ns() + 1000000; // A millisecond to reach the first due time
+    uint64_t last_send = 0, last_reply = 0;
+    auto due = [&](uint64_t seq) { return start + (uint64_t)(seq * period_ns); };
+
+    // Takes every waiting reply, then retires answered pings and lost ones
+    auto drain = [&] {
+        Msg reply;
+        size_t len = 0;
+        while (t.try_recv(reply, echo.data(), &len)) {
+            uint64_t now = now_ns();
+            if (reply.seq < oldest || reply.seq >= sent) continue; // Already given up on
+            Slot& slot = window[reply.seq % window.size()];
+            if (slot.answered) continue;
+            slot.answered = true;
+            answered_end = std::max(answered_end, reply.seq + 1);
+            last_reply = now;
+            if (reply.seq >= warmup) {
+                response.record(now - due(reply.seq));
+                service.record(now - slot.send_ns);
+            }
+            bad += !pool.check_echo(reply.seq, echo.data(), len);
+        }
+        uint64_t now = now_ns();
+        while (oldest < sent) {
+            Slot& slot = window[oldest % window.size()];
+            if (!slot.answered) {
+                if (oldest + 1 >= answered_end && now - slot.send_ns <= timeout_ns) break;
+                ++lost;
+            }
+            ++oldest;
+        }
+    };
+
+    for (uint64_t seq = 0; seq < total; ++seq) {
+        for (uint64_t now = now_ns(); now < due(seq) || sent - oldest >= max_in_flight; now = now_ns()) {
+            drain();
+            if (due(seq) > now + OPEN_LOOP_YIELD_NS) std::this_thread::yield();
+        }
+        uint64_t send_ns = now_ns();
+        window[seq % window.size()] = Slot{send_ns, false};
+        if (!t.send(Msg{seq, send_ns}, pool.get(seq), o.payload)) {
+            std::cerr << Transport::name << ": send failed\n";
+            return 1;
+        }
+        ++sent;
+        last_send = send_ns;
+        max_lag_ns = std::max(max_lag_ns, send_ns - due(seq));
+    }
+    while (oldest < sent) drain();
+
+    if (lost) std::cerr << lost << " pings unanswered after " << RECV_TIMEOUT_MS << " ms\n";
+    if (bad) std::cerr << bad << " echoed payloads failed validation\n";
+    if (!response.count()) {
+        std::cerr << "No replies received\n";
+        return 1;
+    }
+    // Rates over the measured schedule: a sender that fell behind at the
+    // start can't make up for it with a burst later
+    double send_s = (last_send - due(warmup) + period_ns) / 1e9;
+    double reply_s = (last_reply - due(warmup)) / 1e9;
+    LatencySummary svc = summarize(service);
+    std::cout << "Bench open-loop transport=" << Transport::name << " warmup=" << warmup
+              << " payload=" << o.payload
+              << " rate=" << o.rate
+              << " achieved_rate=" << count / send_s
+              << " reply_rate=" << (reply_s > 0 ? response.count() / reply_s : 0)
+              << " max_send_lag_us=" << max_lag_ns / 1000.0;
+    print_rtt_fields(std::cout, summarize(response));
+    std::cout << " service_median_RTT_us=" << svc.p50_us
+              << " service_p99_RTT_us=" << svc.p99_us
+              << " payload_MB_per_s=" << payload_mb_per_s(o.payload, response.count(), last_reply - due(warmup))
+              << " bad_payloads=" << bad << " lost=" << lost << "\n";
+    return write_outputs(response, o) && !bad ? 0 : 1;
+}
+
+template <typename Transport>
+int run_subscriber(Transport& t) {
+    std::cout << Transport::name << " subscriber ready\n";
+    std::cout.flush();
+    Msg m{};
+    std::vector<char> payload(Transport::max_payload);
+    size_t len = 0;
+    while (true) {
+        if (!t.recv(m, payload.data(), &len)) continue;
+        check_received(payload.data(), len);
+        if (!t.send(m, payload.data(), len)) {
+            std::cerr << Transport::name << ": send failed\n";
+            return 1;
+        }
+    }
+}
+
+} // namespace pubsub
@@ -0,0 +1,260 @@
+// Fixed-memory latency histogram in the HdrHistogram layout
+//
+// Values (ns) fall into power-of-two buckets, each split into
+// sub_bucket_count linear sub-buckets, so any value up to `highest` is kept
+// to `significant_digits` decimal digits. record() is O(1): a count-leading-
+// zeros, a shift and an increment. Memory depends only on the range and the
+// precision (about 220 KiB for 1 ns..60 s at 3 digits), not on how many
+// values are recorded, so soak tests can run for billions of messages.
+//
+// Histograms with the same configuration merge with add(), across threads
+// directly and across processes through encode()/decode_add(), which carry
+// only the non-zero counts. print_percentile_distribution() writes the .hgrm
+// text that HdrHistogram's outputPercentileDistribution() produces, so the
+// usual plotters read it.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+namespace pubsub {
+
+constexpr uint64_t DEFAULT_HIGHEST_NS = 60ull * 1000 * 1000 * 1000; // Anything slower is clamped (and counted)
+constexpr int DEFAULT_SIGNIFICANT_DIGITS = 3;
+constexpr int PERCENTILE_TICKS_PER_HALF_DISTANCE = 5; // .hgrm rows between each halving of 1 - percentile
+
+class Histogram {
+private:
+    uint64_t highest;
+    int sub_bucket_half_count_magnitude;
+    uint64_t sub_bucket_half_count;
+    uint64_t sub_bucket_mask;
+    int bucket_count;
+    std::vector<uint64_t> counts;
+
+    uint64_t total = 0;
+    uint64_t saturated = 0; // Values above `highest`, recorded as `highest`
+    uint64_t min_value = UINT64_MAX;
+    uint64_t max_value = 0;
+    double sum = 0;
+
+    int bucket_index(uint64_t v) const {
+        int pow2ceiling = 64 - __builtin_clzll(v | sub_bucket_mask);
+        return pow2ceiling - (sub_bucket_half_count_magnitude + 1);
+    }
+
+    size_t counts_index(uint64_t v) const {
+        int bucket = bucket_index(v);
+        uint64_t sub_bucket = v >> bucket;
+        return ((size_t)(bucket + 1) << sub_bucket_half_count_magnitude) + (sub_bucket - sub_bucket_half_count);
+    }
+
+    uint64_t value_at_index(size_t i) const {
+        int bucket = (int)(i >> sub_bucket_half_count_magnitude) - 1;
+        uint64_t sub_bucket = (i & (sub_bucket_half_count - 1)) + sub_bucket_half_count;
+        if (bucket < 0) {
+            sub_bucket -= sub_bucket_half_count;
+            bucket = 0;
+        }
+        return sub_bucket << bucket;
+    }
+
+    // Largest value that lands in the same slot as `v`
+    uint64_t highest_equivalent(uint64_t v) const {
+        int bucket = bucket_index(v);
+        uint64_t sub_bucket = v >> bucket;
+        int range_shift = sub_bucket >= 2 * sub_bucket_half_count ? bucket + 1 : bucket;
+        return ((v >> bucket) << bucket) + (1ull << range_shift) - 1;
+    }
+
+    uint64_t median_equivalent(uint64_t v) const {
+        return (value_at_index(counts_index(v)) + highest_equivalent(v)) / 2;
+    }
+
+    // Reported value of slot i: its top end, but never above the true max
+    uint64_t reported_value(size_t i) const { return std::min(highest_equivalent(value_at_index(i)), max_value); }
+
+public:
+    explicit Histogram(uint64_t highest_trackable = DEFAULT_HIGHEST_NS,
+                       int significant_digits = DEFAULT_SIGNIFICANT_DIGITS)
+        : highest(std::max<uint64_t>(highest_trackable, 2)) {
+        significant_digits = std::min(std::max(significant_digits, 1), 5);
+        uint64_t largest_single_unit = 2 * (uint64_t)std::pow(10, significant_digits);
+        int sub_bucket_count_magnitude = (int)std::ceil(std::log2((double)largest_single_unit));
+        sub_bucket_half_count_magnitude = std::max(sub_bucket_count_magnitude, 1) - 1;
+        uint64_t sub_bucket_count = 1ull << (sub_bucket_half_count_magnitude + 1);
+        sub_bucket_half_count = sub_bucket_count / 2;
+        sub_bucket_mask = sub_bucket_count - 1;
+
+        // Buckets needed so that `highest` still has a slot
+        uint64_t smallest_untrackable = sub_bucket_count;
+        bucket_count = 1;
+        while (smallest_untrackable <= highest) {
+            if (smallest_untrackable > (uint64_t)INT64_MAX / 2) {
+                ++bucket_count;
+                break;
+            }
+            smallest_untrackable <<= 1;
+            ++bucket_count;
+        }
+        counts.assign((size_t)(bucket_count + 1) * sub_bucket_half_count, 0);
+    }
+
+    void record(uint64_t v) {
+        if (v > highest) {
+            v = highest;
+            ++saturated;
+        }
+        ++counts[counts_index(v)];
+        ++total;
+        sum += (double)v;
+        min_value = std::min(min_value, v);
+        max_value = std::max(max_value, v);
+    }
+
+    // Merges `o` into this one; false (and nothing merged) if the
+    // configurations differ
+    bool add(const Histogram& o) {
+        if (o.counts.size() != counts.size() || o.highest != highest) return false;
+        for (size_t i = 0; i < counts.size(); ++i) counts[i] += o.counts[i];
+        total += o.total;
+        saturated += o.saturated;
+        sum += o.sum;
+        min_value = std::min(min_value, o.min_value);
+        max_value = std::max(max_value, o.max_value);
+        return true;
+    }
+
+    void reset() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = saturated = max_value = 0;
+        min_value = UINT64_MAX;
+        sum = 0;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t saturated_count() const { return saturated; }
+    uint64_t min() const { return total ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+    double mean() const { return total ? sum / total : 0; }
+
+    // Value at `percentile` (0-100): every recorded value up to this rank is
+    // at or below it, to the histogram's precision
+    uint64_t value_at_percentile(double percentile) const {
+        if (!total) return 0;
+        double p = std::min(std::max(percentile, 0.0), 100.0);
+        uint64_t target = std::max<uint64_t>(1, (uint64_t)(p / 100.0 * total + 0.5));
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            cumulative += counts[i];
+            if (cumulative >= target) return reported_value(i);
+        }
+        return max_value;
+    }
+
+    double stddev() const {
+        if (!total) return 0;
+        double m = mean(), acc = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (!counts[i]) continue;
+            double d = (double)median_equivalent(value_at_index(i)) - m;
+            acc += d * d * counts[i];
+        }
+        return std::sqrt(acc / total);
+    }
+
+    // Appends this histogram to `out`: a header of uint64 words, then one
+    // (index, count) pair per non-zero slot
+    void encode(std::vector<char>& out) const {
+        std::vector<uint64_t> words = {highest, counts.size(), total, saturated, min_value, max_value, 0, 0};
+        memcpy(&words[6], &sum, sizeof(sum));
+        for (size_t i = 0; i < counts.size(); ++i) {
+            if (!counts[i]) continue;
+            words.push_back(i);
+            words.push_back(counts[i]);
+            ++words[7];
+        }
+        size_t at = out.size();
+        out.resize(at + words.size() * sizeof(uint64_t));
+        memcpy(out.data() + at, words.data(), words.size() * sizeof(uint64_t));
+    }
+
+    // Merges a histogram written by encode() with the same configuration;
+    // returns the bytes consumed, or 0 if `data` is not one
+    size_t decode_add(const char* data, size_t len) {
+        constexpr size_t HEADER_WORDS = 8;
+        if (len < HEADER_WORDS * sizeof(uint64_t)) return 0;
+        uint64_t header[HEADER_WORDS];
+        memcpy(header, data, sizeof(header));
+        if (header[0] != highest || header[1] != counts.size()) return 0;
+        size_t used = sizeof(header) + header[7] * 2 * sizeof(uint64_t);
+        if (len < used) return 0;
+        for (uint64_t k = 0; k < header[7]; ++k) {
+            uint64_t pair[2];
+            memcpy(pair, data + sizeof(header) + k * sizeof(pair), sizeof(pair));
+            if (pair[0] < counts.size()) counts[pair[0]] += pair[1];
+        }
+        double other_sum;
+        memcpy(&other_sum, &header[6], sizeof(other_sum));
+        total += header[2];
+        saturated += header[3];
+        min_value = std::min(min_value, header[4]);
+        max_value = std::max(max_value, header[5]);
+        sum += other_sum;
+        return used;
+    }
+
+    // Walks the distribution at HdrHistogram's percentile ticks, calling
+    // f(percentile 0-100, value, cumulative count) for each, and last for
+    // 100 with the max
+    template <typename F>
+    void for_each_percentile(F f) const {
+        double level = 0; // Next percentile to report
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < counts.size() && cumulative < total; ++i) {
+            if (!counts[i]) continue;
+            cumulative += counts[i];
+            double reached = 100.0 * cumulative / total;
+            while (reached >= level && cumulative < total) {
+                f(level, reported_value(i), cumulative);
+                double half_distance = std::pow(2.0, std::floor(std::log2(100.0 / (100.0 - level))) + 1);
+                level += 100.0 / (half_distance * PERCENTILE_TICKS_PER_HALF_DISTANCE);
+            }
+        }
+        if (total) f(100.0, max_value, total);
+    }
+
+    // HdrHistogram percentile distribution (.hgrm); values divided by `scale`
+    // (1000: ns recorded, µs printed)
+    void print_percentile_distribution(std::ostream& out, double scale = 1000.0) const {
+        char line[128];
+        out << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+        for_each_percentile([&](double percentile, uint64_t value, uint64_t cumulative) {
+            if (percentile < 100.0) {
+                snprintf(line, sizeof(line), "%12.3f %2.12f %10llu %14.2f\n", value / scale, percentile / 100.0,
+                         (unsigned long long)cumulative, 1.0 / (1.0 - percentile / 100.0));
+            } else {
+                snprintf(line, sizeof(line), "%12.3f %2.12f %10llu\n", value / scale, 1.0,
+                         (unsigned long long)cumulative);
+            }
+            out << line;
+        });
+        snprintf(line, sizeof(line), "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean() / scale,
+                 stddev() / scale);
+        out << line;
+        snprintf(line, sizeof(line), "#[Max     = %12.3f, Total count    = %12llu]\n", max_value / scale,
+                 (unsigned long long)total);
+        out << line;
+        snprintf(line, sizeof(line), "#[Buckets = %12d, SubBuckets     = %12llu]\n", bucket_count,
+                 (unsigned long long)(2 * sub_bucket_half_count));
+        out << line;
+    }
+};
+
+} // namespace pubsub
@@ -0,0 +1,19 @@
+// Ping-pong message shared by the transports in common/ and the UDP binaries
+//
+// The publisher fills in both fields; the subscriber echoes the message
+// unchanged. RTT is always taken against the publisher's own record of the
+// send time, never against t_ns read back from a buffer the peer may have
+// reused (see driver.hpp).
+
+#pragma once
+
+#include <cstdint>
+
+namespace pubsub {
+
+struct Msg {
+    uint64_t seq;
+    uint64_t t_ns; // Publisher's send time (now_ns())
+};
+
+} // namespace pubsub
@@ -0,0 +1,174 @@
+// Benchmark payloads: generated ahead of time, checked at both ends
+//
+// A PayloadPool holds the payloads of one run in a single arena, generated
+// before the first message: pseudo-random bytes, so nothing compresses or
+// dedups, with each one's checksum already computed. Sending a payload costs
+// only the transport's own copy. The pool spans about PAYLOAD_POOL_BYTES
+// (at least PAYLOAD_POOL_MIN entries), so small payloads stay cache-warm and
+// large ones come from memory the way a real producer's would.
+//
+// A payload longer than a PayloadHeader starts with one. The
+// subscriber checksums the body, which reads every byte, and writes the
+// result into the header before echoing the payload back (check_received()).
+// The publisher then checks the echo against the pool (check_echo()). A byte
+// corrupted anywhere on the way out or back, or never read at the far end,
+// shows up as a bad payload. Shorter payloads are compared byte for byte.
+//
+// copy_payload() is the copy into shared memory, optionally with
+// non-temporal stores. These bypass the writer's cache, so a reader on another
+// core loads the lines from memory instead of snooping them out of the
+// writer's cache.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define PUBSUB_HAVE_NT_STORES 1
+#endif
+
+namespace pubsub {
+
+constexpr size_t PAYLOAD_POOL_BYTES = 1 << 20; // About L2-sized: big payloads cycle through memory
+constexpr size_t PAYLOAD_POOL_MIN = 16;
+constexpr size_t PAYLOAD_ALIGN = 64;
+
+struct PayloadHeader {
+    uint64_t checksum;          // Of the body, by the publisher
+    uint64_t receiver_checksum; // Of the body as the subscriber read it
+};
+
+// Fletcher-style sum over 64-bit words in four independent lanes, so it runs
+// at several bytes per cycle and still depends on where each word sits
+inline uint64_t payload_checksum(const char* data, size_t len) {
+    uint64_t a[4] = {1, 2, 3, 4}, b[4] = {0, 0, 0, 0};
+    size_t words = len / 8;
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t w;
+            memcpy(&w, data + (i + lane) * 8, 8);
+            a[lane] += w;
+            b[lane] += a[lane];
+        }
+    }
+    uint64_t tail_a = 0, tail_b = 0;
+    for (; i < words; ++i) {
+        uint64_t w;
+        memcpy(&w, data + i * 8, 8);
+        tail_a += w;
+        tail_b += tail_a;
+    }
+    uint64_t rest = 0;
+    memcpy(&rest, data + words * 8, len % 8);
+    tail_a += rest ^ len;
+    tail_b += tail_a;
+    uint64_t sum = tail_b;
+    for (int lane = 0; lane < 4; ++lane) sum = (sum ^ b[lane]) * 0x100000001b3ull + a[lane];
+    return sum;
+}
+
+class PayloadPool {
+private:
+    size_t size;
+    size_t stride;
+    size_t entries;
+    std::vector<char> arena;
+
+public:
+    explicit PayloadPool(size_t payload_size)
+        : size(payload_size),
+          stride((payload_size + PAYLOAD_ALIGN - 1) / PAYLOAD_ALIGN * PAYLOAD_ALIGN),
+          entries(std::max(PAYLOAD_POOL_MIN, stride ? PAYLOAD_POOL_BYTES / stride : 1)),
+          arena(stride * entries) {
+        uint64_t x = 0x9e3779b97f4a7c15ull; // xorshift64
+        for (size_t i = 0; i < arena.size(); i += 8) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            memcpy(&arena[i], &x, std::min<size_t>(8, arena.size() - i));
+        }
+        if (size <= sizeof(PayloadHeader)) return;
+        for (size_t e = 0; e < entries; ++e) {
+            char* p = &arena[e * stride];
+            PayloadHeader h{payload_checksum(p + sizeof(h), size - sizeof(h)), 0};
+            memcpy(p, &h, sizeof(h));
+        }
+    }
+
+    size_t payload_size() const { return size; }
+    size_t bytes() const { return arena.size(); }
+
+    // Payload for message `seq`; consecutive messages use consecutive entries
+    const char* get(uint64_t seq) const { return arena.data() + (seq % entries) * stride; }
+
+    // Whether `echo` is message `seq`'s payload, read correctly by the
+    // subscriber and returned unchanged
+    bool check_echo(uint64_t seq, const char* echo, size_t len) const {
+        if (len != size) return false;
+        const char* sent = get(seq);
+        if (size <= sizeof(PayloadHeader)) return memcmp(echo, sent, size) == 0;
+        PayloadHeader sent_h, echo_h;
+        memcpy(&sent_h, sent, sizeof(sent_h));
+        memcpy(&echo_h, echo, sizeof(echo_h));
+        return echo_h.checksum == sent_h.checksum && echo_h.receiver_checksum == sent_h.checksum &&
+               payload_checksum(echo + sizeof(echo_h), size - sizeof(echo_h)) == sent_h.checksum;
+    }
+};
+
+// Subscriber side: checksums the body of a received payload and records the
+// result in its header; false if it doesn't match what the publisher sent
+inline bool check_received(char* payload, size_t len) {
+    if (len <= sizeof(PayloadHeader)) {
+        volatile uint64_t sink = payload_checksum(payload, len); // Still read every byte
+        (void)sink;
+        return true;
+    }
+    PayloadHeader h;
+    memcpy(&h, payload, sizeof(h));
+    h.receiver_checksum = payload_checksum(payload + sizeof(h), len - sizeof(h));
+    memcpy(payload, &h, sizeof(h));
+    return h.receiver_checksum == h.checksum;
+}
+
+// memcpy, or with `nontemporal` streaming stores for the 16-byte-aligned
+// part of `dst`. Call nontemporal_fence() before publishing what was copied:
+// streaming stores aren't ordered by a release store.
+inline void copy_payload(char* dst, const char* src, size_t len, bool nontemporal) {
+#ifdef PUBSUB_HAVE_NT_STORES
+    if (nontemporal && len >= 64) {
+        size_t head = (16 - (reinterpret_cast<uintptr_t>(dst) & 15)) & 15;
+        memcpy(dst, src, head);
+        size_t i = head;
+        for (; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), v);
+        }
+        memcpy(dst + i, src + i, len - i);
+        return;
+    }
+#endif
+    (void)nontemporal;
+    memcpy(dst, src, len);
+}
+
+inline void nontemporal_fence() {
+#ifdef PUBSUB_HAVE_NT_STORES
+    _mm_sfence();
+#endif
+}
+
+inline bool have_nontemporal_stores() {
+#ifdef PUBSUB_HAVE_NT_STORES
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // namespace pubsub
@@ -0,0 +1,193 @@
+// Shared-memory transport (see transport.hpp): two SPSC rings of Msg slots
+//
+// The segment holds one ring per direction, ping (publisher -> subscriber)
+// and pong (subscriber -> publisher), each with its head and tail on their
+// own cache lines. The publisher creates the segment and resets both rings;
+// the subscriber may start first and waits for it (buffer/shm_segment.hpp,
+// default backing; pubsub_bench passes --numa-node through). Waiting spins
+// for SPIN_LIMIT polls and then yields, like the improved ring's "yield"
+// strategy, so one core is enough for both sides.
+//
+// Payloads don't live in the slots: each ring has a data area of
+// SHM_DATA_BYTES, used as a byte ring alongside the slot ring. A payload
+// starts on a cache line at the writer's data cursor, or back at the start
+// of the area if it wouldn't fit before the end, and its slot records where.
+// The reader copies it out and then advances the data tail to the slot's
+// data_end, so the writer only waits when the unread payloads fill the area.
+// A 64-byte message costs one line and a 64 KB one a thousand, instead of
+// every slot being sized for the largest.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "../buffer/shm_segment.hpp"
+#include "../buffer/shm_wait_strategy.hpp"
+#include "clock.hpp"
+#include "payload.hpp"
+#include "transport.hpp"
+
+namespace pubsub {
+
+constexpr size_t SHM_RING_SIZE = 1024; // Msg slots per direction
+constexpr size_t SHM_CACHE_LINE = 128; // Two lines: keeps the adjacent-line prefetcher off the other cursor
+constexpr size_t SHM_DATA_BYTES = 4 << 20; // Payload bytes per direction: 64 of the largest in flight
+constexpr size_t SHM_DATA_ALIGN = 64;
+
+struct ShmSlot {
+    Msg msg;
+    uint64_t len;      // Payload bytes
+    uint64_t offset;   // Data cursor where the payload starts
+    uint64_t data_end; // Data cursor once it is consumed
+};
+
+struct ShmRing {
+    alignas(SHM_CACHE_LINE) std::atomic<uint64_t> head; // Writer's index
+    std::atomic<uint64_t> data_head;                    // Writer's data cursor
+    alignas(SHM_CACHE_LINE) std::atomic<uint64_t> tail; // Reader's index
+    std::atomic<uint64_t> data_tail;                    // Reader's data cursor
+    alignas(SHM_CACHE_LINE) ShmSlot slots[SHM_RING_SIZE];
+    alignas(SHM_CACHE_LINE) char data[SHM_DATA_BYTES];
+};
+
+struct ShmPingPong {
+    ShmRing ping;
+    ShmRing pong;
+};
+
+class ShmTransport {
+private:
+    Segment seg;
+    ShmRing* out = nullptr;
+    ShmRing* in = nullptr;
+    Role role;
+    uint64_t wait_start = 0;
+    bool nontemporal = false;
+
+    // Spins, then yields; the publisher gives up after RECV_TIMEOUT_MS
+    template <typename Ready>
+    bool wait_until(Ready ready) {
+        for (int spins = 0; !ready(); ++spins) {
+            if (spins < SPIN_LIMIT) {
+                cpu_relax();
+                continue;
+            }
+            std::this_thread::yield();
+            if (role == Role::Publisher && spins % SPIN_LIMIT == 0 && timed_out()) return false;
+        }
+        return true;
+    }
+
+    bool timed_out() const { return now_ns() - wait_start > (uint64_t)RECV_TIMEOUT_MS * 1000000; }
+
+    // Copies slot `tail` and its payload out and frees both
+    void take(uint64_t tail, Msg& m, char* payload, size_t* len) {
+        const ShmSlot& slot = in->slots[tail % SHM_RING_SIZE];
+        m = slot.msg;
+        size_t n = std::min<size_t>(slot.len, MAX_PAYLOAD);
+        size_t at = slot.offset % SHM_DATA_BYTES;
+        if (at + n > SHM_DATA_BYTES) n = 0; // Torn by a publisher reset
+        if (payload) memcpy(payload, in->data + at, n);
+        if (len) *len = n;
+        in->data_tail.store(slot.data_end, std::memory_order_release);
+        in->tail.store(tail + 1, std::memory_order_release);
+    }
+
+    // Where a `len`-byte payload goes after data cursor `pos`: the next cache
+    // line, or the start of the area if it would run past the end
+    static uint64_t place(uint64_t pos, size_t len) {
+        uint64_t start = (pos + SHM_DATA_ALIGN - 1) / SHM_DATA_ALIGN * SHM_DATA_ALIGN;
+        if (start % SHM_DATA_BYTES + len > SHM_DATA_BYTES) start += SHM_DATA_BYTES - start % SHM_DATA_BYTES;
+        return start;
+    }
+
+public:
+    static constexpr const char* name = "shm";
+    static constexpr size_t max_payload = MAX_PAYLOAD;
+
+    ShmTransport(Role r, const std::string& address, const SegmentOptions& opts = SegmentOptions()) : role(r) {
+        if (role == Role::Publisher) {
+            seg = create_segment(address, sizeof(ShmPingPong), opts);
+        } else {
+            seg = attach_segment(address, sizeof(ShmPingPong), opts, true);
+        }
+        if (!seg.base) return;
+        auto* rings = static_cast<ShmPingPong*>(seg.base);
+        if (role == Role::Publisher) {
+            // Whatever a previous run left behind is stale
+            for (ShmRing* ring : {&rings->ping, &rings->pong}) {
+                ring->head.store(0, std::memory_order_relaxed);
+                ring->data_head.store(0, std::memory_order_relaxed);
+                ring->data_tail.store(0, std::memory_order_relaxed);
+                ring->tail.store(0, std::memory_order_release);
+            }
+        }
+        out = role == Role::Publisher ? &rings->ping : &rings->pong;
+        in = role == Role::Publisher ? &rings->pong : &rings->ping;
+    }
+
+    ~ShmTransport() { release_segment(seg); }
+
+    ShmTransport(const ShmTransport&) = delete;
+    ShmTransport& operator=(const ShmTransport&) = delete;
+
+    bool ok() const { return seg.base != nullptr; }
+
+    // Copies payloads in with non-temporal stores (copy_payload()), which
+    // skip this core's cache on the way to the reader
+    void use_nontemporal_stores(bool on) { nontemporal = on; }
+
+    // Cursors are reloaded while waiting: a publisher that (re)starts resets
+    // them under a subscriber that is already attached
+    bool send(const Msg& m, const char* payload = nullptr, size_t len = 0) {
+        if (len > max_payload) return false;
+        uint64_t head = 0, start = 0;
+        wait_start = now_ns();
+        if (!wait_until([&] {
+                head = out->head.load(std::memory_order_relaxed);
+                start = place(out->data_head.load(std::memory_order_relaxed), len);
+                return head - out->tail.load(std::memory_order_acquire) < SHM_RING_SIZE &&
+                       start + len - out->data_tail.load(std::memory_order_acquire) <= SHM_DATA_BYTES;
+            })) {
+            return false;
+        }
+        ShmSlot& slot = out->slots[head % SHM_RING_SIZE];
+        slot.msg = m;
+        slot.len = len;
+        slot.offset = start;
+        slot.data_end = start + len;
+        if (len) {
+            copy_payload(out->data + start % SHM_DATA_BYTES, payload, len, nontemporal);
+            if (nontemporal) nontemporal_fence();
+        }
+        out->data_head.store(start + len, std::memory_order_relaxed);
+        out->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool recv(Msg& m, char* payload = nullptr, size_t* len = nullptr) {
+        uint64_t tail = 0;
+        wait_start = now_ns();
+        if (!wait_until([&] {
+                tail = in->tail.load(std::memory_order_relaxed);
+                return in->head.load(std::memory_order_acquire) > tail;
+            })) {
+            return false;
+        }
+        take(tail, m, payload, len);
+        return true;
+    }
+
+    bool try_recv(Msg& m, char* payload = nullptr, size_t* len = nullptr) {
+        uint64_t tail = in->tail.load(std::memory_order_relaxed);
+        if (in->head.load(std::memory_order_acquire) <= tail) return false;
+        take(tail, m, payload, len);
+        return true;
+    }
+};
+
+} // namespace pubsub
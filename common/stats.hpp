@@ -0,0 +1,61 @@
+// Latency statistics shared by every ping-pong report
+//
+// Latencies are recorded in integer nanoseconds into a Histogram
+// (histogram.hpp): O(1) per sample and fixed memory however long the run.
+// Summaries are printed in microseconds with fractional digits, so
+// sub-microsecond transports are not rounded to zero.
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#include "histogram.hpp"
+
+namespace pubsub {
+
+struct LatencySummary {
+    uint64_t count = 0;
+    double avg_us = 0;
+    double min_us = 0;
+    double p50_us = 0;
+    double p90_us = 0;
+    double p95_us = 0;
+    double p99_us = 0;
+    double p999_us = 0;
+    double p9999_us = 0;
+    double max_us = 0;
+};
+
+inline LatencySummary summarize(const Histogram& h) {
+    LatencySummary s;
+    if (!h.count()) return s;
+    s.count = h.count();
+    s.avg_us = h.mean() / 1000.0;
+    s.min_us = h.min() / 1000.0;
+    s.p50_us = h.value_at_percentile(50) / 1000.0;
+    s.p90_us = h.value_at_percentile(90) / 1000.0;
+    s.p95_us = h.value_at_percentile(95) / 1000.0;
+    s.p99_us = h.value_at_percentile(99) / 1000.0;
+    s.p999_us = h.value_at_percentile(99.9) / 1000.0;
+    s.p9999_us = h.value_at_percentile(99.99) / 1000.0;
+    s.max_us = h.max() / 1000.0;
+    return s;
+}
+
+// The RTT fields every "... ping-pong" line carries, each preceded by a space
+inline void print_rtt_fields(std::ostream& out, const LatencySummary& s) {
+    out << " count=" << s.count
+        << " avg_RTT_us=" << s.avg_us
+        << " median_RTT_us=" << s.p50_us
+        << " p90_RTT_us=" << s.p90_us
+        << " p95_RTT_us=" << s.p95_us
+        << " p99_RTT_us=" << s.p99_us
+        << " p999_RTT_us=" << s.p999_us
+        << " p9999_RTT_us=" << s.p9999_us
+        << " min_RTT_us=" << s.min_us
+        << " max_RTT_us=" << s.max_us
+        << " avg_one_way_us=" << s.avg_us / 2.0;
+}
+
+} // namespace pubsub
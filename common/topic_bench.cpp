@@ -0,0 +1,163 @@
+// Usage: ./topic_bench pub <prefix> <topics> <count> [--rate=R] [--payload=B] [--registry=NAME]
+//        ./topic_bench sub <topic|pattern> [--count=N] [--results=FILE] [--registry=NAME]
+//        ./topic_bench list [--registry=NAME]
+//        ./topic_bench remove [--registry=NAME]
+// Topic routing over the shared-memory topic registry (topic_registry.hpp,
+// topics.hpp). No broker and no hand-named segments: processes find each
+// other's rings by topic name.
+//
+//   ./topic_bench sub 'md.*' &                  every md.* topic, including later ones
+//   ./topic_bench sub md.7 &                    one topic
+//   ./topic_bench pub md. 256 100000            md.0 .. md.255, round robin
+//
+// pub resolves one TopicPublisher per topic up front and reports what that
+// cost (resolve_us), then publishes `count` messages round robin across the
+// topics at R msg/s (default 100000) and reports the mean cost of a
+// publish() call. sub records the one-way latency of each message it
+// receives (now_ns() - t_ns, both on the shared TSC calibration in
+// clock.hpp). It stops after N messages or on SIGINT/SIGTERM, drains what is
+// already waiting, prints a "Topics sub" line and can write the histogram
+// for latency_test (--results, as pubsub_bench does).
+//
+// --registry=NAME  registry segment (default pubsub_topics)
+// --payload=B      bytes after each Msg, at most TOPIC_MAX_PAYLOAD
+
+#include <signal.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../buffer/shm_wait_strategy.hpp"
+#include "clock.hpp"
+#include "driver.hpp"
+#include "stats.hpp"
+#include "topic_registry.hpp"
+#include "topics.hpp"
+
+using namespace std;
+using namespace pubsub;
+
+constexpr double DEFAULT_RATE = 100000;
+constexpr uint64_t YIELD_NS = 20000; // Yield while the next due time is further off, as run_open_loop() does
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_signal(int) { stop_requested = 1; }
+
+static int run_pub(TopicRegistry& registry, const string& prefix, size_t topics, uint64_t count, double rate,
+                   size_t payload_len) {
+    vector<unique_ptr<TopicPublisher>> pubs;
+    uint64_t resolve_start = now_ns();
+    for (size_t i = 0; i < topics; ++i) {
+        pubs.push_back(make_unique<TopicPublisher>(registry, prefix + to_string(i)));
+        if (!pubs.back()->ok()) return 1;
+    }
+    double resolve_us = (now_ns() - resolve_start) / 1000.0 / topics;
+
+    vector<char> payload(payload_len, 't');
+    const double period_ns = 1e9 / rate;
+    uint64_t start = now_ns() + 1000000;
+    uint64_t publish_ns = 0;
+    for (uint64_t seq = 0; seq < count; ++seq) {
+        uint64_t due = start + (uint64_t)(seq * period_ns);
+        for (uint64_t now = now_ns(); now < due; now = now_ns()) {
+            if (due > now + YIELD_NS) this_thread::yield();
+        }
+        uint64_t t = now_ns();
+        if (!pubs[seq % topics]->publish(Msg{seq, t}, payload.data(), payload.size())) {
+            cerr << "Payload larger than " << TOPIC_MAX_PAYLOAD << " bytes\n";
+            return 1;
+        }
+        publish_ns += now_ns() - t;
+    }
+    double elapsed_s = (now_ns() - start) / 1e9;
+    cout << "Topics pub registry=" << registry.name() << " topics=" << topics << " count=" << count
+         << " payload=" << payload_len << " rate=" << rate << " achieved_rate=" << count / elapsed_s
+         << " resolve_us=" << resolve_us << " publish_ns=" << (double)publish_ns / count << "\n";
+    return 0;
+}
+
+static int run_sub(TopicRegistry& registry, const string& pattern, uint64_t count, const string& results_path) {
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    TopicSubscriber sub(registry, pattern);
+    if (!sub.ok()) return 1;
+    cout << "Topics sub pattern=" << pattern << " ready\n";
+    cout.flush();
+
+    Histogram one_way;
+    Msg m{};
+    vector<char> payload(TOPIC_MAX_PAYLOAD);
+    size_t len = 0;
+    int idle = 0;
+    while (!count || one_way.count() < count) {
+        if (sub.try_recv(m, nullptr, payload.data(), &len)) {
+            one_way.record(now_ns() - m.t_ns);
+            idle = 0;
+        } else if (stop_requested) {
+            break; // Drained
+        } else if (++idle >= SPIN_LIMIT) {
+            this_thread::yield();
+        } else {
+            cpu_relax();
+        }
+    }
+
+    LatencySummary s = summarize(one_way);
+    cout << "Topics sub pattern=" << pattern << " topics=" << sub.topic_count() << " count=" << s.count
+         << " avg_one_way_us=" << s.avg_us << " median_one_way_us=" << s.p50_us << " p99_one_way_us=" << s.p99_us
+         << " p999_one_way_us=" << s.p999_us << " max_one_way_us=" << s.max_us << " lost=" << sub.lost() << "\n";
+    return write_results(one_way, results_path) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    string mode = argc > 1 ? argv[1] : "";
+    size_t positional = mode == "pub" ? 3 : mode == "sub" ? 1 : 0;
+    if ((mode != "pub" && mode != "sub" && mode != "list" && mode != "remove") || argc < 2 + (int)positional) {
+        cerr << "Usage: " << argv[0] << " pub <prefix> <topics> <count> [--rate=R] [--payload=B] [--registry=NAME]\n"
+             << "       " << argv[0] << " sub <topic|pattern> [--count=N] [--results=FILE] [--registry=NAME]\n"
+             << "       " << argv[0] << " list [--registry=NAME]\n"
+             << "       " << argv[0] << " remove [--registry=NAME]\n";
+        return 1;
+    }
+    string registry_name = TOPIC_REGISTRY_NAME;
+    string results_path;
+    double rate = DEFAULT_RATE;
+    size_t payload = 0;
+    uint64_t count = 0;
+    for (int a = 2 + (int)positional; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg.rfind("--registry=", 0) == 0) registry_name = arg.substr(11);
+        else if (arg.rfind("--rate=", 0) == 0) rate = stod(arg.substr(7));
+        else if (arg.rfind("--payload=", 0) == 0) payload = stoull(arg.substr(10));
+        else if (arg.rfind("--count=", 0) == 0) count = stoull(arg.substr(8));
+        else if (arg.rfind("--results=", 0) == 0) results_path = arg.substr(10);
+        else {
+            cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (mode == "remove") {
+        remove_topic_registry(registry_name);
+        return 0;
+    }
+    TopicRegistry registry(registry_name);
+    if (!registry.ok()) return 1;
+    if (mode == "list") {
+        registry.for_each_match("*", [](const TopicInfo& t) {
+            cout << t.id << " " << t.name << " " << t.segment << "\n";
+        });
+        return 0;
+    }
+    if (mode == "sub") return run_sub(registry, argv[2], count, results_path);
+    size_t topics = stoul(argv[3]);
+    if (!topics || rate <= 0) {
+        cerr << "Need at least one topic and a positive rate\n";
+        return 1;
+    }
+    return run_pub(registry, argv[2], topics, stoull(argv[4]), rate, payload);
+}
@@ -0,0 +1,221 @@
+// Broker-less topic directory in shared memory
+//
+// One segment per host (TOPIC_REGISTRY_NAME, or any name shared by the
+// processes that talk) maps topic names to the ring segments that carry them,
+// so nobody hands out segment names: topic N's ring is "<registry>.<N>". The
+// directory is an open-addressed hash table of TOPIC_CAPACITY entries, found
+// by FNV-1a of the name and linear probing. A zero-filled segment is a valid
+// empty directory, so whichever process comes first just creates it.
+//
+// Registering claims a free entry with a CAS (FREE -> CLAIMING), writes the
+// name and publishes it (READY, release). A racing registration of the same
+// name waits for the CLAIMING entry to become READY and then finds it, so a
+// name maps to exactly one entry. Entries are never freed while the
+// directory exists: topics are the host's configuration, and removing the
+// whole registry (remove_topic_registry()) is how a test starts clean.
+// `version` counts registrations, so a wildcard subscriber notices new
+// topics with a single load.
+//
+// Lookups hash and probe; they are for resolving a topic once (topics.hpp),
+// never for each message.
+
+#pragma once
+
+#include <fnmatch.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../buffer/shm_segment.hpp"
+
+namespace pubsub {
+
+constexpr const char* TOPIC_REGISTRY_NAME = "pubsub_topics";
+constexpr size_t TOPIC_CAPACITY = 1024; // Entries; hundreds of topics keep probe chains short
+constexpr size_t TOPIC_NAME_MAX = 112;  // Including the NUL
+constexpr uint64_t TOPIC_REGISTRY_MAGIC = 0x31504f5442555350ULL; // "PSUBTOP1"
+
+enum : uint32_t { TOPIC_FREE = 0, TOPIC_CLAIMING = 1, TOPIC_READY = 2 };
+
+struct alignas(128) TopicEntry {
+    std::atomic<uint32_t> state;
+    std::atomic<int32_t> publisher_pid; // 0 when no publisher holds the topic
+    uint64_t hash;
+    char name[TOPIC_NAME_MAX];
+};
+
+struct TopicDirectory {
+    alignas(128) std::atomic<uint64_t> magic; // Set by the first process to map it
+    std::atomic<uint64_t> version;            // Registrations so far
+    TopicEntry entries[TOPIC_CAPACITY];
+};
+
+// A resolved topic: its directory entry and the segment holding its ring
+struct TopicInfo {
+    uint32_t id = 0;
+    std::string name;
+    std::string segment;
+};
+
+inline uint64_t topic_hash(const std::string& name) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : name) h = (h ^ c) * 0x100000001b3ull;
+    return h;
+}
+
+inline bool is_topic_pattern(const std::string& s) { return s.find_first_of("*?[") != std::string::npos; }
+
+// Shell-style: "md.AAPL" is exact, "md.*" a prefix, "md.*.trades" a wildcard
+inline bool topic_matches(const std::string& pattern, const std::string& name) {
+    return fnmatch(pattern.c_str(), name.c_str(), 0) == 0;
+}
+
+class TopicRegistry {
+private:
+    std::string registry;
+    SegmentOptions opts;
+    Segment seg;
+    TopicDirectory* dir = nullptr;
+
+    static bool entry_is(const TopicEntry& e, uint64_t hash, const std::string& name) {
+        return e.hash == hash && strncmp(e.name, name.c_str(), TOPIC_NAME_MAX) == 0;
+    }
+
+    // Waits out a registration in progress; false if the entry is free
+    static bool wait_ready(const TopicEntry& e) {
+        uint32_t state;
+        while ((state = e.state.load(std::memory_order_acquire)) == TOPIC_CLAIMING) std::this_thread::yield();
+        return state == TOPIC_READY;
+    }
+
+    TopicInfo info(uint32_t id) const {
+        return TopicInfo{id, dir->entries[id].name, registry + "." + std::to_string(id)};
+    }
+
+    // Probes for `name`; with `claim`, takes the first free entry on the way
+    bool probe(const std::string& name, bool claim, TopicInfo& out) {
+        uint64_t hash = topic_hash(name);
+        for (size_t i = 0; i < TOPIC_CAPACITY; ++i) {
+            uint32_t id = (uint32_t)((hash + i) % TOPIC_CAPACITY);
+            TopicEntry& e = dir->entries[id];
+            uint32_t state = TOPIC_FREE;
+            if (claim && e.state.compare_exchange_strong(state, TOPIC_CLAIMING, std::memory_order_acquire)) {
+                e.hash = hash;
+                strncpy(e.name, name.c_str(), TOPIC_NAME_MAX - 1);
+                e.name[TOPIC_NAME_MAX - 1] = '\0';
+                e.state.store(TOPIC_READY, std::memory_order_release);
+                dir->version.fetch_add(1, std::memory_order_release);
+                out = info(id);
+                return true;
+            }
+            if (!wait_ready(e)) return false; // End of the chain: not registered
+            if (entry_is(e, hash, name)) {
+                out = info(id);
+                return true;
+            }
+        }
+        if (claim) std::cerr << "Topic registry " << registry << " is full (" << TOPIC_CAPACITY << " topics)\n";
+        return false;
+    }
+
+public:
+    // Maps the directory, creating it if this is the first process to use it.
+    // Topic rings share `options`; memfd backing can't be used, as nothing
+    // would serve hundreds of fds.
+    explicit TopicRegistry(const std::string& name = TOPIC_REGISTRY_NAME, const SegmentOptions& options = SegmentOptions())
+        : registry(name), opts(options) {
+        if (opts.backing == SegmentBacking::Memfd) {
+            std::cerr << "Topic registries need a named backing (file or shm)\n";
+            return;
+        }
+        seg = create_segment(registry, sizeof(TopicDirectory), opts);
+        if (!seg.base) return;
+        dir = static_cast<TopicDirectory*>(seg.base);
+        uint64_t magic = 0;
+        if (!dir->magic.compare_exchange_strong(magic, TOPIC_REGISTRY_MAGIC) && magic != TOPIC_REGISTRY_MAGIC) {
+            std::cerr << "Segment " << registry << " is not a topic registry\n";
+            release_segment(seg);
+            dir = nullptr;
+        }
+    }
+
+    ~TopicRegistry() { release_segment(seg); }
+
+    TopicRegistry(const TopicRegistry&) = delete;
+    TopicRegistry& operator=(const TopicRegistry&) = delete;
+
+    bool ok() const { return dir != nullptr; }
+    const std::string& name() const { return registry; }
+    const SegmentOptions& segment_options() const { return opts; }
+    uint64_t version() const { return dir->version.load(std::memory_order_acquire); }
+
+    // The topic called `name`, registered now if it wasn't
+    bool register_topic(const std::string& name, TopicInfo& out) {
+        if (name.empty() || name.size() >= TOPIC_NAME_MAX || is_topic_pattern(name)) {
+            std::cerr << "Invalid topic name \"" << name << "\" (1-" << TOPIC_NAME_MAX - 1
+                      << " characters, no * ? [)\n";
+            return false;
+        }
+        return probe(name, true, out);
+    }
+
+    bool find(const std::string& name, TopicInfo& out) { return probe(name, false, out); }
+
+    // Calls f(const TopicInfo&) for every registered topic matching `pattern`
+    template <typename F>
+    void for_each_match(const std::string& pattern, F f) const {
+        for (uint32_t id = 0; id < TOPIC_CAPACITY; ++id) {
+            const TopicEntry& e = dir->entries[id];
+            if (e.state.load(std::memory_order_acquire) != TOPIC_READY) continue;
+            if (topic_matches(pattern, e.name)) f(info(id));
+        }
+    }
+
+    // The single publisher of topic `id`: refused while another live process
+    // holds it, the way the improved ring's publisher slot is
+    bool claim_publisher(uint32_t id) {
+        std::atomic<int32_t>& pid = dir->entries[id].publisher_pid;
+        int32_t self = getpid();
+        while (true) {
+            int32_t owner = pid.load(std::memory_order_acquire);
+            if (owner == self) return true;
+            if (owner != 0 && (kill(owner, 0) == 0 || errno == EPERM)) {
+                std::cerr << "Topic " << dir->entries[id].name << " already has a live publisher (pid " << owner
+                          << ")\n";
+                return false;
+            }
+            if (pid.compare_exchange_strong(owner, self, std::memory_order_acq_rel)) return true;
+        }
+    }
+
+    void release_publisher(uint32_t id) {
+        int32_t self = getpid();
+        dir->entries[id].publisher_pid.compare_exchange_strong(self, 0, std::memory_order_release);
+    }
+};
+
+// Removes a registry and every topic ring it names
+inline void remove_topic_registry(const std::string& name = TOPIC_REGISTRY_NAME,
+                                  const SegmentOptions& opts = SegmentOptions()) {
+    if (!segment_exists(name, opts)) return;
+    Segment seg = attach_segment(name, sizeof(TopicDirectory), opts);
+    if (seg.base) {
+        auto* dir = static_cast<TopicDirectory*>(seg.base);
+        for (uint32_t id = 0; id < TOPIC_CAPACITY; ++id) {
+            if (dir->entries[id].state.load(std::memory_order_acquire) != TOPIC_FREE) {
+                remove_segment(name + "." + std::to_string(id), opts);
+            }
+        }
+        release_segment(seg);
+    }
+    remove_segment(name, opts);
+}
+
+} // namespace pubsub
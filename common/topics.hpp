@@ -0,0 +1,221 @@
+// Topic publishers and subscribers over the shared-memory topic registry
+//
+// Each topic has its own ring segment, named by the registry
+// (topic_registry.hpp): one writer, any number of readers. A TopicPublisher
+// resolves its topic once when it is built, by registering the name, claiming
+// the topic's single publisher slot and mapping the ring. From then on
+// publish() writes straight into that mapping, with no lookup, hashing or
+// string handling per message.
+//
+// A TopicSubscriber takes an exact name or a shell-style pattern ("md.*",
+// "md.*.trades") and is handed the ring of every matching topic, including
+// topics registered after it subscribed. It checks the registry's version
+// counter on each poll and rescans only when that has moved. Exact names
+// are found by hash, and patterns by a scan of the directory.
+//
+// The rings never wait for readers, so a slow subscriber can't stall a
+// publisher, or through it every other subscriber of that topic. Each slot
+// is a seqlock. The writer makes the slot's sequence odd, fills it in, then
+// stores 2 * position + 2. A reader copies the slot out and accepts it only
+// if the sequence was that value before and after the copy. A reader that
+// was lapped skips to the oldest slot still in the ring and counts what it
+// missed in lost(). Both sides create the ring segment if it doesn't exist
+// yet. A zero-filled ring is empty, so subscribers may start before
+// publishers.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../buffer/shm_segment.hpp"
+#include "message.hpp"
+#include "topic_registry.hpp"
+
+namespace pubsub {
+
+constexpr size_t TOPIC_RING_SIZE = 1024;  // Slots per topic
+constexpr size_t TOPIC_MAX_PAYLOAD = 96;  // Bytes after the Msg; keeps a slot at two cache lines
+
+struct alignas(64) TopicSlot {
+    std::atomic<uint64_t> seq; // 2 * position + 2 once written; odd while being written
+    uint32_t len;
+    Msg msg;
+    char payload[TOPIC_MAX_PAYLOAD];
+};
+
+struct TopicRing {
+    alignas(128) std::atomic<uint64_t> head; // Next position; survives publisher restarts
+    alignas(128) TopicSlot slots[TOPIC_RING_SIZE];
+};
+
+namespace detail {
+
+// Maps a topic's ring, creating it if needed. The fd isn't kept: a process
+// with hundreds of topics would otherwise run into its fd limit.
+inline TopicRing* map_topic_ring(const TopicRegistry& registry, const TopicInfo& topic, Segment& seg) {
+    seg = create_segment(topic.segment, sizeof(TopicRing), registry.segment_options());
+    if (seg.fd >= 0) close(seg.fd);
+    seg.fd = -1;
+    return static_cast<TopicRing*>(seg.base);
+}
+
+} // namespace detail
+
+// A pre-resolved publishing handle for one topic
+class TopicPublisher {
+private:
+    TopicRegistry& registry;
+    TopicInfo topic;
+    Segment seg;
+    TopicRing* ring = nullptr;
+    uint64_t head = 0;
+    bool claimed = false;
+
+public:
+    TopicPublisher(TopicRegistry& reg, const std::string& name) : registry(reg) {
+        if (!registry.ok() || !registry.register_topic(name, topic)) return;
+        claimed = registry.claim_publisher(topic.id);
+        if (!claimed) return;
+        ring = detail::map_topic_ring(registry, topic, seg);
+        if (ring) head = ring->head.load(std::memory_order_acquire);
+    }
+
+    ~TopicPublisher() {
+        release_segment(seg);
+        if (claimed) registry.release_publisher(topic.id);
+    }
+
+    TopicPublisher(const TopicPublisher&) = delete;
+    TopicPublisher& operator=(const TopicPublisher&) = delete;
+
+    bool ok() const { return ring != nullptr; }
+    const TopicInfo& info() const { return topic; }
+
+    // Never blocks; false only if the payload is too large
+    bool publish(const Msg& m, const char* payload = nullptr, size_t len = 0) {
+        if (len > TOPIC_MAX_PAYLOAD) return false;
+        TopicSlot& slot = ring->slots[head % TOPIC_RING_SIZE];
+        slot.seq.store(2 * head + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release); // The odd sequence lands before the data
+        slot.msg = m;
+        slot.len = (uint32_t)len;
+        if (len) memcpy(slot.payload, payload, len);
+        slot.seq.store(2 * head + 2, std::memory_order_release);
+        ring->head.store(++head, std::memory_order_release);
+        return true;
+    }
+};
+
+// Every topic matching one name or pattern, polled round robin
+class TopicSubscriber {
+private:
+    struct Subscription {
+        TopicInfo topic;
+        Segment seg;
+        TopicRing* ring;
+        uint64_t cursor;
+    };
+
+    TopicRegistry& registry;
+    std::string pattern;
+    std::vector<Subscription> subs;
+    uint64_t seen_version = UINT64_MAX;
+    size_t next = 0;
+    uint64_t lost_count = 0;
+
+    // Topics that existed when we subscribed are read from their next
+    // message on; one registered later is new, so from its first (or the
+    // oldest the ring still holds)
+    void add(const TopicInfo& topic, bool existing) {
+        for (const Subscription& s : subs) {
+            if (s.topic.id == topic.id) return;
+        }
+        Subscription s{topic, Segment(), nullptr, 0};
+        s.ring = detail::map_topic_ring(registry, topic, s.seg);
+        if (!s.ring) return;
+        uint64_t head = s.ring->head.load(std::memory_order_acquire);
+        s.cursor = existing ? head : head > TOPIC_RING_SIZE ? head - TOPIC_RING_SIZE : 0;
+        subs.push_back(s);
+    }
+
+    // Takes the message at `s.cursor` if it has been written
+    bool take(Subscription& s, Msg& m, char* payload, size_t* len) {
+        while (true) {
+            const TopicSlot& slot = s.ring->slots[s.cursor % TOPIC_RING_SIZE];
+            uint64_t want = 2 * s.cursor + 2;
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq < want) return false; // Not written yet (or being written)
+            if (seq == want) {
+                Msg copy = slot.msg;
+                size_t n = std::min<size_t>(slot.len, TOPIC_MAX_PAYLOAD);
+                if (payload) memcpy(payload, slot.payload, n);
+                std::atomic_thread_fence(std::memory_order_acquire); // The copy completes before the re-check
+                if (slot.seq.load(std::memory_order_relaxed) == want) {
+                    m = copy;
+                    if (len) *len = n;
+                    ++s.cursor;
+                    return true;
+                }
+            }
+            // Lapped: resume at the oldest message still in the ring
+            uint64_t head = s.ring->head.load(std::memory_order_acquire);
+            uint64_t oldest = head > TOPIC_RING_SIZE ? head - TOPIC_RING_SIZE + 1 : 0;
+            uint64_t resume = std::max(oldest, s.cursor + 1);
+            lost_count += resume - s.cursor;
+            s.cursor = resume;
+        }
+    }
+
+public:
+    TopicSubscriber(TopicRegistry& reg, const std::string& name_or_pattern)
+        : registry(reg), pattern(name_or_pattern) {
+        if (registry.ok()) refresh();
+    }
+
+    ~TopicSubscriber() {
+        for (Subscription& s : subs) release_segment(s.seg);
+    }
+
+    TopicSubscriber(const TopicSubscriber&) = delete;
+    TopicSubscriber& operator=(const TopicSubscriber&) = delete;
+
+    bool ok() const { return registry.ok(); }
+    size_t topic_count() const { return subs.size(); }
+    const TopicInfo& topic(size_t i) const { return subs[i].topic; }
+    uint64_t lost() const { return lost_count; }
+
+    // Picks up topics registered since the last call; cheap when none were
+    void refresh() {
+        uint64_t version = registry.version();
+        if (version == seen_version) return;
+        bool existing = seen_version == UINT64_MAX;
+        seen_version = version;
+        if (!is_topic_pattern(pattern)) {
+            TopicInfo topic;
+            if (subs.empty() && registry.find(pattern, topic)) add(topic, existing);
+            return;
+        }
+        registry.for_each_match(pattern, [&](const TopicInfo& topic) { add(topic, existing); });
+    }
+
+    // The next message from any subscribed topic; `*topic_index` says which
+    // (see topic()). Never blocks.
+    bool try_recv(Msg& m, size_t* topic_index = nullptr, char* payload = nullptr, size_t* len = nullptr) {
+        refresh();
+        for (size_t i = 0; i < subs.size(); ++i) {
+            size_t at = (next + i) % subs.size();
+            if (take(subs[at], m, payload, len)) {
+                next = at + 1;
+                if (topic_index) *topic_index = at;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+} // namespace pubsub
@@ -0,0 +1,255 @@
+// CPU topology and process placement for the benchmarks
+//
+// discover_topology() reads the socket, NUMA node, physical core and shared
+// L3 of every CPU this process may run on from /sys/devices/system. From
+// that, placements() picks one publisher/subscriber CPU pair for each
+// distance between them:
+//
+//   same_cpu      both on one logical CPU (always available)
+//   smt_sibling   two hardware threads of one core: L1/L2 shared
+//   same_l3       different cores sharing an L3
+//   cross_l3      same socket, different L3 (chiplets, sub-NUMA clusters)
+//   cross_socket  different sockets: every cache line crosses the interconnect
+//
+// A distance the machine lacks (one socket, no SMT) is simply missing from
+// the list. pin_to_cpu(), set_realtime() and lock_memory() apply a
+// placement to the calling process; each reports and returns false if not
+// permitted, and the run goes on without it. Placement is Linux only;
+// elsewhere the topology is one CPU and the setters do nothing.
+
+#pragma once
+
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace pubsub {
+
+constexpr int REALTIME_PRIORITY = 1; // Lowest SCHED_FIFO priority: above every normal task, below kernel RT threads
+
+struct CpuInfo {
+    int cpu = 0;
+    int socket = 0;
+    int node = 0;
+    int core = 0; // Unique across sockets: the lowest CPU among its SMT siblings
+    int l3 = 0;   // Lowest CPU sharing its L3; without L3 information, -1 - socket
+};
+
+struct Topology {
+    std::vector<CpuInfo> cpus; // Allowed CPUs only, by number
+    int sockets = 0;
+    int nodes = 0;
+    int cores = 0;
+    int l3s = 0;
+};
+
+enum class Distance { SameCpu, SmtSibling, SameL3, CrossL3, CrossSocket };
+
+struct Placement {
+    Distance distance;
+    int pub_cpu;
+    int sub_cpu;
+};
+
+inline const char* distance_name(Distance d) {
+    switch (d) {
+        case Distance::SameCpu: return "same_cpu";
+        case Distance::SmtSibling: return "smt_sibling";
+        case Distance::SameL3: return "same_l3";
+        case Distance::CrossL3: return "cross_l3";
+        case Distance::CrossSocket: return "cross_socket";
+    }
+    return "?";
+}
+
+namespace detail {
+
+inline std::string read_sys(const std::string& path) {
+    std::ifstream in(path);
+    std::string value;
+    std::getline(in, value);
+    return value;
+}
+
+inline int read_sys_int(const std::string& path, int fallback) {
+    std::string value = read_sys(path);
+    return value.empty() ? fallback : std::atoi(value.c_str());
+}
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+inline std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    for (std::string range; std::getline(ss, range, ',');) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int c = first; c <= last; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+inline int lowest_cpu(const std::string& list, int fallback) {
+    std::vector<int> cpus = parse_cpu_list(list);
+    return cpus.empty() ? fallback : *std::min_element(cpus.begin(), cpus.end());
+}
+
+// The cpuN/nodeM link names the node; 0 without NUMA support
+inline int cpu_node(const std::string& dir) {
+    int node = 0;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return node;
+    while (dirent* e = readdir(d)) {
+        if (strncmp(e->d_name, "node", 4) == 0 && e->d_name[4] >= '0' && e->d_name[4] <= '9') {
+            node = std::atoi(e->d_name + 4);
+            break;
+        }
+    }
+    closedir(d);
+    return node;
+}
+
+inline int l3_domain(const std::string& dir, int fallback) {
+    for (int index = 0;; ++index) {
+        std::string cache = dir + "/cache/index" + std::to_string(index);
+        int level = read_sys_int(cache + "/level", -1);
+        if (level < 0) return fallback;
+        if (level == 3) return lowest_cpu(read_sys(cache + "/shared_cpu_list"), fallback);
+    }
+}
+
+} // namespace detail
+
+inline Topology discover_topology() {
+    Topology t;
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) CPU_ZERO(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        CpuInfo c;
+        c.cpu = cpu;
+        c.socket = std::max(detail::read_sys_int(dir + "/topology/physical_package_id", 0), 0);
+        c.node = detail::cpu_node(dir);
+        c.core = detail::lowest_cpu(detail::read_sys(dir + "/topology/thread_siblings_list"), cpu);
+        c.l3 = detail::l3_domain(dir, -1 - c.socket); // Negative: can't clash with a CPU number
+        t.cpus.push_back(c);
+    }
+#endif
+    if (t.cpus.empty()) t.cpus.push_back(CpuInfo{});
+    std::set<int> sockets, nodes, cores, l3s;
+    for (const CpuInfo& c : t.cpus) {
+        sockets.insert(c.socket);
+        nodes.insert(c.node);
+        cores.insert(c.core);
+        l3s.insert(c.l3);
+    }
+    t.sockets = (int)sockets.size();
+    t.nodes = (int)nodes.size();
+    t.cores = (int)cores.size();
+    t.l3s = (int)l3s.size();
+    return t;
+}
+
+inline Distance distance_between(const CpuInfo& a, const CpuInfo& b) {
+    if (a.cpu == b.cpu) return Distance::SameCpu;
+    if (a.core == b.core) return Distance::SmtSibling;
+    if (a.l3 == b.l3) return Distance::SameL3;
+    if (a.socket == b.socket) return Distance::CrossL3;
+    return Distance::CrossSocket;
+}
+
+// One pair per distance the machine has, nearest first. CPU 0's core takes
+// most of the interrupts, so a pair avoiding it is preferred when there is one.
+inline std::vector<Placement> placements(const Topology& t) {
+    std::vector<Placement> out;
+    int busy_core = t.cpus.front().core;
+    for (Distance d : {Distance::SameCpu, Distance::SmtSibling, Distance::SameL3, Distance::CrossL3,
+                       Distance::CrossSocket}) {
+        const CpuInfo* pick_a = nullptr;
+        const CpuInfo* pick_b = nullptr;
+        bool pick_avoids = false;
+        for (const CpuInfo& a : t.cpus) {
+            for (const CpuInfo& b : t.cpus) {
+                if (distance_between(a, b) != d || (d != Distance::SameCpu && b.cpu <= a.cpu)) continue;
+                bool avoids = a.core != busy_core && b.core != busy_core;
+                if (!pick_a || (avoids && !pick_avoids)) {
+                    pick_a = &a;
+                    pick_b = &b;
+                    pick_avoids = avoids;
+                }
+            }
+        }
+        if (pick_a) out.push_back(Placement{d, pick_a->cpu, pick_b->cpu});
+    }
+    return out;
+}
+
+inline const CpuInfo* find_cpu(const Topology& t, int cpu) {
+    for (const CpuInfo& c : t.cpus) {
+        if (c.cpu == cpu) return &c;
+    }
+    return nullptr;
+}
+
+// Pins the calling thread, and the threads it starts from then on, to one
+// CPU; call it before anything (a ZeroMQ context) starts threads
+inline bool pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) == 0) return true;
+    perror("sched_setaffinity");
+#else
+    (void)cpu;
+#endif
+    return false;
+}
+
+// SCHED_FIFO at REALTIME_PRIORITY; needs CAP_SYS_NICE or RLIMIT_RTPRIO
+inline bool set_realtime() {
+#ifdef __linux__
+    sched_param param{};
+    param.sched_priority = REALTIME_PRIORITY;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) == 0) return true;
+    perror("sched_setscheduler(SCHED_FIFO) (continuing unprivileged)");
+#endif
+    return false;
+}
+
+// Locks every current page, and future ones too when the memlock limit
+// allows it, so nothing is paged out or faulted in during a run. With a
+// finite limit MCL_FUTURE would make later allocations (thread stacks) fail.
+inline bool lock_memory() {
+#ifdef __linux__
+    rlimit limit{};
+    bool unlimited = geteuid() == 0 || (getrlimit(RLIMIT_MEMLOCK, &limit) == 0 && limit.rlim_cur == RLIM_INFINITY);
+    if (mlockall(MCL_CURRENT | (unlimited ? MCL_FUTURE : 0)) == 0) return true;
+    perror("mlockall (continuing unlocked)");
+#endif
+    return false;
+}
+
+// " sockets=2 nodes=2 l3s=4 cores=32 cpus=64", each preceded by a space
+inline void print_topology_fields(std::ostream& out, const Topology& t) {
+    out << " sockets=" << t.sockets << " nodes=" << t.nodes << " l3s=" << t.l3s << " cores=" << t.cores
+        << " cpus=" << t.cpus.size();
+}
+
+} // namespace pubsub
@@ -0,0 +1,45 @@
+// Transport concept for the shared ping-pong driver (driver.hpp)
+//
+// A transport connects one publisher to one subscriber and moves Msg values
+// in both directions, each optionally followed by up to MAX_PAYLOAD bytes of
+// payload in the same message. Every transport provides:
+//
+//   static constexpr const char* name;          "udp", "shm", "zmq"
+//   static constexpr size_t max_payload;        largest payload it carries
+//   Transport(Role role, const std::string& address);
+//   bool ok() const;                            false if setup failed (already reported)
+//   bool send(const Msg& m, const char* payload = nullptr, size_t len = 0);
+//                                               false on error
+//   bool recv(Msg& m, char* payload = nullptr, size_t* len = nullptr);
+//                                               blocks; false on error, and on the
+//                                               publisher side after RECV_TIMEOUT_MS
+//   bool try_recv(Msg& m, char* payload = nullptr, size_t* len = nullptr);
+//                                               never blocks; false if nothing is waiting
+//
+// A receive buffer `payload` has room for max_payload bytes; the payload's
+// length goes to *len. Without one the payload is dropped.
+//
+// Transports are chosen at compile time: the driver is a template over the
+// transport type, and pubsub_bench (bench.cpp) instantiates it for each one
+// and picks the instantiation at run time from its command line. Addresses
+// are transport specific:
+//
+//   udp  publisher host:port, subscriber port (binds INADDR_ANY)
+//   shm  segment name on both sides; the publisher owns and resets it
+//   zmq  publisher connect endpoint, subscriber bind endpoint
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "message.hpp"
+
+namespace pubsub {
+
+enum class Role { Publisher, Subscriber };
+
+constexpr int RECV_TIMEOUT_MS = 1000; // Publisher side: a reply later than this counts as lost
+constexpr size_t MAX_PAYLOAD = 65000; // Bytes after the Msg; a Msg and this fit one UDP datagram
+
+} // namespace pubsub
@@ -0,0 +1,115 @@
+// UDP transport (see transport.hpp): one blocking datagram socket
+//
+// The publisher connect()s to host:port, so it only ever hears from its
+// subscriber. The subscriber binds the port and answers whoever sent the
+// last message. A Msg and its payload travel as one datagram.
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "transport.hpp"
+
+namespace pubsub {
+
+class UdpTransport {
+private:
+    int sock = -1;
+    Role role;
+    sockaddr_in peer{};
+    socklen_t peer_len = sizeof(peer);
+
+    // One datagram scattered into `m` and `payload`; the bytes read, or -1
+    ssize_t receive(Msg& m, char* payload, size_t* len, int flags) {
+        iovec iov[2] = {{&m, sizeof(m)}, {payload, payload ? max_payload : 0}};
+        msghdr mh{};
+        mh.msg_name = &peer;
+        mh.msg_namelen = sizeof(peer);
+        mh.msg_iov = iov;
+        mh.msg_iovlen = payload ? 2 : 1;
+        ssize_t n = recvmsg(sock, &mh, flags);
+        peer_len = mh.msg_namelen;
+        if (len && n >= (ssize_t)sizeof(m)) *len = n - sizeof(m);
+        return n;
+    }
+
+public:
+    static constexpr const char* name = "udp";
+    static constexpr size_t max_payload = MAX_PAYLOAD;
+
+    UdpTransport(Role r, const std::string& address) : role(r) {
+        std::string host = "0.0.0.0";
+        std::string port = address;
+        size_t colon = address.rfind(':');
+        if (colon != std::string::npos) {
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)std::stoi(port));
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+            std::cerr << "udp: bad address " << address << "\n";
+            return;
+        }
+
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0) { perror("socket"); return; }
+        if (role == Role::Publisher) {
+            timeval tv{RECV_TIMEOUT_MS / 1000, (RECV_TIMEOUT_MS % 1000) * 1000};
+            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            if (connect(sock, (sockaddr*)&addr, sizeof(addr)) < 0) { perror("connect"); close(sock); sock = -1; }
+        } else {
+            if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) { perror("bind"); close(sock); sock = -1; }
+        }
+    }
+
+    ~UdpTransport() {
+        if (sock >= 0) close(sock);
+    }
+
+    UdpTransport(const UdpTransport&) = delete;
+    UdpTransport& operator=(const UdpTransport&) = delete;
+
+    bool ok() const { return sock >= 0; }
+
+    // The Msg and the payload go out as one datagram, gathered from both
+    bool send(const Msg& m, const char* payload = nullptr, size_t len = 0) {
+        iovec iov[2] = {{const_cast<Msg*>(&m), sizeof(m)}, {const_cast<char*>(payload), len}};
+        msghdr mh{};
+        if (role == Role::Subscriber) {
+            mh.msg_name = &peer;
+            mh.msg_namelen = peer_len;
+        }
+        mh.msg_iov = iov;
+        mh.msg_iovlen = len ? 2 : 1;
+        return sendmsg(sock, &mh, 0) == (ssize_t)(sizeof(m) + len);
+    }
+
+    bool recv(Msg& m, char* payload = nullptr, size_t* len = nullptr) {
+        while (true) {
+            ssize_t n = receive(m, payload, len, 0);
+            if (n >= (ssize_t)sizeof(m)) return true;
+            if (n < 0 && errno != EINTR) return false; // Includes the publisher's timeout
+        }
+    }
+
+    bool try_recv(Msg& m, char* payload = nullptr, size_t* len = nullptr) {
+        while (true) {
+            ssize_t n = receive(m, payload, len, MSG_DONTWAIT);
+            if (n >= (ssize_t)sizeof(m)) return true;
+            if (n < 0) return false;
+        }
+    }
+};
+
+} // namespace pubsub
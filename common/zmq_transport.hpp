@@ -0,0 +1,85 @@
+// ZeroMQ transport (see transport.hpp): a DEALER socket on each side
+//
+// DEALER-DEALER carries single frames both ways without REQ-REP's lock-step
+// state machine, so a publisher that timed out on one reply can still send
+// the next request. The publisher connects, the subscriber binds; any
+// endpoint libzmq accepts works except inproc, which needs both sockets in
+// one process. A Msg and its payload go out as one frame, copied together
+// into a buffer kept for the purpose.
+
+#pragma once
+
+#include <zmq.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "transport.hpp"
+
+namespace pubsub {
+
+class ZmqTransport {
+private:
+    zmq::context_t ctx{1};
+    zmq::socket_t sock;
+    std::vector<char> frame = std::vector<char>(sizeof(Msg) + MAX_PAYLOAD); // One message, Msg first
+
+    // Takes the next well-formed message; frames shorter than a Msg, or with
+    // more payload than fits, are skipped
+    bool receive(Msg& m, char* payload, size_t* len, zmq::recv_flags flags) {
+        while (true) {
+            auto n = sock.recv(zmq::buffer(frame.data(), frame.size()), flags);
+            if (!n) return false; // Nothing waiting, or the publisher's timeout
+            if (n->untruncated_size < sizeof(m) || n->untruncated_size > frame.size()) continue;
+            memcpy(&m, frame.data(), sizeof(m));
+            if (payload) memcpy(payload, frame.data() + sizeof(m), n->size - sizeof(m));
+            if (len) *len = n->size - sizeof(m);
+            return true;
+        }
+    }
+
+public:
+    static constexpr const char* name = "zmq";
+    static constexpr size_t max_payload = MAX_PAYLOAD;
+
+    ZmqTransport(Role role, const std::string& address) {
+        try {
+            sock = zmq::socket_t(ctx, zmq::socket_type::dealer);
+            sock.set(zmq::sockopt::linger, 0);
+            if (role == Role::Publisher) {
+                sock.set(zmq::sockopt::rcvtimeo, RECV_TIMEOUT_MS);
+                sock.connect(address);
+            } else {
+                sock.bind(address);
+            }
+        } catch (const zmq::error_t& e) {
+            std::cerr << "zmq " << address << ": " << e.what() << "\n";
+            sock.close();
+        }
+    }
+
+    ZmqTransport(const ZmqTransport&) = delete;
+    ZmqTransport& operator=(const ZmqTransport&) = delete;
+
+    bool ok() const { return sock.handle() != nullptr; }
+
+    bool send(const Msg& m, const char* payload = nullptr, size_t len = 0) {
+        if (!len) return sock.send(zmq::buffer(&m, sizeof(m)), zmq::send_flags::none).has_value();
+        memcpy(frame.data(), &m, sizeof(m));
+        memcpy(frame.data() + sizeof(m), payload, len);
+        return sock.send(zmq::buffer(frame.data(), sizeof(m) + len), zmq::send_flags::none).has_value();
+    }
+
+    bool recv(Msg& m, char* payload = nullptr, size_t* len = nullptr) {
+        return receive(m, payload, len, zmq::recv_flags::none);
+    }
+
+    bool try_recv(Msg& m, char* payload = nullptr, size_t* len = nullptr) {
+        return receive(m, payload, len, zmq::recv_flags::dontwait);
+    }
+};
+
+} // namespace pubsub
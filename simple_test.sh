@@ -27,16 +27,37 @@ kill $SHM_SUB_PID 2>/dev/null
 wait $SHM_SUB_PID 2>/dev/null
 echo ""
 
-# Test Improved SHM
-echo "Testing Improved SHM implementation..."
-./shm_subscriber_improved test_shm_improved &
-SHM_IMPROVED_SUB_PID=$!
-sleep 1
-echo "Improved SHM Results:"
-./shm_publisher_improved test_shm_improved 1000
-kill $SHM_IMPROVED_SUB_PID 2>/dev/null
-wait $SHM_IMPROVED_SUB_PID 2>/dev/null
-echo ""
+# Test Improved SHM (packed vs. cache-line aligned layout)
+for LAYOUT in packed aligned; do
+    echo "Testing Improved SHM implementation (layout=$LAYOUT)..."
+    rm -f /tmp/test_shm_$LAYOUT /dev/shm/test_shm_$LAYOUT
+    ./shm_publisher_improved test_shm_$LAYOUT 1000 --layout=$LAYOUT &
+    SHM_IMPROVED_PUB_PID=$!
+    sleep 1
+    ./shm_subscriber_improved test_shm_$LAYOUT --layout=$LAYOUT > /dev/null &
+    SHM_IMPROVED_SUB_PID=$!
+    echo "Improved SHM Results:"
+    wait $SHM_IMPROVED_PUB_PID
+    kill $SHM_IMPROVED_SUB_PID 2>/dev/null
+    wait $SHM_IMPROVED_SUB_PID 2>/dev/null
+    echo ""
+done
+
+# Test Varlen SHM at the largest record size (MAX_RECORD), fixed and mixed
+for SIZES in "524280 524280" "40 524280"; do
+    echo "Testing Varlen SHM implementation (sizes=$SIZES)..."
+    rm -f /tmp/test_varlen_max
+    ./shm_varlen_publisher test_varlen_max 200 $SIZES &
+    SHM_VARLEN_PUB_PID=$!
+    sleep 1
+    ./shm_varlen_subscriber test_varlen_max > /dev/null &
+    SHM_VARLEN_SUB_PID=$!
+    echo "Varlen SHM Results:"
+    wait $SHM_VARLEN_PUB_PID
+    kill $SHM_VARLEN_SUB_PID 2>/dev/null
+    wait $SHM_VARLEN_SUB_PID 2>/dev/null
+    echo ""
+done
 
 echo "Test completed!"
 echo ""
@@ -1,5 +1,5 @@
 // Unified test harness for all three latency implementations
-// Usage: ./latency_test [count] [warmup]
+// Usage: ./latency_test [count] [warmup] [repeats] [--regression] [--baseline=FILE]
 
 #include <iostream>
 #include <vector>
@@ -9,35 +9,190 @@
 #include <fstream>
 #include <algorithm>
 #include <sstream>
+#include <cmath>
 #include <cstdlib>
+#include <map>
 #include <signal.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "common/histogram.hpp"
+#include "common/stats.hpp"
+#include "common/topic_registry.hpp"
+#include "common/topology.hpp"
+
 using namespace std;
 using ns = chrono::nanoseconds;
 using clk = chrono::high_resolution_clock;
 
+// One transport/payload configuration of the regression suite: the RTT
+// histograms of all its runs merged, plus each run's own figures for the
+// run-to-run spread
 struct LatencyStats {
-    string name;
-    vector<double> rtts;
-    double avg;
-    double median;
-    double p95;
-    double p99;
-    double min;
-    double max;
+    string transport;
+    int payload = 0;
+    pubsub::Histogram merged;
+    vector<double> run_avg_us;
+    vector<double> run_p50_us;
+    vector<double> run_p99_us;
+    uint64_t lost = 0;
+};
+
+// Mean of `v` and the half-width of its 95% confidence interval (Student's t)
+struct Interval {
+    double mean = 0;
+    double ci95 = 0;
 };
 
+static Interval confidenceInterval(const vector<double>& v) {
+    // Two-sided 97.5% quantiles of t for 1..30 degrees of freedom
+    static const double t975[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                  2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    Interval r;
+    if (v.empty()) return r;
+    for (double x : v) r.mean += x;
+    r.mean /= v.size();
+    if (v.size() < 2) return r;
+    double var = 0;
+    for (double x : v) var += (x - r.mean) * (x - r.mean);
+    var /= v.size() - 1;
+    size_t df = v.size() - 1;
+    double t = df <= 30 ? t975[df - 1] : 1.960;
+    r.ci95 = t * sqrt(var / v.size());
+    return r;
+}
+
 class LatencyTest {
 private:
     int count;
     int warmup;
+    int repeats;
     vector<LatencyStats> results;
     
+    // Fork/exec subscribers and a publisher whose stdout is captured and
+    // returned (and echoed) so the caller can pick numbers out of it. The
+    // subscribers start first unless the publisher has to create the segment.
+    string runCapturedGroup(const vector<vector<string>>& subs_argv, const vector<string>& pub_argv,
+                            bool publisher_first = false) {
+        auto to_cargv = [](const vector<string>& args) {
+            vector<char*> out;
+            for (const auto& a : args) out.push_back(const_cast<char*>(a.c_str()));
+            out.push_back(nullptr);
+            return out;
+        };
+        vector<pid_t> sub_pids;
+        auto start_subscribers = [&]() {
+            for (const auto& sub_argv : subs_argv) {
+                pid_t pid = fork();
+                if (pid == 0) {
+                    auto cargv = to_cargv(sub_argv);
+                    execv(cargv[0], cargv.data());
+                    exit(1);
+                }
+                sub_pids.push_back(pid);
+            }
+            // Wait for subscribers to start
+            this_thread::sleep_for(chrono::milliseconds(100));
+        };
+        
+        if (!publisher_first) start_subscribers();
+        
+        int pipefd[2];
+        if (pipe(pipefd) < 0) { perror("pipe"); return ""; }
+        pid_t pub_pid = fork();
+        if (pub_pid == 0) {
+            close(pipefd[0]);
+            dup2(pipefd[1], STDOUT_FILENO);
+            auto cargv = to_cargv(pub_argv);
+            execv(cargv[0], cargv.data());
+            exit(1);
+        }
+        close(pipefd[1]);
+        
+        if (publisher_first) {
+            this_thread::sleep_for(chrono::milliseconds(100));
+            start_subscribers();
+        }
+        
+        string output;
+        char buf[4096];
+        ssize_t n;
+        while ((n = read(pipefd[0], buf, sizeof(buf))) > 0) output.append(buf, n);
+        close(pipefd[0]);
+        cout << output;
+        
+        int status;
+        waitpid(pub_pid, &status, 0);
+        for (pid_t pid : sub_pids) kill(pid, SIGTERM);
+        for (pid_t pid : sub_pids) waitpid(pid, &status, 0);
+        return output;
+    }
+    
+    string runCapturedPair(const vector<string>& sub_argv, const vector<string>& pub_argv,
+                           bool publisher_first = false) {
+        return runCapturedGroup({sub_argv}, pub_argv, publisher_first);
+    }
+    
+    // Removes a stale improved-ring segment under either named backing
+    static void removeSegment(const string& shm_name) {
+        unlink(("/tmp/" + shm_name).c_str());
+        shm_unlink(("/" + shm_name).c_str());
+    }
+    
+    // Merges a histogram written by pubsub_bench --results= into `h`
+    static bool readHistogram(const string& path, pubsub::Histogram& h) {
+        ifstream in(path, ios::binary);
+        vector<char> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        return !bytes.empty() && h.decode_add(bytes.data(), bytes.size()) == bytes.size();
+    }
+    
+    // Value of "key=<number>" in a publisher result line, or -1 if missing
+    static double parseField(const string& output, const string& key) {
+        size_t pos = output.find(key + "=");
+        if (pos == string::npos) return -1;
+        return atof(output.c_str() + pos + key.size() + 1);
+    }
+    
+    // One pubsub_bench transport and where its two sides meet. `extra` is
+    // passed to both sides; `label` names the row when a transport appears
+    // more than once with different extras.
+    struct Transport {
+        string label;
+        string name;
+        string sub_address;
+        string pub_address;
+        vector<string> extra;
+    };
+    
+    // UDP, SHM and ZeroMQ for one test: UDP on `port`, ZeroMQ on `port + 1`
+    // and SHM on segment `segment`, so tests never share an endpoint.
+    static vector<Transport> benchTransports(int port, const string& segment) {
+        string udp_port = to_string(port), zmq_port = to_string(port + 1);
+        return {
+            {"udp", "udp", udp_port, "127.0.0.1:" + udp_port, {}},
+            {"shm", "shm", segment, segment, {}},
+            {"zmq", "zmq", "tcp://*:" + zmq_port, "tcp://127.0.0.1:" + zmq_port, {}},
+        };
+    }
+    
+    // One pubsub_bench ping-pong over `t` with the harness's count and
+    // warmup; returns the publisher's output.
+    string runBenchPair(const Transport& t, const vector<string>& pub_args = {},
+                        const vector<string>& sub_args = {}) {
+        vector<string> sub_argv = {"./pubsub_bench", "sub", t.name, t.sub_address};
+        vector<string> pub_argv = {"./pubsub_bench", "pub", t.name, t.pub_address, to_string(count),
+                                   "--warmup=" + to_string(warmup)};
+        for (auto* argv : {&sub_argv, &pub_argv}) argv->insert(argv->end(), t.extra.begin(), t.extra.end());
+        sub_argv.insert(sub_argv.end(), sub_args.begin(), sub_args.end());
+        pub_argv.insert(pub_argv.end(), pub_args.begin(), pub_args.end());
+        return runCapturedPair(sub_argv, pub_argv);
+    }
+    
 public:
-    LatencyTest(int msg_count = 10000, int warmup_count = 1000) 
-        : count(msg_count), warmup(warmup_count) {}
+    LatencyTest(int msg_count = 10000, int warmup_count = 1000, int repeat_count = 5)
+        : count(msg_count), warmup(warmup_count), repeats(repeat_count) {}
     
     void runUDPTest() {
         cout << "\n=== UDP Latency Test ===" << endl;
@@ -71,6 +226,210 @@ public:
         cout << "UDP test completed" << endl;
     }
     
+    // One-way UDP streaming: packets/sec, syscalls per message and drops for
+    // one datagram per syscall vs. sendmmsg/recvmmsg batches vs. GSO/GRO.
+    void runUDPStreamTest() {
+        cout << "\n=== UDP Streaming Throughput ===" << endl;
+        
+        string count_str = to_string(max(count, 100000));
+        vector<pair<string, string>> rows;
+        for (string batch : {"1", "8", "64"}) {
+            for (bool offload : {false, true}) {
+                if (offload && batch == "1") continue;
+                vector<string> sub_argv = {"./udp_subscriber", "5556", "--sink", "--batch=" + batch};
+                vector<string> pub_argv = {"./udp_publisher", "127.0.0.1", "5556", count_str,
+                                           "--stream", "--batch=" + batch};
+                if (offload) {
+                    sub_argv.push_back("--gro");
+                    pub_argv.push_back("--gso");
+                }
+                rows.push_back({batch + (offload ? "+gso" : ""), runCapturedPair(sub_argv, pub_argv)});
+            }
+        }
+        
+        cout << "\nBatch    sent_pps  recv_pps  pub_sys/msg  sub_sys/msg  dropped" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(9 - row.first.size(), ' ')
+                 << parseField(row.second, "sent_pps") << "  "
+                 << parseField(row.second, "recv_pps") << "  "
+                 << parseField(row.second, "pub_syscalls_per_msg") << "  "
+                 << parseField(row.second, "sub_syscalls_per_msg") << "  "
+                 << parseField(row.second, "dropped") << endl;
+        }
+    }
+    
+    // Blocking sockets vs. the io_uring engine (multishot recv, provided
+    // buffers, registered fds/buffers) with and without SQPOLL: ping-pong
+    // p50/p99 RTT and peak one-way pps. Each run gets its own port because a
+    // ring's registered socket outlives the process briefly.
+    void runUDPIoComparison() {
+        cout << "\n=== UDP I/O Engine Comparison ===" << endl;
+        
+        string count_str = to_string(count);
+        string stream_count = to_string(max(count, 100000));
+        vector<pair<string, vector<string>>> engines = {
+            {"blocking", {"--io=blocking"}},
+            {"uring", {"--io=uring"}},
+            {"uring+sqpoll", {"--io=uring", "--sqpoll"}},
+        };
+        vector<pair<string, string>> ping_rows, stream_rows;
+        int port = 5560;
+        for (const auto& engine : engines) {
+            string ping_port = to_string(port++);
+            vector<string> sub_argv = {"./udp_subscriber", ping_port};
+            vector<string> pub_argv = {"./udp_publisher", "127.0.0.1", ping_port, count_str};
+            sub_argv.insert(sub_argv.end(), engine.second.begin(), engine.second.end());
+            pub_argv.insert(pub_argv.end(), engine.second.begin(), engine.second.end());
+            ping_rows.push_back({engine.first, runCapturedPair(sub_argv, pub_argv)});
+            
+            string stream_port = to_string(port++);
+            sub_argv = {"./udp_subscriber", stream_port, "--sink", "--batch=64"};
+            pub_argv = {"./udp_publisher", "127.0.0.1", stream_port, stream_count, "--stream", "--batch=64"};
+            sub_argv.insert(sub_argv.end(), engine.second.begin(), engine.second.end());
+            pub_argv.insert(pub_argv.end(), engine.second.begin(), engine.second.end());
+            stream_rows.push_back({engine.first, runCapturedPair(sub_argv, pub_argv)});
+        }
+        
+        cout << "\nEngine         p50_us  p99_us  ping_sys/msg  stream_recv_pps  pub_sys/msg  sub_sys/msg" << endl;
+        for (size_t i = 0; i < engines.size(); ++i) {
+            const string& name = engines[i].first;
+            cout << name << string(15 - name.size(), ' ')
+                 << parseField(ping_rows[i].second, "median_RTT_us") << "  "
+                 << parseField(ping_rows[i].second, "p99_RTT_us") << "  "
+                 << parseField(ping_rows[i].second, "syscalls_per_msg") << "  "
+                 << parseField(stream_rows[i].second, "recv_pps") << "  "
+                 << parseField(stream_rows[i].second, "pub_syscalls_per_msg") << "  "
+                 << parseField(stream_rows[i].second, "sub_syscalls_per_msg") << endl;
+        }
+    }
+    
+    // --reliable ping-pong under injected loss/reorder on both sides: the
+    // tail-latency cost of NACK and timeout recovery
+    void runUDPReliabilityTest() {
+        cout << "\n=== UDP Reliability (Loss Injection) ===" << endl;
+        
+        string count_str = to_string(count);
+        vector<pair<string, string>> cases = {{"0", "0"}, {"1", "0"}, {"5", "0"}, {"0", "5"}};
+        vector<string> outputs;
+        int port = 5570;
+        for (const auto& c : cases) {
+            string p = to_string(port++);
+            vector<string> inject = {"--loss=" + c.first, "--reorder=" + c.second};
+            vector<string> sub_argv = {"./udp_subscriber", p, "--reliable"};
+            vector<string> pub_argv = {"./udp_publisher", "127.0.0.1", p, count_str, "--reliable"};
+            sub_argv.insert(sub_argv.end(), inject.begin(), inject.end());
+            pub_argv.insert(pub_argv.end(), inject.begin(), inject.end());
+            outputs.push_back(runCapturedPair(sub_argv, pub_argv));
+        }
+        
+        cout << "\nLoss%  Reorder%  p50_us  p99_us  p99.9_us  max_us  retransmits  msgs/s" << endl;
+        for (size_t i = 0; i < cases.size(); ++i) {
+            cout << cases[i].first << string(7 - cases[i].first.size(), ' ')
+                 << cases[i].second << string(10 - cases[i].second.size(), ' ')
+                 << parseField(outputs[i], "median_RTT_us") << "  "
+                 << parseField(outputs[i], "p99_RTT_us") << "  "
+                 << parseField(outputs[i], "p999_RTT_us") << "  "
+                 << parseField(outputs[i], "max_RTT_us") << "  "
+                 << parseField(outputs[i], "retransmits") << "  "
+                 << parseField(outputs[i], "msgs_per_sec") << endl;
+        }
+    }
+    
+    // One feed to 1..16 subscribers on loopback: a single multicast send
+    // per message vs. one unicast send per subscriber. Reports per-subscriber
+    // one-way latency and the publisher's send cost per message.
+    void runUDPMulticastFanout() {
+        cout << "\n=== UDP Multicast Fan-out ===" << endl;
+        
+        const string group = "239.255.0.1";
+        const int mc_port = 5580, uc_port = 5590;
+        string count_str = to_string(count);
+        vector<pair<string, string>> rows;
+        for (int n : {1, 2, 4, 8, 16}) {
+            string subs = to_string(n);
+            vector<vector<string>> mc_subs, uc_subs;
+            for (int i = 0; i < n; ++i) {
+                mc_subs.push_back({"./udp_subscriber", to_string(mc_port), "--group=" + group,
+                                   "--interface=127.0.0.1"});
+                uc_subs.push_back({"./udp_subscriber", to_string(uc_port + i), "--oneway"});
+            }
+            rows.push_back({"multicast " + subs,
+                            runCapturedGroup(mc_subs, {"./udp_publisher", group, to_string(mc_port), count_str,
+                                                       "--fanout=" + subs, "--interface=127.0.0.1"})});
+            rows.push_back({"unicast   " + subs,
+                            runCapturedGroup(uc_subs, {"./udp_publisher", "127.0.0.1", to_string(uc_port),
+                                                       count_str, "--fanout=" + subs})});
+        }
+        
+        cout << "\nMode/Subs     send_ns/msg  pub_sys_ns/msg  avg_p50_us  worst_p99_us  min_received" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(14 - row.first.size(), ' ')
+                 << parseField(row.second, "send_ns_per_msg") << "  "
+                 << parseField(row.second, "pub_sys_ns_per_msg") << "  "
+                 << parseField(row.second, "avg_p50_one_way_us") << "  "
+                 << parseField(row.second, "worst_p99_one_way_us") << "  "
+                 << parseField(row.second, "min_received") << endl;
+        }
+    }
+    
+    // One port served by 1, 2 and 4 SO_REUSEPORT workers, each pinned to its
+    // own core; the publisher opens as many flows so the group can spread them
+    void runUDPReuseportScaling() {
+        cout << "\n=== UDP SO_REUSEPORT Worker Scaling ===" << endl;
+        
+        string stream_count = to_string(max(count, 100000));
+        vector<pair<string, string>> rows;
+        int port = 5600;
+        for (const string steer : {"hash", "cpu", "bpf"}) {
+            for (int n : {1, 2, 4}) {
+                if (n == 1 && steer != "hash") continue;
+                string p = to_string(port++);
+                string workers = to_string(n);
+                rows.push_back({workers + " " + steer,
+                                runCapturedPair({"./udp_subscriber", p, "--sink", "--batch=64",
+                                                 "--workers=" + workers, "--steer=" + steer},
+                                                {"./udp_publisher", "127.0.0.1", p, stream_count, "--stream",
+                                                 "--batch=64", "--flows=" + workers})});
+            }
+        }
+        
+        cout << "\nWorkers/Steer  recv_pps  sub_sys/msg  dropped  kernel_drops" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(15 - row.first.size(), ' ')
+                 << parseField(row.second, "recv_pps") << "  "
+                 << parseField(row.second, "sub_syscalls_per_msg") << "  "
+                 << parseField(row.second, "dropped") << "  "
+                 << parseField(row.second, "kernel_drops") << endl;
+        }
+    }
+    
+    // SO_TIMESTAMPING ping-pong on both sides, without and with busy polling:
+    // where the RTT goes between userspace and the kernel's stack
+    void runUDPTimestampBreakdown() {
+        cout << "\n=== UDP Kernel Timestamp Breakdown ===" << endl;
+        
+        string count_str = to_string(count);
+        vector<pair<string, string>> rows;
+        int port = 5610;
+        for (const string busy : {"0", "50"}) {
+            string p = to_string(port++);
+            rows.push_back({busy, runCapturedPair({"./udp_subscriber", p, "--timestamping", "--busy-poll=" + busy},
+                                                  {"./udp_publisher", "127.0.0.1", p, count_str, "--timestamping",
+                                                   "--busy-poll=" + busy})});
+        }
+        
+        cout << "\nBusy_us  p50_RTT_us  tx_stack_us  out_us  peer_wakeup_us  back_us  wakeup_us" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(9 - row.first.size(), ' ')
+                 << parseField(row.second, "median_RTT_us") << "  "
+                 << parseField(row.second, "tx_stack_us") << "  "
+                 << parseField(row.second, "out_us") << "  "
+                 << parseField(row.second, "peer_wakeup_us") << "  "
+                 << parseField(row.second, "back_us") << "  "
+                 << parseField(row.second, "wakeup_us") << endl;
+        }
+    }
+    
     void runSHMTest() {
         cout << "\n=== Shared Memory Latency Test ===" << endl;
         
@@ -103,6 +462,108 @@ public:
         cout << "SHM test completed" << endl;
     }
     
+    // Before/after comparison of the improved SHM ring: packed header (cursors
+    // on one cache line) vs. aligned header with cached remote cursors.
+    void runSHMLayoutComparison() {
+        cout << "\n=== Shared Memory Layout Comparison ===" << endl;
+        
+        string count_str = to_string(count);
+        vector<pair<string, string>> rows;
+        for (string layout : {"packed", "aligned"}) {
+            string shm_name = "test_shm_" + layout;
+            removeSegment(shm_name);
+            string layout_arg = "--layout=" + layout;
+            string out = runCapturedPair(
+                {"./shm_subscriber_improved", shm_name, layout_arg},
+                {"./shm_publisher_improved", shm_name, count_str, layout_arg},
+                /*publisher_first=*/true);
+            rows.push_back({layout, out});
+        }
+        
+        cout << "\nLayout    p50_RTT_us  p99_RTT_us" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(10 - row.first.size(), ' ')
+                 << parseField(row.second, "median_RTT_us") << "  "
+                 << parseField(row.second, "p99_RTT_us") << endl;
+        }
+    }
+    
+    // Streaming (no ping-pong) throughput of the improved SHM ring for batch
+    // sizes 1..256; the publisher prints one msgs/sec + GB/s line per size.
+    void runSHMStreamTest() {
+        cout << "\n=== Shared Memory Streaming Throughput ===" << endl;
+        
+        string shm_name = "test_shm_stream";
+        removeSegment(shm_name);
+        runCapturedPair({"./shm_subscriber_improved", shm_name},
+                        {"./shm_publisher_improved", shm_name, to_string(count), "--stream"},
+                        /*publisher_first=*/true);
+    }
+    
+    // Latency and CPU cost of each SHM wait strategy. Pings are paced so the
+    // subscriber is idle most of the time, which is where the strategies differ.
+    void runSHMWaitStrategyComparison() {
+        cout << "\n=== Shared Memory Wait Strategy Comparison ===" << endl;
+        
+        string count_str = to_string(min(count, 10000));
+        vector<pair<string, string>> rows;
+        for (string wait : {"spin", "yield", "backoff", "futex"}) {
+            string shm_name = "test_shm_wait_" + wait;
+            removeSegment(shm_name);
+            string wait_arg = "--wait=" + wait;
+            string out = runCapturedPair(
+                {"./shm_subscriber_improved", shm_name, wait_arg},
+                {"./shm_publisher_improved", shm_name, count_str, wait_arg, "--interval-us=100"},
+                /*publisher_first=*/true);
+            rows.push_back({wait, out});
+        }
+        
+        cout << "\nWait      p50_RTT_us  p99_RTT_us  pub_cpu_s  sub_cpu_s  wall_s" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(10 - row.first.size(), ' ')
+                 << parseField(row.second, "median_RTT_us") << "  "
+                 << parseField(row.second, "p99_RTT_us") << "  "
+                 << parseField(row.second, "pub_cpu_s") << "  "
+                 << parseField(row.second, "sub_cpu_s") << "  "
+                 << parseField(row.second, "wall_s") << endl;
+        }
+    }
+    
+    // Cold (first message) vs. steady-state latency for each segment backing.
+    // Without prefaulting the first message pays for the ring's page faults.
+    void runSHMSegmentComparison() {
+        cout << "\n=== Shared Memory Segment Backing Comparison ===" << endl;
+        
+        string count_str = to_string(count);
+        vector<pair<string, vector<string>>> configs = {
+            {"file", {"--backing=file"}},
+            {"shm", {"--backing=shm"}},
+            {"shm+prefault", {"--backing=shm", "--prefault"}},
+            {"memfd+prefault", {"--backing=memfd", "--prefault"}},
+            {"memfd+thp", {"--backing=memfd", "--huge=thp", "--prefault"}},
+        };
+        vector<pair<string, string>> rows;
+        for (const auto& config : configs) {
+            string shm_name = "test_shm_segment";
+            removeSegment(shm_name);
+            vector<string> sub_argv = {"./shm_subscriber_improved", shm_name};
+            vector<string> pub_argv = {"./shm_publisher_improved", shm_name, count_str};
+            sub_argv.insert(sub_argv.end(), config.second.begin(), config.second.end());
+            pub_argv.insert(pub_argv.end(), config.second.begin(), config.second.end());
+            string out = runCapturedPair(sub_argv, pub_argv, /*publisher_first=*/true);
+            rows.push_back({config.first, out});
+        }
+        removeSegment("test_shm_segment");
+        
+        cout << "\nBacking         first_RTT_us  p50_RTT_us  p99_RTT_us" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(16 - row.first.size(), ' ')
+                 << parseField(row.second, "first_RTT_us") << "  "
+                 << parseField(row.second, "median_RTT_us") << "  "
+                 << parseField(row.second, "p99_RTT_us") << endl;
+        }
+    }
+    
     void runZeroMQTest() {
         cout << "\n=== ZeroMQ Latency Test ===" << endl;
         
@@ -135,15 +596,482 @@ public:
         cout << "ZeroMQ test completed" << endl;
     }
     
+    // PUB/SUB fan-out: 16 topics to four subscribers with different prefix
+    // subscriptions plus one slow subscriber, sent directly or through an
+    // XSUB/XPUB proxy, with the default and a small HWM, and with the slow
+    // subscriber conflating. Drops show who pays for the slow consumer.
+    void runZeroMQPubSubTest() {
+        cout << "\n=== ZeroMQ PUB/SUB Fan-out ===" << endl;
+        
+        struct Scenario {
+            string name;
+            bool proxy;
+            string hwm;
+            vector<string> slow_args;
+        };
+        vector<Scenario> scenarios = {
+            {"direct hwm=1000", false, "1000", {"--slow-us=50"}},
+            {"direct hwm=100", false, "100", {"--slow-us=50", "--hwm=100"}},
+            {"direct conflate", false, "1000", {"--slow-us=50", "--conflate"}},
+            {"proxy hwm=100", true, "100", {"--slow-us=50", "--hwm=100"}},
+        };
+        vector<string> subscriptions = {"", "--subscribe=t00", "--subscribe=t01", "--subscribe=t003"};
+        string count_str = to_string(count);
+        vector<pair<string, string>> rows;
+        int port = 5620;
+        for (const auto& sc : scenarios) {
+            string data = to_string(port), report = to_string(port + 1);
+            string frontend = to_string(port + 2), backend = to_string(port + 3);
+            port += 4;
+            string sub_ep = "--connect=tcp://127.0.0.1:" + (sc.proxy ? backend : data);
+            string report_ep = "--report=tcp://127.0.0.1:" + report;
+            
+            vector<vector<string>> subs;
+            if (sc.proxy) {
+                subs.push_back({"./zmq_proxy", "--frontend=tcp://*:" + frontend, "--backend=tcp://*:" + backend,
+                                "--hwm=" + sc.hwm});
+            }
+            for (const string& subscription : subscriptions) {
+                subs.push_back({"./zmq_subscriber", "--pubsub", sub_ep, report_ep});
+                if (!subscription.empty()) subs.back().push_back(subscription);
+            }
+            subs.push_back({"./zmq_subscriber", "--pubsub", sub_ep, report_ep});
+            subs.back().insert(subs.back().end(), sc.slow_args.begin(), sc.slow_args.end());
+            
+            vector<string> pub_argv = {"./zmq_publisher", count_str, "--pubsub", "--subscribers=5", "--topics=16",
+                                       "--interval-us=10", "--hwm=" + sc.hwm, "--report=tcp://*:" + report};
+            pub_argv.push_back(sc.proxy ? "--connect=tcp://127.0.0.1:" + frontend : "--bind=tcp://*:" + data);
+            rows.push_back({sc.name, runCapturedGroup(subs, pub_argv)});
+        }
+        
+        cout << "\nScenario          sent_pps  avg_recv_pps  avg_p50_us  worst_p99_us  total_drops  max_drops" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(18 - row.first.size(), ' ')
+                 << parseField(row.second, "sent_pps") << "  "
+                 << parseField(row.second, "avg_recv_pps") << "  "
+                 << parseField(row.second, "avg_p50_one_way_us") << "  "
+                 << parseField(row.second, "worst_p99_one_way_us") << "  "
+                 << parseField(row.second, "total_drops") << "  "
+                 << parseField(row.second, "max_drops") << endl;
+        }
+    }
+    
+    // REQ-REP ping-pong from 8 B to 1 MiB over inproc (two threads in the
+    // publisher), ipc and tcp, copying vs. sending pooled buffers zero-copy,
+    // and tcp with a second I/O thread; then the cheapest config per size.
+    void runZeroMQTransportSweep() {
+        cout << "\n=== ZeroMQ Transport/Payload Sweep ===" << endl;
+        
+        struct Config {
+            string name;
+            string transport;
+            vector<string> args;
+        };
+        vector<Config> configs = {
+            {"inproc copy", "inproc", {}},
+            {"inproc zero-copy", "inproc", {"--zero-copy"}},
+            {"ipc copy", "ipc", {}},
+            {"ipc zero-copy", "ipc", {"--zero-copy"}},
+            {"tcp copy", "tcp", {}},
+            {"tcp zero-copy", "tcp", {"--zero-copy"}},
+            {"tcp zero-copy io=2", "tcp", {"--zero-copy", "--io-threads=2"}},
+        };
+        vector<int> payloads = {8, 256, 4096, 65536, 1048576};
+        string ipc_path = "/tmp/latency_test_zmq.ipc";
+        
+        struct Row {
+            int payload;
+            string config;
+            double avg, p99, rate;
+        };
+        vector<Row> rows;
+        int port = 5640;
+        for (int payload : payloads) {
+            // Same bytes moved per size, at least 100 round trips
+            string count_str = to_string(max(100, min(count, (int)(count * 4096LL / payload))));
+            for (const auto& cfg : configs) {
+                string pub_ep, sub_ep;
+                if (cfg.transport == "inproc") {
+                    pub_ep = "inproc://sweep";
+                } else if (cfg.transport == "ipc") {
+                    pub_ep = sub_ep = "ipc://" + ipc_path;
+                } else {
+                    pub_ep = "tcp://127.0.0.1:" + to_string(port);
+                    sub_ep = "tcp://*:" + to_string(port);
+                    ++port;
+                }
+                vector<vector<string>> subs;
+                if (!sub_ep.empty()) {
+                    subs.push_back({"./zmq_subscriber", "--endpoint=" + sub_ep});
+                    subs.back().insert(subs.back().end(), cfg.args.begin(), cfg.args.end());
+                }
+                vector<string> pub_argv = {"./zmq_publisher", count_str, "--payload=" + to_string(payload),
+                                           "--endpoint=" + pub_ep};
+                pub_argv.insert(pub_argv.end(), cfg.args.begin(), cfg.args.end());
+                string out = runCapturedGroup(subs, pub_argv);
+                unlink(ipc_path.c_str());
+                rows.push_back({payload, cfg.name, parseField(out, "avg_RTT_us"), parseField(out, "p99_RTT_us"),
+                                parseField(out, "msgs_per_sec")});
+            }
+        }
+        
+        cout << "\nPayload  Config              avg_RTT_us  p99_RTT_us  msgs_per_sec" << endl;
+        for (const auto& row : rows) {
+            string payload = to_string(row.payload);
+            cout << payload << string(9 - payload.size(), ' ')
+                 << row.config << string(20 - row.config.size(), ' ')
+                 << row.avg << "  " << row.p99 << "  " << row.rate << endl;
+        }
+        cout << "\nCheapest config per payload (lowest avg RTT):" << endl;
+        for (int payload : payloads) {
+            const Row* best = nullptr;
+            for (const auto& row : rows) {
+                if (row.payload != payload || row.avg < 0) continue;
+                if (!best || row.avg < best->avg) best = &row;
+            }
+            if (best) cout << "  " << payload << " B: " << best->config << " (" << best->avg << " us)" << endl;
+        }
+    }
+    
+    // DEALER-ROUTER with 1-1024 requests in flight over tcp: the
+    // throughput a window buys and what it costs in p50/p99/p99.9 RTT.
+    void runZeroMQWindowSweep() {
+        cout << "\n=== ZeroMQ DEALER/ROUTER Window Sweep ===" << endl;
+        
+        vector<int> windows = {1, 4, 16, 64, 256, 1024};
+        string count_str = to_string(count);
+        vector<pair<int, string>> rows;
+        int port = 5660;
+        for (int window : windows) {
+            string ep = to_string(port++);
+            rows.push_back({window, runCapturedPair({"./zmq_subscriber", "--router", "--endpoint=tcp://*:" + ep},
+                                                    {"./zmq_publisher", count_str, "--window=" + to_string(window),
+                                                     "--endpoint=tcp://127.0.0.1:" + ep})});
+        }
+        
+        cout << "\nWindow  msgs_per_sec  p50_RTT_us  p99_RTT_us  p999_RTT_us" << endl;
+        for (const auto& row : rows) {
+            string window = to_string(row.first);
+            cout << window << string(8 - window.size(), ' ')
+                 << parseField(row.second, "msgs_per_sec") << "  "
+                 << parseField(row.second, "p50_RTT_us") << "  "
+                 << parseField(row.second, "p99_RTT_us") << "  "
+                 << parseField(row.second, "p999_RTT_us") << endl;
+        }
+    }
+    
+    // The same ping-pong driver, message, clock and statistics (common/) over
+    // each transport via pubsub_bench, with the harness's warmup, so the three
+    // rows differ only in the transport. Each run's full RTT distribution is
+    // kept as latency_test_<transport>.hgrm for plotting, and the clock's own
+    // read cost is printed below the table.
+    void runTransportComparison() {
+        cout << "\n=== Common Driver Transport Comparison ===" << endl;
+        
+        vector<pair<string, string>> rows;
+        for (const auto& t : benchTransports(5680, "latency_test_bench")) {
+            rows.push_back({t.name, runBenchPair(t, {"--hgrm=latency_test_" + t.name + ".hgrm"})});
+        }
+        removeSegment("latency_test_bench");
+        
+        cout << "\nTransport  avg_RTT_us  median_RTT_us  p99_RTT_us  p999_RTT_us  p9999_RTT_us  max_RTT_us" << endl;
+        for (const auto& row : rows) {
+            cout << row.first << string(11 - row.first.size(), ' ')
+                 << parseField(row.second, "avg_RTT_us") << "  "
+                 << parseField(row.second, "median_RTT_us") << "  "
+                 << parseField(row.second, "p99_RTT_us") << "  "
+                 << parseField(row.second, "p999_RTT_us") << "  "
+                 << parseField(row.second, "p9999_RTT_us") << "  "
+                 << parseField(row.second, "max_RTT_us") << endl;
+        }
+        if (!rows.empty()) {
+            const string& out = rows.front().second;
+            cout << "Clock: " << (out.find("clock=tsc") != string::npos ? "TSC" : "CLOCK_MONOTONIC_RAW")
+                 << ", now_ns() " << parseField(out, "now_ns_cost_ns") << " ns/read, clock_gettime() "
+                 << parseField(out, "clock_gettime_cost_ns") << " ns/read" << endl;
+        }
+        cout << "Percentile distributions: latency_test_{udp,shm,zmq}.hgrm" << endl;
+    }
+    
+    // Open-loop pubsub_bench --rate over each transport: latency is taken from
+    // each message's scheduled send time, so once a transport falls behind
+    // the queueing shows up instead of being hidden by a closed loop. A rate
+    // is marked saturated when the achieved rate drops below 95% of it or the
+    // median more than quadruples from the lowest rate; the last rate before
+    // that is the transport's knee.
+    void runOpenLoopSweep() {
+        cout << "\n=== Open-Loop Rate Sweep ===" << endl;
+        
+        vector<string> rates = {"10000", "20000", "50000", "100000", "200000", "500000", "1000000"};
+        
+        cout << "\nTransport  rate     achieved  median_us  p99_us  p999_us  lost  saturated" << endl;
+        for (const auto& t : benchTransports(5682, "latency_test_open")) {
+            double base_median = -1;
+            string knee = "none";
+            bool saturated_seen = false;
+            for (const string& rate : rates) {
+                string out = runBenchPair(t, {"--rate=" + rate});
+                double achieved = parseField(out, "achieved_rate");
+                double median = parseField(out, "median_RTT_us");
+                if (base_median < 0) base_median = median;
+                bool saturated = achieved < 0.95 * stod(rate) || median > 4 * base_median;
+                if (!saturated && !saturated_seen) knee = rate;
+                saturated_seen = saturated_seen || saturated;
+                cout << t.name << string(11 - t.name.size(), ' ')
+                     << rate << string(9 - rate.size(), ' ')
+                     << achieved << "  "
+                     << median << "  "
+                     << parseField(out, "p99_RTT_us") << "  "
+                     << parseField(out, "p999_RTT_us") << "  "
+                     << parseField(out, "lost") << "  "
+                     << (saturated ? "yes" : "no") << endl;
+            }
+            cout << t.name << " knee: " << knee << " msg/s" << endl;
+        }
+        removeSegment("latency_test_open");
+    }
+    
+    // topic_bench over the shared-memory topic registry: one publisher on
+    // 1, 16 and 256 topics, round robin, and a subscriber started first on
+    // either one exact name or a wildcard covering them all. The subscriber
+    // learns every topic from the registry as the publisher registers it.
+    // It should see each of its messages once: the expected count, none
+    // lost. Also reports what resolving a publisher handle costs and what a
+    // publish() through one costs.
+    void runTopicRoutingTest() {
+        cout << "\n=== Topic Registry Routing ===" << endl;
+        
+        const string registry = "latency_test_topics";
+        const string results_file = "latency_test_topics.bin";
+        const string rate = "20000";
+        vector<vector<string>> rows;
+        for (int topics : {1, 16, 256}) {
+            for (bool wildcard : {false, true}) {
+                pubsub::remove_topic_registry(registry);
+                unlink(results_file.c_str());
+                string pattern = wildcard ? "bench.*" : "bench.0";
+                uint64_t expected = wildcard ? count : (count + topics - 1) / topics;
+                string out = runCapturedPair({"./topic_bench", "sub", pattern, "--count=" + to_string(expected),
+                                              "--results=" + results_file, "--registry=" + registry},
+                                             {"./topic_bench", "pub", "bench.", to_string(topics), to_string(count),
+                                              "--rate=" + rate, "--registry=" + registry});
+                pubsub::Histogram h;
+                readHistogram(results_file, h);
+                pubsub::LatencySummary s = pubsub::summarize(h);
+                ostringstream p50, p99, resolve, publish;
+                p50 << s.p50_us;
+                p99 << s.p99_us;
+                resolve << parseField(out, "resolve_us");
+                publish << parseField(out, "publish_ns");
+                rows.push_back({to_string(topics), pattern, to_string(expected), to_string(h.count()),
+                                to_string(expected - min<uint64_t>(h.count(), expected)), p50.str(), p99.str(),
+                                resolve.str(), publish.str()});
+            }
+        }
+        pubsub::remove_topic_registry(registry);
+        unlink(results_file.c_str());
+        
+        cout << "\nTopics  Subscription  expected  received  lost  p50_one_way_us  p99_one_way_us  resolve_us  publish_ns"
+             << endl;
+        for (const auto& row : rows) {
+            cout << row[0] << string(8 - row[0].size(), ' ')
+                 << row[1] << string(14 - row[1].size(), ' ')
+                 << row[2] << "  " << row[3] << "  " << row[4] << "  " << row[5] << "  " << row[6] << "  "
+                 << row[7] << "  " << row[8] << endl;
+        }
+    }
+    
+    // pubsub_bench at 64 B-65000 B of payload over each transport, plus SHM
+    // copying with non-temporal stores. Payloads come from a pre-generated
+    // pool, the subscriber checksums each one and the publisher validates
+    // every echo, so a size only counts if bad_payloads is 0. Reports the
+    // first size at which SHM's median is no better than UDP loopback's,
+    // and the sizes at which non-temporal stores beat a plain copy.
+    void runPayloadSweep() {
+        cout << "\n=== Payload Size Sweep ===" << endl;
+        
+        vector<Transport> transports = benchTransports(5688, "latency_test_payload");
+        Transport shm_nt = transports[1];
+        shm_nt.label = "shm+nt";
+        shm_nt.extra = {"--nt-stores"};
+        transports.insert(transports.begin() + 2, shm_nt);
+        vector<int> sizes = {64, 256, 1024, 4096, 16384, 65000};
+        map<pair<string, int>, double> medians;
+        vector<vector<string>> rows;
+        for (int size : sizes) {
+            for (const auto& t : transports) {
+                string out = runBenchPair(t, {"--payload=" + to_string(size)});
+                medians[{t.label, size}] = parseField(out, "median_RTT_us");
+                ostringstream p50, p99, mbps, bad;
+                p50 << parseField(out, "median_RTT_us");
+                p99 << parseField(out, "p99_RTT_us");
+                mbps << parseField(out, "payload_MB_per_s");
+                bad << parseField(out, "bad_payloads");
+                rows.push_back({to_string(size), t.label, p50.str(), p99.str(), mbps.str(), bad.str()});
+            }
+        }
+        removeSegment("latency_test_payload");
+        
+        cout << "\nPayload  Transport  p50_RTT_us  p99_RTT_us  MB_per_s  bad" << endl;
+        for (const auto& row : rows) {
+            cout << row[0] << string(9 - row[0].size(), ' ')
+                 << row[1] << string(11 - row[1].size(), ' ')
+                 << row[2] << "  " << row[3] << "  " << row[4] << "  " << row[5] << endl;
+        }
+        
+        int crossover = -1;
+        bool shm_ahead_seen = false;
+        for (int size : sizes) {
+            double shm = medians[{"shm", size}], udp = medians[{"udp", size}];
+            if (shm < 0 || udp < 0) continue;
+            if (shm < udp) shm_ahead_seen = true;
+            else if (crossover < 0) crossover = size;
+        }
+        if (!shm_ahead_seen) cout << "SHM vs. UDP: SHM is no faster than UDP at any size on this machine" << endl;
+        else if (crossover < 0) cout << "SHM vs. UDP: SHM is faster at every size up to " << sizes.back() << " B" << endl;
+        else cout << "SHM vs. UDP: SHM stops beating UDP at " << crossover << " B" << endl;
+        
+        string nt_wins;
+        for (int size : sizes) {
+            double nt = medians[{"shm+nt", size}], plain = medians[{"shm", size}];
+            if (nt >= 0 && plain >= 0 && nt < plain) nt_wins += (nt_wins.empty() ? "" : ", ") + to_string(size);
+        }
+        cout << "Non-temporal stores faster than memcpy at: " << (nt_wins.empty() ? "no size" : nt_wins + " B") << endl;
+    }
+    
+    // pubsub_bench over each transport with the publisher and subscriber
+    // pinned at every distance this machine offers (same CPU, SMT siblings,
+    // shared L3, across L3s, across sockets), both SCHED_FIFO and mlockall()ed
+    // where permitted, and the SHM segment bound to the subscriber's NUMA
+    // node. Unpinned runs can land anywhere, which is how the same binary
+    // swings 5x between runs on a dual-socket host.
+    void runPlacementSweep() {
+        cout << "\n=== CPU Placement Sweep ===" << endl;
+        
+        pubsub::Topology topo = pubsub::discover_topology();
+        cout << "Topology:";
+        pubsub::print_topology_fields(cout, topo);
+        cout << endl;
+        vector<pubsub::Placement> places = pubsub::placements(topo);
+        
+        vector<Transport> transports = benchTransports(5686, "latency_test_place");
+        vector<pair<const pubsub::Placement*, pair<string, string>>> rows;
+        for (const auto& place : places) {
+            for (Transport t : transports) {
+                t.extra = {"--fifo", "--mlock"};
+                vector<string> pub_args = {"--cpu=" + to_string(place.pub_cpu)};
+                if (t.name == "shm") {
+                    pub_args.push_back("--numa-node=" + to_string(pubsub::find_cpu(topo, place.sub_cpu)->node));
+                }
+                rows.push_back({&place, {t.name, runBenchPair(t, pub_args, {"--cpu=" + to_string(place.sub_cpu)})}});
+            }
+        }
+        removeSegment("latency_test_place");
+        
+        cout << "\nDistance      pub/sub  Transport  p50_RTT_us  p99_RTT_us  p999_RTT_us  fifo" << endl;
+        for (const auto& row : rows) {
+            string name = pubsub::distance_name(row.first->distance);
+            string cpus = to_string(row.first->pub_cpu) + "/" + to_string(row.first->sub_cpu);
+            const string& out = row.second.second;
+            cout << name << string(14 - name.size(), ' ')
+                 << cpus << string(9 - min<size_t>(cpus.size(), 8), ' ')
+                 << row.second.first << string(11 - row.second.first.size(), ' ')
+                 << parseField(out, "median_RTT_us") << "  "
+                 << parseField(out, "p99_RTT_us") << "  "
+                 << parseField(out, "p999_RTT_us") << "  "
+                 << (out.find("fifo=yes") != string::npos ? "yes" : "no") << endl;
+        }
+        for (pubsub::Distance d : {pubsub::Distance::SmtSibling, pubsub::Distance::SameL3,
+                                   pubsub::Distance::CrossL3, pubsub::Distance::CrossSocket}) {
+            bool found = any_of(places.begin(), places.end(), [d](const pubsub::Placement& p) { return p.distance == d; });
+            if (!found) cout << pubsub::distance_name(d) << ": not available on this machine" << endl;
+        }
+    }
+    
+    // The numbers the CSV/JSON reports and the nightly baseline check rest
+    // on. Each transport and payload size runs `repeats` times through
+    // pubsub_bench, which drops the harness's warmup round trips and writes
+    // its raw RTT histogram to a results file. Those histograms are merged
+    // for the distribution, and each run's median and p99 give a 95%
+    // confidence interval for the run-to-run spread.
+    void runRegressionSuite() {
+        cout << "\n=== Regression Suite (" << repeats << " runs per configuration) ===" << endl;
+        
+        vector<int> payloads = {0, 64, 256, 1024, 4096};
+        const string results_file = "latency_test_run.bin";
+        results.clear();
+        for (const auto& t : benchTransports(5684, "latency_test_regress")) {
+            for (int payload : payloads) {
+                LatencyStats stats;
+                stats.transport = t.name;
+                stats.payload = payload;
+                for (int run = 0; run < repeats; ++run) {
+                    unlink(results_file.c_str());
+                    string out = runBenchPair(t, {"--payload=" + to_string(payload), "--results=" + results_file});
+                    pubsub::Histogram h;
+                    if (!readHistogram(results_file, h)) {
+                        cerr << t.name << " payload=" << payload << " run " << run << ": no results" << endl;
+                        continue;
+                    }
+                    pubsub::LatencySummary s = pubsub::summarize(h);
+                    stats.run_avg_us.push_back(s.avg_us);
+                    stats.run_p50_us.push_back(s.p50_us);
+                    stats.run_p99_us.push_back(s.p99_us);
+                    stats.lost += max(parseField(out, "lost"), 0.0);
+                    stats.merged.add(h);
+                }
+                results.push_back(move(stats));
+            }
+        }
+        unlink(results_file.c_str());
+        removeSegment("latency_test_regress");
+        
+        cout << "\nTransport  Payload  runs  p50_us (95% CI)  p99_us (95% CI)  p999_us  p9999_us  max_us  lost" << endl;
+        for (const auto& r : results) {
+            string payload = to_string(r.payload);
+            Interval p50 = confidenceInterval(r.run_p50_us), p99 = confidenceInterval(r.run_p99_us);
+            pubsub::LatencySummary merged = pubsub::summarize(r.merged);
+            cout << r.transport << string(11 - r.transport.size(), ' ')
+                 << payload << string(9 - payload.size(), ' ')
+                 << r.run_p50_us.size() << "  "
+                 << p50.mean << " +/- " << p50.ci95 << "  "
+                 << p99.mean << " +/- " << p99.ci95 << "  "
+                 << merged.p999_us << "  "
+                 << merged.p9999_us << "  "
+                 << merged.max_us << "  "
+                 << r.lost << endl;
+        }
+    }
+    
     void runAllTests() {
         cout << "Starting latency comparison test..." << endl;
         cout << "Message count: " << count << endl;
         cout << "Warmup count: " << warmup << endl;
+        cout << "Repeats: " << repeats << endl;
         
         // Run all tests
         runUDPTest();
+        runUDPStreamTest();
+        runUDPIoComparison();
+        runUDPReliabilityTest();
+        runUDPMulticastFanout();
+        runUDPReuseportScaling();
+        runUDPTimestampBreakdown();
         runSHMTest();
+        runSHMLayoutComparison();
+        runSHMStreamTest();
+        runSHMWaitStrategyComparison();
+        runSHMSegmentComparison();
         runZeroMQTest();
+        runZeroMQPubSubTest();
+        runZeroMQTransportSweep();
+        runZeroMQWindowSweep();
+        runTransportComparison();
+        runOpenLoopSweep();
+        runPayloadSweep();
+        runTopicRoutingTest();
+        runPlacementSweep();
+        runRegressionSuite();
         
         cout << "\n=== Test Summary ===" << endl;
         cout << "All tests completed. Check individual outputs above for detailed results." << endl;
@@ -153,30 +1081,151 @@ public:
         cout << "3. ZeroMQ - tens to hundreds of microseconds" << endl;
     }
     
+    bool hasResults() const { return !results.empty(); }
+    
+    // One row per regression-suite configuration: the merged distribution's
+    // percentiles, then the mean and 95% CI half-width of the per-run median
+    // and p99 (what compareBaseline() reads back)
     void generateCSV() {
         ofstream csv("latency_results.csv");
-        csv << "Implementation,Message_Count,Avg_RTT_us,Median_RTT_us,P95_RTT_us,P99_RTT_us,Min_RTT_us,Max_RTT_us\n";
+        csv << "Transport,Payload_B,Runs,Message_Count,Avg_RTT_us,Median_RTT_us,P90_RTT_us,P99_RTT_us,"
+               "P999_RTT_us,P9999_RTT_us,Min_RTT_us,Max_RTT_us,Run_Median_Mean_us,Run_Median_CI95_us,"
+               "Run_P99_Mean_us,Run_P99_CI95_us,Lost\n";
         
         for (const auto& result : results) {
-            csv << result.name << "," << result.rtts.size() << ","
-                << result.avg << "," << result.median << "," << result.p95 << ","
-                << result.p99 << "," << result.min << "," << result.max << "\n";
+            pubsub::LatencySummary s = pubsub::summarize(result.merged);
+            Interval p50 = confidenceInterval(result.run_p50_us), p99 = confidenceInterval(result.run_p99_us);
+            csv << result.transport << "," << result.payload << "," << result.run_p50_us.size() << ","
+                << s.count << "," << s.avg_us << "," << s.p50_us << "," << s.p90_us << ","
+                << s.p99_us << "," << s.p999_us << "," << s.p9999_us << "," << s.min_us << ","
+                << s.max_us << "," << p50.mean << "," << p50.ci95 << "," << p99.mean << ","
+                << p99.ci95 << "," << result.lost << "\n";
         }
         
         csv.close();
         cout << "Results saved to latency_results.csv" << endl;
     }
+    
+    // The same results with every run's figures and the merged histogram's
+    // full percentile distribution (the .hgrm ticks), for plotting and for
+    // tools that want more than the CSV's summary
+    void generateJSON() {
+        ofstream json("latency_results.json");
+        auto list = [&json](const vector<double>& v) {
+            json << "[";
+            for (size_t i = 0; i < v.size(); ++i) json << (i ? ", " : "") << v[i];
+            json << "]";
+        };
+        json << "{\n  \"count\": " << count << ",\n  \"warmup\": " << warmup
+             << ",\n  \"repeats\": " << repeats << ",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const LatencyStats& r = results[i];
+            pubsub::LatencySummary s = pubsub::summarize(r.merged);
+            Interval p50 = confidenceInterval(r.run_p50_us), p99 = confidenceInterval(r.run_p99_us);
+            json << (i ? "," : "") << "\n    {\"transport\": \"" << r.transport << "\", \"payload_bytes\": " << r.payload
+                 << ", \"runs\": " << r.run_p50_us.size() << ", \"lost\": " << r.lost
+                 << ",\n     \"rtt_us\": {\"count\": " << s.count << ", \"avg\": " << s.avg_us
+                 << ", \"min\": " << s.min_us << ", \"p50\": " << s.p50_us << ", \"p90\": " << s.p90_us
+                 << ", \"p99\": " << s.p99_us << ", \"p999\": " << s.p999_us << ", \"p9999\": " << s.p9999_us
+                 << ", \"max\": " << s.max_us << "}"
+                 << ",\n     \"run_median_us\": {\"mean\": " << p50.mean << ", \"ci95\": " << p50.ci95
+                 << ", \"runs\": ";
+            list(r.run_p50_us);
+            json << "},\n     \"run_p99_us\": {\"mean\": " << p99.mean << ", \"ci95\": " << p99.ci95
+                 << ", \"runs\": ";
+            list(r.run_p99_us);
+            json << "},\n     \"run_avg_us\": ";
+            list(r.run_avg_us);
+            json << ",\n     \"distribution\": [";
+            bool first = true;
+            r.merged.for_each_percentile([&](double percentile, uint64_t value, uint64_t cumulative) {
+                json << (first ? "" : ", ") << "{\"percentile\": " << percentile << ", \"value_us\": "
+                     << value / 1000.0 << ", \"count\": " << cumulative << "}";
+                first = false;
+            });
+            json << "]}";
+        }
+        json << "\n  ]\n}\n";
+        json.close();
+        cout << "Results saved to latency_results.json" << endl;
+    }
+    
+    // Compares this run with a latency_results.csv from an earlier one. A
+    // configuration regressed when its per-run median or p99 interval lies
+    // entirely above the baseline's, so run-to-run noise alone doesn't
+    // trip it. Returns the number of regressions.
+    int compareBaseline(const string& path) {
+        ifstream in(path);
+        if (!in) {
+            cerr << "Could not read baseline " << path << endl;
+            return 1;
+        }
+        cout << "\n=== Baseline Comparison (" << path << ") ===" << endl;
+        string line;
+        getline(in, line); // Header
+        int regressions = 0;
+        while (getline(in, line)) {
+            vector<string> cols;
+            stringstream row(line);
+            for (string col; getline(row, col, ',');) cols.push_back(col);
+            if (cols.size() < 17) continue;
+            for (const auto& r : results) {
+                if (r.transport != cols[0] || to_string(r.payload) != cols[1]) continue;
+                Interval base_p50{stod(cols[12]), stod(cols[13])}, base_p99{stod(cols[14]), stod(cols[15])};
+                Interval p50 = confidenceInterval(r.run_p50_us), p99 = confidenceInterval(r.run_p99_us);
+                for (const auto& m : {make_pair("median", make_pair(p50, base_p50)),
+                                      make_pair("p99", make_pair(p99, base_p99))}) {
+                    const Interval& now = m.second.first;
+                    const Interval& base = m.second.second;
+                    bool regressed = now.mean - now.ci95 > base.mean + base.ci95;
+                    regressions += regressed;
+                    cout << (regressed ? "REGRESSION " : "ok         ") << r.transport << " payload=" << r.payload
+                         << " " << m.first << "_us " << base.mean << " -> " << now.mean << endl;
+                }
+            }
+        }
+        cout << regressions << " regression(s)" << endl;
+        return regressions;
+    }
 };
 
 void printUsage(const char* prog) {
-    cout << "Usage: " << prog << " [count] [warmup]" << endl;
+    cout << "Usage: " << prog << " [count] [warmup] [repeats] [--regression] [--baseline=FILE]" << endl;
     cout << "  count:   Number of messages to send (default: 10000)" << endl;
     cout << "  warmup:  Number of warmup messages (default: 1000)" << endl;
+    cout << "  repeats: Runs per configuration in the regression suite (default: 5)" << endl;
+    cout << "  --regression:    Run only the regression suite" << endl;
+    cout << "  --baseline=FILE: Compare with an earlier latency_results.csv; exits 1 on a regression" << endl;
     cout << endl;
     cout << "This test harness runs all three latency implementations:" << endl;
     cout << "1. UDP ping-pong" << endl;
-    cout << "2. Shared Memory (SHM) ping-pong" << endl;
-    cout << "3. ZeroMQ REQ-REP ping-pong" << endl;
+    cout << "   - one-way streaming with sendmmsg/recvmmsg and GSO/GRO" << endl;
+    cout << "   - blocking sockets vs. io_uring, with and without SQPOLL" << endl;
+    cout << "   - NACK/timeout recovery latency under injected loss and reordering" << endl;
+    cout << "   - multicast vs. unicast fan-out to 1-16 subscribers" << endl;
+    cout << "   - receive scaling over 1-4 pinned SO_REUSEPORT workers on one port" << endl;
+    cout << "   - SO_TIMESTAMPING RTT breakdown with and without busy polling" << endl;
+    cout << "2. Shared Memory (SHM) ping-pong, plus packed vs. aligned ring layout" << endl;
+    cout << "   batched streaming throughput, wait strategy latency/CPU, and" << endl;
+    cout << "   first-message vs. steady-state latency per segment backing" << endl;
+    cout << "3. ZeroMQ REQ-REP ping-pong, plus PUB/SUB topic fan-out (direct and via an" << endl;
+    cout << "   XSUB/XPUB proxy) with HWM and conflate under a slow subscriber, and an" << endl;
+    cout << "   8 B-1 MiB payload sweep over inproc/ipc/tcp, copy vs. zero-copy, and" << endl;
+    cout << "   DEALER/ROUTER throughput vs. latency for 1-1024 requests in flight" << endl;
+    cout << "4. pubsub_bench: one shared ping-pong driver over UDP, SHM and ZeroMQ" << endl;
+    cout << "   - each RTT histogram written out as an .hgrm percentile distribution" << endl;
+    cout << "   - the cost of the TSC clock next to clock_gettime()" << endl;
+    cout << "   - open-loop 10k-1M msg/s rate sweep to find each transport's knee" << endl;
+    cout << "   - checksummed 64 B-65000 B payload sweep: latency and MB/s per size," << endl;
+    cout << "     where SHM stops beating UDP, and SHM with non-temporal stores" << endl;
+    cout << "   - topic routing through the shared-memory topic registry: 1-256 topics," << endl;
+    cout << "     exact and wildcard subscriptions" << endl;
+    cout << "5. Placement sweep: each transport with publisher and subscriber pinned on" << endl;
+    cout << "   one CPU, SMT siblings, a shared L3, separate L3s and separate sockets" << endl;
+    cout << "   (where the machine has them), SCHED_FIFO, mlockall and NUMA-bound SHM" << endl;
+    cout << "6. Regression suite: pubsub_bench over each transport for 0 B-4 KiB payloads," << endl;
+    cout << "   repeated with 95% confidence intervals, written to latency_results.csv and" << endl;
+    cout << "   latency_results.json with full percentile distributions" << endl;
     cout << endl;
     cout << "Make sure all executables are built and in the current directory." << endl;
 }
@@ -184,24 +1233,44 @@ void printUsage(const char* prog) {
 int main(int argc, char* argv[]) {
     int count = 10000;
     int warmup = 1000;
+    int repeats = 5;
+    bool regression_only = false;
+    string baseline;
     
-    if (argc > 1) {
-        count = stoi(argv[1]);
+    vector<string> positional;
+    for (int a = 1; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "-h" || arg == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        if (arg == "--regression") regression_only = true;
+        else if (arg.rfind("--baseline=", 0) == 0) baseline = arg.substr(11);
+        else positional.push_back(arg);
     }
-    if (argc > 2) {
-        warmup = stoi(argv[2]);
+    if (positional.size() > 0) {
+        count = stoi(positional[0]);
     }
-    
-    if (argc > 1 && (string(argv[1]) == "-h" || string(argv[1]) == "--help")) {
-        printUsage(argv[0]);
-        return 0;
+    if (positional.size() > 1) {
+        warmup = stoi(positional[1]);
+    }
+    if (positional.size() > 2) {
+        repeats = max(stoi(positional[2]), 1);
     }
     
     cout << "Latency Test Harness" << endl;
     cout << "===================" << endl;
     
-    LatencyTest test(count, warmup);
-    test.runAllTests();
+    LatencyTest test(count, warmup, repeats);
+    if (regression_only) {
+        test.runRegressionSuite();
+    } else {
+        test.runAllTests();
+    }
+    if (!test.hasResults()) return 1;
+    test.generateCSV();
+    test.generateJSON();
+    if (!baseline.empty() && test.compareBaseline(baseline) > 0) return 1;
     
     return 0;
 }
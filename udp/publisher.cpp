@@ -1,34 +1,783 @@
-// Usage: ./publisher <subscriber_ip> <subscriber_port> <count>
+// Usage: ./publisher <subscriber_ip> <subscriber_port> <count> [--stream] [--batch=N] [--gso]
+//                    [--io=blocking|uring] [--sqpoll]
 // sends timestamped ping messages, waits for pong and measures RTT.
+//
+// --stream   one-way throughput instead of ping-pong: send <count> messages as
+//            fast as possible, then an END marker; the subscriber (run with
+//            --sink) replies with what it received. Reports packets/sec,
+//            syscalls/message on both sides and drop counts.
+// --batch=N  datagrams per sendmmsg() call in --stream mode
+// --gso      send each batch as UDP_SEGMENT super-datagrams of up to
+//            MAX_GSO_SEGMENTS same-sized messages (Linux)
+// --flows=N  split the stream over N sockets/threads, i.e. N source ports, so
+//            a --workers subscriber's SO_REUSEPORT group can spread it
+//            (seq_gaps then counts interleaving between flows, not loss)
+// --io=uring io_uring engine (see uring.hpp): sends are WRITE_FIXED from a
+//            registered buffer on a registered socket, replies arrive through
+//            a multishot recv into a provided buffer ring. In --stream mode
+//            each batch is one io_uring_enter() that submits and reaps it.
+// --sqpoll   with --io=uring, let a kernel thread poll the submission queue
+//            and spin on the completion queue: no syscalls in steady state
+// --reliable ping-pong with recovery (see reliable.hpp): up to --window=N
+//            messages in flight, resent on a Nack or after --rto-us=N without
+//            an echo. Needs the subscriber in --reliable mode as well.
+// --loss=P / --reorder=P  with --reliable, drop / reorder P% of our sends
+//            (--seed=N varies the pattern)
+// --fanout=N one-way fan-out to N subscribers (run with --oneway or
+//            --group): if <subscriber_ip> is a multicast group each message is
+//            sent once, otherwise once per subscriber on ports port..port+N-1.
+//            Messages go out every --interval-us=N; at the end every
+//            subscriber reports its one-way latency. Multicast options:
+//            --ttl=N, --no-loop and --interface=<local ip>.
+// --busy-poll=US  SO_BUSY_POLL/SO_PREFER_BUSY_POLL: spin up to US µs in the
+//            kernel on receive instead of sleeping (NAPI devices only)
+// --timestamping  ping-pong with SO_TIMESTAMPING (see timestamping.hpp):
+//            break each RTT into user -> kernel TX -> peer kernel RX -> peer
+//            user -> kernel RX -> user. --hw-timestamps=IFACE also enables
+//            NIC stamping on IFACE and reports the hardware RTT.
+//
+// Plain ping-pong gives up on a message after PING_TIMEOUT_MS and reports it
+// as lost rather than blocking forever.
 
 #include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/select.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <cstring>
 #include <iostream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "../common/clock.hpp"
+#include "../common/message.hpp"
+#include "../common/stats.hpp"
+#include "reliable.hpp"
+#include "timestamping.hpp"
+#include "uring.hpp"
+
 using namespace std;
-using ns = chrono::nanoseconds;
-using clk = chrono::high_resolution_clock;
+using pubsub::clk;
+using pubsub::Msg;
+using pubsub::now_ns;
+
+constexpr uint64_t END_SEQ = UINT64_MAX; // Marks the end of a stream; the report reuses it
+constexpr size_t MAX_GSO_SEGMENTS = 64;  // Kernel limit per UDP_SEGMENT send (UDP_MAX_SEGMENTS)
+constexpr int REPORT_TIMEOUT_MS = 200;   // Wait per END marker before resending it
+constexpr int REPORT_RETRIES = 25;
+constexpr size_t MAX_REPLY = 64;         // Receive buffer size; replies are Msg or StreamReport
+constexpr int PING_TIMEOUT_MS = 1000;    // Plain ping-pong: a pong later than this counts as lost
+constexpr size_t DEFAULT_WINDOW = 16;    // --reliable messages in flight
+constexpr uint64_t DEFAULT_RTO_US = 1000;
+constexpr uint64_t DEFAULT_INTERVAL_US = 50; // --fanout send pacing
+
+// The subscriber's reply to the END marker (see subscriber.cpp)
+struct StreamReport {
+    uint64_t seq;          // END_SEQ
+    uint64_t received;
+    uint64_t gaps;
+    uint64_t syscalls;
+    uint64_t elapsed_ns;
+    uint64_t kernel_drops;
+};
+
+// A --oneway subscriber's reply to the END marker (see subscriber.cpp)
+struct LatencyReport {
+    uint64_t seq; // END_SEQ
+    uint64_t id;  // Subscriber pid
+    uint64_t received;
+    uint64_t gaps;
+    uint64_t mean_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+};
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef __linux__
+// sendmmsg() is Linux-only; elsewhere do one message per call
+struct mmsghdr {
+    msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+static int sendmmsg(int sock, mmsghdr* msgs, unsigned int n, int) {
+    for (unsigned int i = 0; i < n; ++i) {
+        ssize_t sent = sendmsg(sock, &msgs[i].msg_hdr, 0);
+        if (sent < 0) return i > 0 ? (int)i : -1;
+        msgs[i].msg_len = (unsigned int)sent;
+    }
+    return (int)n;
+}
+#endif
+
+// Sends the END marker until the subscriber reports back, then prints the
+// stream summary. Shared by both I/O engines.
+static int finish_stream(int sock, const char* io, int count, size_t batch, bool gso, size_t flows,
+                         double send_s, uint64_t syscalls) {
+    timeval tv{0, REPORT_TIMEOUT_MS * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    StreamReport report{};
+    bool have_report = false;
+    Msg end{END_SEQ, 0};
+    for (int attempt = 0; attempt < REPORT_RETRIES && !have_report; ++attempt) {
+        send(sock, &end, sizeof(end), 0);
+        ssize_t rec;
+        while ((rec = recv(sock, &report, sizeof(report), 0)) >= 0) {
+            if (rec == sizeof(report) && report.seq == END_SEQ) {
+                have_report = true;
+                break;
+            }
+        }
+    }
+    if (!have_report) {
+        cerr << "No stream report from subscriber (is it running with --sink?)\n";
+        return 1;
+    }
+
+    double recv_s = report.elapsed_ns / 1e9;
+    cout << "UDP stream io=" << io
+         << " batch=" << batch
+         << " gso=" << (gso ? 1 : 0)
+         << " flows=" << flows
+         << " count=" << count
+         << " sent_pps=" << count / send_s
+         << " recv_pps=" << (recv_s > 0 ? report.received / recv_s : 0)
+         << " pub_syscalls_per_msg=" << (double)syscalls / count
+         << " sub_syscalls_per_msg=" << (report.received ? (double)report.syscalls / report.received : 0)
+         << " received=" << report.received
+         << " dropped=" << (uint64_t)count - min<uint64_t>(report.received, count)
+         << " seq_gaps=" << report.gaps
+         << " kernel_drops=" << report.kernel_drops << "\n";
+    return 0;
+}
+
+// `rtts` in ns
+static void print_ping_pong(const char* io, const pubsub::Histogram& rtts, uint64_t syscalls) {
+    if (!rtts.count()) {
+        cerr << "No replies received\n";
+        return;
+    }
+    cout << "UDP ping-pong io=" << io;
+    pubsub::print_rtt_fields(cout, pubsub::summarize(rtts));
+    cout << " syscalls_per_msg=" << (double)syscalls / rtts.count() << "\n";
+}
+
+#ifdef HAVE_TIMESTAMPING
+// p50 and p99 of one breakdown stage (recorded in ns), as
+// "name_us=.. name_p99_us=..", on the same percentiles as the RTT
+static void print_stage(const char* name, const pubsub::Histogram& ns) {
+    if (!ns.count()) return;
+    cout << " " << name << "_us=" << ns.value_at_percentile(50) / 1000.0
+         << " " << name << "_p99_us=" << ns.value_at_percentile(99) / 1000.0;
+}
+
+// Records `to - from` in ns; a stamp pair that runs backwards (clock
+// adjustment) counts as 0 rather than wrapping
+static void record_stage(pubsub::Histogram& h, uint64_t from, uint64_t to) {
+    h.record(to > from ? to - from : 0);
+}
+
+// Ping-pong with SO_TIMESTAMPING: splits each RTT at the kernel's TX stamp
+// of the ping and RX stamp of the pong, and, if the subscriber runs with
+// --timestamping too, at its RX stamp and its recvmsg() return. All stamps
+// are CLOCK_REALTIME, so the peer must share our clock (same host).
+static int run_timestamped(int sock, const sockaddr_in& sub, int count, bool hardware, int busy_poll_us) {
+    if (!enable_timestamping(sock, hardware)) return 1;
+    timeval tv{PING_TIMEOUT_MS / 1000, (PING_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    pubsub::Histogram rtts;
+    pubsub::Histogram tx_stack, kernel_rtt, out, peer_wakeup, back, wakeup, hw_rtt;
+    uint64_t syscalls = 0, lost = 0;
+    alignas(cmsghdr) char control[TIMESTAMP_CONTROL];
+    char buf[MAX_REPLY];
+
+    for (uint64_t i = 0; i < (uint64_t)count; ++i) {
+        Msg m{i, realtime_ns()};
+        ssize_t sent = sendto(sock, &m, sizeof(m), 0, (const sockaddr*)&sub, sizeof(sub));
+        ++syscalls;
+        if (sent != sizeof(m)) { perror("sendto"); break; }
+
+        // wait for the pong; a late pong for an earlier ping is skipped
+        iovec iov{buf, sizeof(buf)};
+        msghdr h{};
+        ssize_t rec;
+        TimestampedEcho echo{};
+        do {
+            h = msghdr{};
+            h.msg_iov = &iov;
+            h.msg_iovlen = 1;
+            h.msg_control = control;
+            h.msg_controllen = sizeof(control);
+            rec = recvmsg(sock, &h, 0);
+            ++syscalls;
+            if (rec >= (ssize_t)sizeof(Msg)) memcpy(&echo, buf, min<size_t>(rec, sizeof(echo)));
+        } while (rec >= (ssize_t)sizeof(Msg) && echo.seq != i);
+        uint64_t rx_user = realtime_ns();
+        if (rec < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) { perror("recvmsg"); break; }
+            ++lost;
+            continue;
+        }
+        KernelStamps rx = parse_timestamps(h);
+
+        // OPT_ID numbers our sends from 0, so ping i is id i; older stamps
+        // (e.g. of a ping whose pong was lost) are skipped
+        KernelStamps tx, stamp;
+        for (;;) {
+            ++syscalls; // The final, empty read counts too
+            if (!read_tx_timestamp(sock, stamp)) break;
+            if (stamp.id != (uint32_t)i) continue;
+            if (stamp.sw_ns) tx.sw_ns = stamp.sw_ns;
+            if (stamp.hw_ns) tx.hw_ns = stamp.hw_ns;
+        }
+
+        rtts.record(rx_user - m.t_ns);
+        if (tx.hw_ns && rx.hw_ns) record_stage(hw_rtt, tx.hw_ns, rx.hw_ns);
+        if (!tx.sw_ns || !rx.sw_ns) continue;
+        record_stage(tx_stack, m.t_ns, tx.sw_ns);
+        record_stage(kernel_rtt, tx.sw_ns, rx.sw_ns);
+        record_stage(wakeup, rx.sw_ns, rx_user);
+        if (rec == (ssize_t)sizeof(TimestampedEcho) && echo.rx_kernel_ns) {
+            record_stage(out, tx.sw_ns, echo.rx_kernel_ns);
+            record_stage(peer_wakeup, echo.rx_kernel_ns, echo.rx_user_ns);
+            record_stage(back, echo.rx_user_ns, rx.sw_ns);
+        }
+    }
+
+    if (lost) cerr << lost << " pings timed out after " << PING_TIMEOUT_MS << " ms\n";
+    uint64_t stamped = kernel_rtt.count(), peer_stamped = out.count(), hw_stamped = hw_rtt.count();
+    print_ping_pong("blocking", rtts, syscalls);
+    if (!rtts.count()) return 0;
+    cout << "UDP timestamps busy_poll_us=" << busy_poll_us
+         << " stamped=" << stamped
+         << " peer_stamped=" << peer_stamped
+         << " hw_stamped=" << hw_stamped;
+    print_stage("tx_stack", tx_stack);
+    print_stage("kernel_rtt", kernel_rtt);
+    print_stage("out", out);
+    print_stage("peer_wakeup", peer_wakeup);
+    print_stage("back", back);
+    print_stage("wakeup", wakeup);
+    print_stage("hw_rtt", hw_rtt);
+    cout << "\n";
+    return 0;
+}
+#endif
+
+// Sends seq first_seq .. first_seq + count - 1 on a connected socket
+static int send_range(int sock, uint64_t first_seq, uint64_t count, size_t batch, bool gso, uint64_t& syscalls) {
+    size_t segs_per_send = gso ? min(batch, MAX_GSO_SEGMENTS) : 1;
+    size_t max_entries = (batch + segs_per_send - 1) / segs_per_send;
+
+    vector<Msg> msgs(batch);
+    vector<iovec> iovs(max_entries);
+    vector<mmsghdr> hdrs(max_entries);
+    constexpr size_t CONTROL_BYTES = CMSG_SPACE(sizeof(uint16_t));
+    vector<char> control(max_entries * CONTROL_BYTES);
+
+    uint64_t sent = 0;
+    while (sent < count) {
+        size_t n = min<uint64_t>(batch, count - sent);
+        // One timestamp per batch keeps the clock off the per-message path
+        uint64_t t_ns = now_ns();
+        for (size_t k = 0; k < n; ++k) {
+            msgs[k].seq = first_seq + sent + k;
+            msgs[k].t_ns = t_ns;
+        }
+
+        // Each entry covers segs_per_send contiguous messages
+        size_t entries = 0;
+        for (size_t first = 0; first < n; first += segs_per_send, ++entries) {
+            size_t segs = min(segs_per_send, n - first);
+            iovs[entries] = {&msgs[first], segs * sizeof(Msg)};
+            msghdr& h = hdrs[entries].msg_hdr;
+            h = msghdr{};
+            h.msg_iov = &iovs[entries];
+            h.msg_iovlen = 1;
+            if (gso && segs > 1) {
+                h.msg_control = &control[entries * CONTROL_BYTES];
+                h.msg_controllen = CONTROL_BYTES;
+                cmsghdr* c = CMSG_FIRSTHDR(&h);
+                c->cmsg_level = IPPROTO_UDP;
+                c->cmsg_type = UDP_SEGMENT;
+                c->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gso_size = sizeof(Msg);
+                memcpy(CMSG_DATA(c), &gso_size, sizeof(gso_size));
+            }
+        }
+
+        // sendmmsg() may stop short; resend the remainder
+        size_t done = 0;
+        while (done < entries) {
+            int rc = sendmmsg(sock, &hdrs[done], (unsigned int)(entries - done), 0);
+            ++syscalls;
+            if (rc < 0) {
+                if (errno == ENOBUFS || errno == EAGAIN) continue;
+                perror("sendmmsg");
+                return 1;
+            }
+            done += rc;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+// One-way streaming throughput over a connected socket. With flows > 1 the
+// range is split over that many sockets (one thread each), so the stream has
+// several source ports for a SO_REUSEPORT subscriber to spread.
+static int run_stream(int sock, const sockaddr_in& sub, int count, size_t batch, bool gso, size_t flows) {
+#ifndef __linux__
+    if (gso) {
+        cerr << "UDP_SEGMENT is only available on Linux, ignoring --gso\n";
+        gso = false;
+    }
+#endif
+    uint64_t syscalls = 0;
+    auto start = clk::now();
+    if (flows == 1) {
+        if (send_range(sock, 0, count, batch, gso, syscalls) != 0) return 1;
+    } else {
+        vector<int> socks(flows, sock);
+        for (size_t f = 1; f < flows; ++f) {
+            socks[f] = socket(AF_INET, SOCK_DGRAM, 0);
+            if (socks[f] < 0 || connect(socks[f], (const sockaddr*)&sub, sizeof(sub)) < 0) {
+                perror("flow socket");
+                return 1;
+            }
+        }
+        vector<uint64_t> flow_syscalls(flows, 0);
+        vector<int> flow_rc(flows, 0);
+        vector<thread> threads;
+        for (size_t f = 0; f < flows; ++f) {
+            uint64_t first = (uint64_t)count * f / flows;
+            uint64_t last = (uint64_t)count * (f + 1) / flows;
+            threads.emplace_back([&, f, first, last] {
+                flow_rc[f] = send_range(socks[f], first, last - first, batch, gso, flow_syscalls[f]);
+            });
+        }
+        for (thread& t : threads) t.join();
+        for (size_t f = 0; f < flows; ++f) {
+            if (f > 0) close(socks[f]);
+            if (flow_rc[f] != 0) return 1;
+            syscalls += flow_syscalls[f];
+        }
+    }
+    double send_s = chrono::duration<double>(clk::now() - start).count();
+
+    return finish_stream(sock, "blocking", count, batch, gso, flows, send_s, syscalls);
+}
+
+static uint64_t cpu_ns(const timeval& tv) {
+    return (uint64_t)tv.tv_sec * 1000000000ull + (uint64_t)tv.tv_usec * 1000ull;
+}
+
+// One-way fan-out: each paced message goes to every destination (a single
+// multicast group, or one unicast address per subscriber), then the END
+// marker collects a LatencyReport from each of `subscribers` receivers
+static int run_fanout(int sock, const vector<sockaddr_in>& dests, size_t subscribers, int count,
+                      uint64_t interval_ns, bool multicast) {
+    uint64_t send_ns = 0;
+    rusage before{}, after{};
+    getrusage(RUSAGE_SELF, &before);
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < (uint64_t)count; ++i) {
+        uint64_t due = start + i * interval_ns;
+        while (now_ns() < due) { /* busy-wait: pacing without sleep jitter */ }
+        Msg m{i, now_ns()};
+        for (const sockaddr_in& dest : dests) {
+            if (sendto(sock, &m, sizeof(m), 0, (const sockaddr*)&dest, sizeof(dest)) != sizeof(m)) {
+                perror("sendto");
+                return 1;
+            }
+        }
+        send_ns += now_ns() - m.t_ns;
+    }
+    getrusage(RUSAGE_SELF, &after);
 
-struct Msg {
-    uint64_t seq;
-    uint64_t t_ns;
+    // END marker, retried until every subscriber has reported once
+    timeval tv{0, REPORT_TIMEOUT_MS * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    vector<LatencyReport> reports;
+    Msg end{END_SEQ, 0};
+    for (int attempt = 0; attempt < REPORT_RETRIES && reports.size() < subscribers; ++attempt) {
+        for (const sockaddr_in& dest : dests) sendto(sock, &end, sizeof(end), 0, (const sockaddr*)&dest, sizeof(dest));
+        LatencyReport report;
+        ssize_t rec;
+        while (reports.size() < subscribers && (rec = recv(sock, &report, sizeof(report), 0)) >= 0) {
+            if (rec != sizeof(report) || report.seq != END_SEQ) continue;
+            bool seen = false;
+            for (const LatencyReport& r : reports) seen |= r.id == report.id;
+            if (!seen) reports.push_back(report);
+        }
+    }
+    if (reports.size() < subscribers) {
+        cerr << "Only " << reports.size() << " of " << subscribers << " subscribers reported\n";
+    }
+    if (reports.empty()) return 1;
+
+    uint64_t sum_p50 = 0, worst_p99 = 0, worst_max = 0, min_received = UINT64_MAX;
+    for (const LatencyReport& r : reports) {
+        cout << "  subscriber pid=" << r.id
+             << " received=" << r.received
+             << " gaps=" << r.gaps
+             << " mean_one_way_us=" << r.mean_ns / 1000.0
+             << " p50_one_way_us=" << r.p50_ns / 1000.0
+             << " p99_one_way_us=" << r.p99_ns / 1000.0
+             << " max_one_way_us=" << r.max_ns / 1000.0 << "\n";
+        sum_p50 += r.p50_ns;
+        worst_p99 = max(worst_p99, r.p99_ns);
+        worst_max = max(worst_max, r.max_ns);
+        min_received = min(min_received, r.received);
+    }
+    uint64_t sys_ns = cpu_ns(after.ru_stime) - cpu_ns(before.ru_stime);
+    cout << "UDP fanout mode=" << (multicast ? "multicast" : "unicast")
+         << " subscribers=" << subscribers
+         << " reports=" << reports.size()
+         << " count=" << count
+         << " send_ns_per_msg=" << (double)send_ns / count
+         << " pub_sys_ns_per_msg=" << (double)sys_ns / count
+         << " avg_p50_one_way_us=" << (double)sum_p50 / reports.size() / 1000.0
+         << " worst_p99_one_way_us=" << worst_p99 / 1000.0
+         << " worst_max_one_way_us=" << worst_max / 1000.0
+         << " min_received=" << min_received << "\n";
+    return 0;
+}
+
+// Ping-pong with a retransmit window. Each message is acked by its echo,
+// which the subscriber only sends once everything before it was delivered, so
+// RTT includes any recovery. Lost messages are resent when the subscriber
+// Nacks them, or when the oldest one goes rto_ns without an echo.
+struct WindowSlot {
+    Msg msg;
+    uint64_t first_send_ns;
+    uint64_t last_send_ns;
+    bool acked;
 };
 
+static int run_reliable(int sock, const sockaddr_in& sub, int count, size_t window, uint64_t rto_ns,
+                        LossInjector& loss) {
+    vector<WindowSlot> slots(window);
+    pubsub::Histogram rtts;
+    uint64_t base = 0, next = 0; // Oldest unacked and next new sequence number
+    uint64_t retransmits = 0, nacks = 0, timeouts = 0;
+
+    auto transmit = [&](WindowSlot& slot, uint64_t now) {
+        slot.last_send_ns = now;
+        loss.send(sock, &slot.msg, sizeof(slot.msg), sub, now);
+    };
+
+    auto start = clk::now();
+    while (base < (uint64_t)count) {
+        uint64_t now = now_ns();
+        while (next < (uint64_t)count && next < base + window) {
+            WindowSlot& slot = slots[next % window];
+            slot.msg = {next, now};
+            slot.first_send_ns = now;
+            slot.acked = false;
+            transmit(slot, now);
+            ++next;
+        }
+
+        // The timer runs on the oldest unacked message only: later ones are
+        // normally just waiting behind it in the subscriber's reorder buffer
+        uint64_t wake_ns = loss.deadline_ns();
+        if (base < next) {
+            WindowSlot& oldest = slots[base % window];
+            if (now - oldest.last_send_ns >= rto_ns) {
+                transmit(oldest, now);
+                ++retransmits;
+                ++timeouts;
+            }
+            wake_ns = min(wake_ns, oldest.last_send_ns + rto_ns);
+        }
+        loss.poll(sock, now);
+
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(sock, &readable);
+        uint64_t wait_us = wake_ns > now ? (wake_ns - now + 999) / 1000 : 0;
+        timeval tv{(time_t)(wait_us / 1000000), (suseconds_t)(wait_us % 1000000)};
+        int ready = select(sock + 1, &readable, nullptr, nullptr, &tv);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("select");
+            return 1;
+        }
+        if (ready == 0) continue;
+
+        char buf[MAX_REPLY];
+        ssize_t rec;
+        while ((rec = recv(sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+            now = now_ns();
+            if (rec == sizeof(Nack)) {
+                Nack nack;
+                memcpy(&nack, buf, sizeof(nack));
+                if (nack.seq != NACK_SEQ) continue;
+                ++nacks;
+                uint64_t last = min(nack.first + nack.count, next);
+                for (uint64_t q = max(nack.first, base); q < last; ++q) {
+                    WindowSlot& slot = slots[q % window];
+                    if (slot.acked) continue;
+                    transmit(slot, now);
+                    ++retransmits;
+                }
+            } else if (rec == sizeof(Msg)) {
+                Msg echo;
+                memcpy(&echo, buf, sizeof(echo));
+                if (echo.seq < base || echo.seq >= next) continue; // Duplicate ack
+                WindowSlot& slot = slots[echo.seq % window];
+                if (slot.acked) continue;
+                slot.acked = true;
+                rtts.record(now - slot.first_send_ns);
+            }
+        }
+        while (base < next && slots[base % window].acked) ++base;
+    }
+    double elapsed_s = chrono::duration<double>(clk::now() - start).count();
+
+    pubsub::LatencySummary rtt = pubsub::summarize(rtts);
+    cout << "UDP reliable count=" << rtt.count
+         << " window=" << window
+         << " rto_us=" << rto_ns / 1000
+         << " avg_RTT_us=" << rtt.avg_us
+         << " median_RTT_us=" << rtt.p50_us
+         << " p99_RTT_us=" << rtt.p99_us
+         << " p999_RTT_us=" << rtt.p999_us
+         << " p9999_RTT_us=" << rtt.p9999_us
+         << " max_RTT_us=" << rtt.max_us
+         << " msgs_per_sec=" << rtts.count() / elapsed_s
+         << " retransmits=" << retransmits
+         << " nacks=" << nacks
+         << " timeouts=" << timeouts
+         << " injected_drops=" << loss.dropped
+         << " injected_reorders=" << loss.reordered << "\n";
+    return 0;
+}
+
+#ifdef HAVE_IO_URING
+constexpr unsigned URING_DEPTH = 256;      // Submission queue entries; also caps a stream batch
+constexpr unsigned URING_BUFFERS = 64;     // Provided reply buffers (power of two)
+constexpr uint16_t REPLY_GROUP = 0;
+constexpr uint64_t RECV_TAG = UINT64_MAX;  // user_data of the multishot receive; sends use their index
+
+// Ping-pong over io_uring on a connected socket: WRITE_FIXED the ping from a
+// registered buffer, then reap completions until the matching pong arrives
+static int run_uring_ping_pong(int sock, int count, bool sqpoll) {
+    IoUring ring;
+    if (!ring.init(URING_DEPTH, sqpoll) || !ring.register_files(&sock, 1)) return 1;
+    ProvidedBufferRing replies;
+    if (!replies.init(ring, REPLY_GROUP, URING_BUFFERS, MAX_REPLY)) return 1;
+    Msg ping{};
+    iovec reg = {&ping, sizeof(ping)};
+    if (!ring.register_buffers(&reg, 1)) return 1;
+
+    auto arm_recv = [&] {
+        io_uring_sqe* sqe = ring.get_sqe();
+        prep_recv_multishot(sqe, 0, REPLY_GROUP);
+        sqe->user_data = RECV_TAG;
+    };
+    arm_recv();
+
+    pubsub::Histogram rtts;
+    uint64_t base_enters = ring.enters;
+
+    for (uint64_t i = 0; i < (uint64_t)count; ++i) {
+        ping.seq = i;
+        ping.t_ns = now_ns();
+        prep_write_fixed(ring.get_sqe(), 0, &ping, sizeof(ping), 0);
+
+        bool got = false;
+        while (!got) {
+            ring.submit_and_wait();
+            io_uring_cqe* cqe = ring.wait_cqe();
+            if (!cqe) { perror("io_uring_enter"); return 1; }
+            for (; cqe; ring.cqe_seen(), cqe = ring.peek_cqe()) {
+                if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+                    errno = -cqe->res;
+                    perror(cqe->user_data == RECV_TAG ? "io_uring recv" : "io_uring write");
+                    return 1;
+                }
+                if (cqe->user_data != RECV_TAG) continue;
+                if (cqe->flags & IORING_CQE_F_BUFFER) {
+                    uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                    Msg reply;
+                    if (cqe->res >= (int)sizeof(reply)) {
+                        memcpy(&reply, replies.buffer(bid), sizeof(reply));
+                        if (reply.seq == i) {
+                            rtts.record(now_ns() - ping.t_ns);
+                            got = true;
+                        }
+                    }
+                    replies.recycle(bid);
+                }
+                if (!(cqe->flags & IORING_CQE_F_MORE)) arm_recv();
+            }
+        }
+    }
+
+    print_ping_pong(sqpoll ? "uring+sqpoll" : "uring", rtts, ring.enters - base_enters);
+    return 0;
+}
+
+// Streaming over io_uring: each batch is queued as WRITE_FIXED SQEs out of
+// one registered message array and submitted and reaped with a single
+// io_uring_enter() (none under SQPOLL). Failed sends are retried.
+static int run_uring_stream(int sock, int count, size_t batch, bool sqpoll) {
+    batch = min<size_t>(batch, URING_DEPTH);
+    IoUring ring;
+    if (!ring.init(URING_DEPTH, sqpoll) || !ring.register_files(&sock, 1)) return 1;
+    vector<Msg> msgs(batch);
+    iovec reg = {msgs.data(), msgs.size() * sizeof(Msg)};
+    if (!ring.register_buffers(&reg, 1)) return 1;
+
+    vector<size_t> pending;
+    uint64_t sent = 0;
+    auto start = clk::now();
+
+    while (sent < (uint64_t)count) {
+        size_t n = min<uint64_t>(batch, count - sent);
+        uint64_t t_ns = now_ns();
+        pending.clear();
+        for (size_t k = 0; k < n; ++k) {
+            msgs[k].seq = sent + k;
+            msgs[k].t_ns = t_ns;
+            pending.push_back(k);
+        }
+
+        // The kernel may still be reading msgs until every send completes
+        while (!pending.empty()) {
+            for (size_t k : pending) {
+                io_uring_sqe* sqe = ring.get_sqe();
+                prep_write_fixed(sqe, 0, &msgs[k], sizeof(Msg), 0);
+                sqe->user_data = k;
+            }
+            unsigned inflight = (unsigned)pending.size();
+            pending.clear();
+            ring.submit(sqpoll ? 0 : inflight);
+            for (unsigned done = 0; done < inflight; ++done) {
+                io_uring_cqe* cqe = ring.wait_cqe();
+                if (!cqe) { perror("io_uring_enter"); return 1; }
+                if (cqe->res == -ENOBUFS || cqe->res == -EAGAIN) {
+                    pending.push_back((size_t)cqe->user_data);
+                } else if (cqe->res < 0) {
+                    errno = -cqe->res;
+                    perror("io_uring write");
+                    return 1;
+                }
+                ring.cqe_seen();
+            }
+        }
+        sent += n;
+    }
+    double send_s = chrono::duration<double>(clk::now() - start).count();
+
+    return finish_stream(sock, sqpoll ? "uring+sqpoll" : "uring", count, batch, false, 1, send_s, ring.enters);
+}
+#endif
+
 int main(int argc, char** argv) {
     if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <subscriber_ip> <subscriber_port> <count>\n";
+        cerr << "Usage: " << argv[0] << " <subscriber_ip> <subscriber_port> <count> [--stream] [--batch=N] [--gso]"
+             << " [--io=blocking|uring] [--sqpoll] [--reliable] [--window=N] [--rto-us=N] [--loss=P] [--reorder=P]"
+             << " [--seed=N] [--fanout=N] [--interval-us=N] [--ttl=N] [--no-loop] [--interface=IP] [--flows=N]"
+             << " [--busy-poll=US] [--timestamping] [--hw-timestamps=IFACE]\n";
         return 1;
     }
     string sub_ip = argv[1];
     int sub_port = stoi(argv[2]);
     int count = stoi(argv[3]);
+    bool stream = false;
+    bool gso = false;
+    bool uring = false;
+    bool sqpoll = false;
+    bool reliable = false;
+    size_t batch = 1;
+    size_t window = DEFAULT_WINDOW;
+    uint64_t rto_us = DEFAULT_RTO_US;
+    double loss_pct = 0, reorder_pct = 0;
+    uint64_t seed = DEFAULT_LOSS_SEED;
+    size_t fanout = 0;
+    size_t flows = 1;
+    uint64_t interval_us = DEFAULT_INTERVAL_US;
+    int ttl = 1;
+    bool loop = true;
+    string iface;
+    int busy_poll_us = 0;
+    bool timestamping = false;
+    string hw_iface;
+    for (int a = 4; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "--stream") stream = true;
+        else if (arg.rfind("--busy-poll=", 0) == 0) busy_poll_us = max(0, stoi(arg.substr(12)));
+        else if (arg == "--timestamping") timestamping = true;
+        else if (arg.rfind("--hw-timestamps=", 0) == 0) hw_iface = arg.substr(16), timestamping = true;
+        else if (arg == "--no-loop") loop = false;
+        else if (arg.rfind("--flows=", 0) == 0) flows = max<size_t>(1, stoul(arg.substr(8)));
+        else if (arg.rfind("--fanout=", 0) == 0) fanout = max<size_t>(1, stoul(arg.substr(9)));
+        else if (arg.rfind("--interval-us=", 0) == 0) interval_us = stoull(arg.substr(14));
+        else if (arg.rfind("--ttl=", 0) == 0) ttl = stoi(arg.substr(6));
+        else if (arg.rfind("--interface=", 0) == 0) iface = arg.substr(12);
+        else if (arg == "--reliable") reliable = true;
+        else if (arg.rfind("--window=", 0) == 0) window = max<size_t>(1, stoul(arg.substr(9)));
+        else if (arg.rfind("--rto-us=", 0) == 0) rto_us = max<uint64_t>(1, stoull(arg.substr(9)));
+        else if (arg.rfind("--loss=", 0) == 0) loss_pct = parse_percent(arg.substr(7));
+        else if (arg.rfind("--reorder=", 0) == 0) reorder_pct = parse_percent(arg.substr(10));
+        else if (arg.rfind("--seed=", 0) == 0) seed = stoull(arg.substr(7));
+        else if (arg == "--gso") gso = true;
+        else if (arg == "--sqpoll") sqpoll = true;
+        else if (arg == "--io=uring") uring = true;
+        else if (arg == "--io=blocking") uring = false;
+        else if (arg.rfind("--batch=", 0) == 0) batch = max<size_t>(1, stoul(arg.substr(8)));
+        else {
+            cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+#ifndef HAVE_IO_URING
+    if (uring) {
+        cerr << "io_uring support not compiled in, using --io=blocking\n";
+        uring = false;
+    }
+#endif
+    if (uring && gso) {
+        cerr << "--gso is not supported with --io=uring, ignoring it\n";
+        gso = false;
+    }
+    if (flows > 1 && (!stream || uring)) {
+        cerr << "--flows needs --stream and the blocking engine, ignoring it\n";
+        flows = 1;
+    }
+    if (reliable && (stream || uring)) {
+        cerr << "--reliable is a blocking ping-pong mode; it cannot be combined with --stream or --io=uring\n";
+        return 1;
+    }
+    if (!reliable && (loss_pct > 0 || reorder_pct > 0)) {
+        cerr << "--loss/--reorder need --reliable, ignoring them\n";
+    }
+#ifndef HAVE_TIMESTAMPING
+    if (timestamping) {
+        cerr << "SO_TIMESTAMPING is only available on Linux, ignoring --timestamping\n";
+        timestamping = false;
+    }
+#endif
+    if (timestamping && (stream || uring || reliable || fanout)) {
+        cerr << "--timestamping is a blocking ping-pong mode; it cannot be combined with --stream, --io=uring,"
+             << " --reliable or --fanout\n";
+        return 1;
+    }
 
     int sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock < 0) { perror("socket"); return 1; }
@@ -39,37 +788,109 @@ int main(int argc, char** argv) {
     local.sin_addr.s_addr = INADDR_ANY;
     local.sin_port = htons(0);
     if (::bind(sock, (sockaddr*)&local, sizeof(local)) < 0) { perror("bind"); return 1; }
+    if (busy_poll_us > 0 && !enable_busy_poll(sock, busy_poll_us)) return 1;
 
     sockaddr_in sub{};
     sub.sin_family = AF_INET;
     inet_pton(AF_INET, sub_ip.c_str(), &sub.sin_addr);
     sub.sin_port = htons(sub_port);
 
+    bool multicast = IN_MULTICAST(ntohl(sub.sin_addr.s_addr));
+    if (multicast || fanout) {
+        if (stream || uring || reliable) {
+            cerr << "--fanout/multicast cannot be combined with --stream, --io=uring or --reliable\n";
+            return 1;
+        }
+        fanout = max<size_t>(fanout, 1);
+        vector<sockaddr_in> dests;
+        if (multicast) {
+            unsigned char mc_ttl = (unsigned char)ttl, mc_loop = loop ? 1 : 0;
+            setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &mc_ttl, sizeof(mc_ttl));
+            setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &mc_loop, sizeof(mc_loop));
+            if (!iface.empty()) {
+                in_addr local_if{};
+                inet_pton(AF_INET, iface.c_str(), &local_if);
+                if (setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &local_if, sizeof(local_if)) < 0) {
+                    perror("setsockopt(IP_MULTICAST_IF)");
+                    return 1;
+                }
+            }
+            dests.push_back(sub);
+        } else {
+            for (size_t i = 0; i < fanout; ++i) {
+                dests.push_back(sub);
+                dests.back().sin_port = htons(sub_port + (int)i);
+            }
+        }
+        int rc = run_fanout(sock, dests, fanout, count, interval_us * 1000, multicast);
+        close(sock);
+        return rc;
+    }
+
+    if (stream || uring) {
+        // Connected: no per-datagram address or route lookup, only the
+        // subscriber's replies can arrive, and plain write()/recv() work
+        if (connect(sock, (sockaddr*)&sub, sizeof(sub)) < 0) { perror("connect"); return 1; }
+        int rc;
+#ifdef HAVE_IO_URING
+        if (uring) rc = stream ? run_uring_stream(sock, count, batch, sqpoll) : run_uring_ping_pong(sock, count, sqpoll);
+        else
+#endif
+        rc = run_stream(sock, sub, count, batch, gso, flows);
+        close(sock);
+        return rc;
+    }
+
+#ifdef HAVE_TIMESTAMPING
+    if (timestamping) {
+        if (!hw_iface.empty() && !enable_hw_timestamps(sock, hw_iface)) return 1;
+        int rc = run_timestamped(sock, sub, count, !hw_iface.empty(), busy_poll_us);
+        close(sock);
+        return rc;
+    }
+#endif
+
+    if (reliable) {
+        LossInjector loss(loss_pct, reorder_pct, seed);
+        int rc = run_reliable(sock, sub, count, window, rto_us * 1000, loss);
+        close(sock);
+        return rc;
+    }
+
     socklen_t sublen = sizeof(sub);
-    vector<double> rtts;
-    rtts.reserve(count);
+    pubsub::Histogram rtts;
+    uint64_t syscalls = 0, lost = 0;
+
+    // A lost ping or pong would otherwise block recvfrom() forever
+    timeval tv{PING_TIMEOUT_MS / 1000, (PING_TIMEOUT_MS % 1000) * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 
     for (uint64_t i = 0; i < (uint64_t)count; ++i) {
         Msg m;
         m.seq = i;
-        m.t_ns = (uint64_t)chrono::duration_cast<ns>(clk::now().time_since_epoch()).count();
+        m.t_ns = now_ns();
         ssize_t sent = sendto(sock, &m, sizeof(m), 0, (sockaddr*)&sub, sublen);
+        ++syscalls;
         if (sent != sizeof(m)) { perror("sendto"); break; }
 
-        // wait for reply (pong)
+        // wait for reply (pong); a late pong for an earlier ping is skipped
         Msg reply;
-        ssize_t rec = recvfrom(sock, &reply, sizeof(reply), 0, nullptr, nullptr);
-        if (rec < 0) { perror("recvfrom"); break; }
-        auto now_ns = (uint64_t)chrono::duration_cast<ns>(clk::now().time_since_epoch()).count();
-        double rtt_us = (now_ns - reply.t_ns) / 1000.0; // RTT in microseconds (assuming reply.t_ns is ping time at subscriber echo)
-        rtts.push_back(rtt_us);
-    }
-
-    // stats
-    double sum = 0;
-    for (double v : rtts) sum += v;
-    double avg = sum / rtts.size();
-    cout << "UDP ping-pong count=" << rtts.size() << " avg_RTT_us=" << avg << " avg_one_way_us=" << (avg/2.0) << "\n";
+        ssize_t rec;
+        do {
+            rec = recvfrom(sock, &reply, sizeof(reply), 0, nullptr, nullptr);
+            ++syscalls;
+        } while (rec == sizeof(reply) && reply.seq != i);
+        if (rec < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) { perror("recvfrom"); break; }
+            ++lost;
+            continue;
+        }
+        // reply.t_ns is the subscriber's echo time; RTT runs from our own send
+        rtts.record(now_ns() - m.t_ns);
+    }
+
+    if (lost) cerr << lost << " pings timed out after " << PING_TIMEOUT_MS << " ms\n";
+    print_ping_pong("blocking", rtts, syscalls);
 
     close(sock);
     return 0;
@@ -0,0 +1,90 @@
+// Reliability layer shared by the UDP publisher and subscriber (--reliable)
+//
+// Data stays the plain 16-byte Msg { seq, t_ns }. The subscriber delivers in
+// sequence order and echoes each delivered Msg, which doubles as the ack. When
+// it sees a sequence gap it buffers what arrived early and sends a Nack for
+// the missing range; the publisher resends from its retransmit window, and a
+// per-message retransmit timeout covers lost Nacks, echoes and tail loss.
+//
+// LossInjector drops or reorders a share of outgoing datagrams on either
+// side, so the latency cost of recovery can be measured on loopback.
+
+#pragma once
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr uint64_t NACK_SEQ = UINT64_MAX - 1;     // Marks a Nack; END_SEQ (UINT64_MAX) belongs to --stream
+constexpr uint64_t REORDER_DELAY_NS = 200'000;    // A reordered datagram goes out at the latest after this
+constexpr uint64_t DEFAULT_LOSS_SEED = 0x5eed;
+
+// Subscriber -> publisher: resend [first, first + count)
+struct Nack {
+    uint64_t seq;   // NACK_SEQ
+    uint64_t first;
+    uint64_t count;
+};
+
+// Sends datagrams, dropping loss_pct% of them and holding back reorder_pct%
+// until after the next send (or REORDER_DELAY_NS). Seeded, so runs repeat.
+class LossInjector {
+private:
+    double loss_pct;
+    double reorder_pct;
+    std::mt19937_64 rng;
+    std::uniform_real_distribution<double> pct{0.0, 100.0};
+
+    std::vector<char> held;
+    sockaddr_in held_to{};
+    uint64_t held_since_ns = 0;
+    bool has_held = false;
+
+    void send_held(int sock) {
+        sendto(sock, held.data(), held.size(), 0, (const sockaddr*)&held_to, sizeof(held_to));
+        has_held = false;
+    }
+
+public:
+    uint64_t dropped = 0;
+    uint64_t reordered = 0;
+
+    LossInjector(double loss, double reorder, uint64_t seed = DEFAULT_LOSS_SEED)
+        : loss_pct(loss), reorder_pct(reorder), rng(seed) {}
+
+    void send(int sock, const void* buf, size_t len, const sockaddr_in& to, uint64_t now_ns) {
+        if (loss_pct > 0 && pct(rng) < loss_pct) {
+            ++dropped;
+            return;
+        }
+        if (reorder_pct > 0 && !has_held && pct(rng) < reorder_pct) {
+            held.assign((const char*)buf, (const char*)buf + len);
+            held_to = to;
+            held_since_ns = now_ns;
+            has_held = true;
+            ++reordered;
+            return;
+        }
+        sendto(sock, buf, len, 0, (const sockaddr*)&to, sizeof(to));
+        if (has_held) send_held(sock);
+    }
+
+    // When the held datagram is due, or UINT64_MAX if nothing is held
+    uint64_t deadline_ns() const { return has_held ? held_since_ns + REORDER_DELAY_NS : UINT64_MAX; }
+
+    // Releases a held datagram whose delay has expired
+    void poll(int sock, uint64_t now_ns) {
+        if (has_held && now_ns >= deadline_ns()) send_held(sock);
+    }
+};
+
+// Parses "--name=<percent>" style values, clamped to [0, 100]
+inline double parse_percent(const std::string& value) {
+    double p = std::stod(value);
+    return p < 0 ? 0 : (p > 100 ? 100 : p);
+}
@@ -1,51 +1,994 @@
-// Usage: ./subscriber <listen_port>
+// Usage: ./subscriber <listen_port> [--sink] [--batch=N] [--gro] [--io=blocking|uring] [--sqpoll]
 // receives ping messages and immediately replies with the same struct
 // updating t_ns to current time so publisher can measure RTT.
+//
+// --batch=N  receive up to N datagrams per recvmmsg() (echoes go out with one sendmmsg())
+// --sink     one-way streaming mode: count instead of echoing; on the END
+//            marker reply with a StreamReport (received, gaps, syscalls, drops)
+// --gro      enable UDP_GRO so the kernel hands us coalesced datagrams (Linux)
+// --io=uring io_uring engine (see uring.hpp): one multishot recvmsg into a
+//            provided buffer ring, echoes queued as SENDMSG, and a single
+//            io_uring_enter() per wakeup. --batch does not apply.
+// --sqpoll   with --io=uring, let a kernel thread poll the submission queue
+// --reliable deliver each publisher's messages in order (see reliable.hpp):
+//            early arrivals wait in a reorder buffer of --reorder-buffer=N
+//            messages, gaps are Nacked, and only delivered messages are echoed
+// --loss=P / --reorder=P  with --reliable, drop / reorder P% of our echoes
+//            and Nacks (--seed=N varies the pattern)
+// --oneway   fan-out receiver: record one-way latency (now - t_ns, so the
+//            publisher must share our clock) and answer the END marker with
+//            a LatencyReport instead of echoing
+// --group=IP join multicast group IP (implies --oneway). The port is bound
+//            with SO_REUSEPORT so several subscribers on a host each get a
+//            copy; --interface=<local ip> picks the interface to join on.
+// --busy-poll=US  SO_BUSY_POLL/SO_PREFER_BUSY_POLL on the receive socket(s)
+// --timestamping  echo pings with our kernel RX stamp and delivery time
+//            (see timestamping.hpp) for a --timestamping publisher
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
+#include <signal.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
 #include <cstring>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../common/clock.hpp"
+#include "../common/histogram.hpp"
+#include "../common/message.hpp"
+#include "reliable.hpp"
+#include "timestamping.hpp"
+#include "uring.hpp"
 
 using namespace std;
-using ns = std::chrono::nanoseconds;
-using clk = std::chrono::high_resolution_clock;
+using pubsub::Msg;
+
+constexpr uint64_t END_SEQ = UINT64_MAX; // Marks the end of a stream; the report reuses it
+constexpr size_t MAX_DATAGRAM = 2048;    // Per-slot buffer without GRO
+constexpr size_t MAX_GRO_BUFFER = 65535; // A GRO slot can hold up to 64 KiB of coalesced datagrams
+constexpr int SINK_RCVBUF = 8 << 20;     // Ask for a deep queue so bursts are not dropped (capped by rmem_max)
+constexpr size_t DEFAULT_REORDER_BUFFER = 1024; // --reliable: early messages held per publisher
+
+// Reply to the END marker in --sink mode
+struct StreamReport {
+    uint64_t seq;          // END_SEQ
+    uint64_t received;     // Datagrams received this stream
+    uint64_t gaps;         // Sequence numbers skipped (lost or reordered)
+    uint64_t syscalls;     // recvmmsg()/io_uring_enter() calls this stream
+    uint64_t elapsed_ns;   // First to last datagram
+    uint64_t kernel_drops; // Socket receive-queue overflows (SO_RXQ_OVFL)
+};
+
+// Reply to the END marker in --oneway mode
+struct LatencyReport {
+    uint64_t seq;      // END_SEQ
+    uint64_t id;       // Our pid: group members all reply from the same shared port
+    uint64_t received; // Messages this stream
+    uint64_t gaps;     // Sequence numbers skipped
+    uint64_t mean_ns;  // One-way latency
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t max_ns;
+};
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// One recvmmsg() slot: datagram buffer, source address and control space
+struct RecvSlot {
+    vector<char> buf;
+    sockaddr_in src;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(uint32_t))];
+    iovec iov;
+};
+
+#ifndef __linux__
+// recvmmsg()/sendmmsg() are Linux-only; elsewhere do one message per call
+struct mmsghdr {
+    msghdr msg_hdr;
+    unsigned int msg_len;
+};
+
+static int recvmmsg(int sock, mmsghdr* msgs, unsigned int n, int, timespec*) {
+    ssize_t rec = recvmsg(sock, &msgs[0].msg_hdr, 0);
+    if (rec < 0) return -1;
+    msgs[0].msg_len = (unsigned int)rec;
+    (void)n;
+    return 1;
+}
+
+static int sendmmsg(int sock, mmsghdr* msgs, unsigned int n, int) {
+    for (unsigned int i = 0; i < n; ++i) {
+        ssize_t sent = sendmsg(sock, &msgs[i].msg_hdr, 0);
+        if (sent < 0) return i > 0 ? (int)i : -1;
+        msgs[i].msg_len = (unsigned int)sent;
+    }
+    return (int)n;
+}
+
+#define MSG_WAITFORONE 0
+#endif
+
+// --sink accounting for the current stream, shared by both I/O engines
+struct SinkState {
+    uint64_t received = 0, gaps = 0, expected_seq = 0;
+    uint64_t first_ns = 0, last_ns = 0;
+    uint64_t syscalls_base = 0;
+    uint32_t ovfl_latest = 0, ovfl_base = 0;
+    StreamReport last_report{END_SEQ, 0, 0, 0, 0, 0};
+
+    // `syscalls` is the engine's running total, including the call that
+    // delivered this datagram
+    void on_data(const Msg& m, uint64_t now_ns, uint64_t syscalls) {
+        if (received == 0) {
+            first_ns = now_ns;
+            syscalls_base = syscalls - 1;
+        }
+        last_ns = now_ns;
+        if (m.seq > expected_seq) gaps += m.seq - expected_seq;
+        expected_seq = max(expected_seq, m.seq + 1);
+        ++received;
+    }
+
+    // Repeated END markers (the publisher retries) get the same report
+    const StreamReport& on_end(uint64_t syscalls) {
+        if (received > 0) {
+            last_report = {END_SEQ, received, gaps, syscalls - syscalls_base, last_ns - first_ns,
+                           ovfl_latest - ovfl_base};
+            received = gaps = expected_seq = 0;
+            ovfl_base = ovfl_latest;
+        }
+        return last_report;
+    }
+};
+
+// Returns the GRO segment size if the kernel coalesced datagrams, and picks up
+// the SO_RXQ_OVFL drop counter
+static size_t parse_cmsgs(msghdr& h, size_t len, uint32_t& ovfl_latest) {
+    size_t seg = len;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(&h, c)) {
+        if (c->cmsg_level == IPPROTO_UDP && c->cmsg_type == UDP_GRO) {
+            int gso_size;
+            memcpy(&gso_size, CMSG_DATA(c), sizeof(gso_size));
+            seg = (size_t)gso_size;
+        }
+#ifdef SO_RXQ_OVFL
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&ovfl_latest, CMSG_DATA(c), sizeof(ovfl_latest));
+        }
+#endif
+    }
+    return seg;
+}
+
+// recvmmsg() into `batch` slots; shared by the single-socket loop and the
+// --workers threads
+class BatchReceiver {
+private:
+    vector<RecvSlot> slots;
+    vector<mmsghdr> msgs;
+
+public:
+    BatchReceiver(size_t batch, bool gro) : slots(batch), msgs(batch) {
+        for (RecvSlot& slot : slots) {
+            slot.buf.resize(gro ? MAX_GRO_BUFFER : MAX_DATAGRAM);
+            slot.iov = {slot.buf.data(), slot.buf.size()};
+        }
+    }
+
+    // MSG_WAITFORONE: block for the first datagram, then take what is queued
+    int receive(int sock) {
+        for (size_t i = 0; i < slots.size(); ++i) {
+            msghdr& h = msgs[i].msg_hdr;
+            h = msghdr{};
+            h.msg_name = &slots[i].src;
+            h.msg_namelen = sizeof(slots[i].src);
+            h.msg_iov = &slots[i].iov;
+            h.msg_iovlen = 1;
+            h.msg_control = slots[i].control;
+            h.msg_controllen = sizeof(slots[i].control);
+        }
+        return recvmmsg(sock, msgs.data(), (unsigned int)msgs.size(), MSG_WAITFORONE, nullptr);
+    }
+
+    msghdr& header(int i) { return msgs[i].msg_hdr; }
+    size_t length(int i) const { return msgs[i].msg_len; }
+    const char* data(int i) const { return slots[i].buf.data(); }
+    const sockaddr_in& source(int i) const { return slots[i].src; }
+};
+
+static int run_blocking(int sock, bool sink, size_t batch, bool gro) {
+    BatchReceiver rx(batch, gro);
+    // Echo path: one outgoing datagram per received Msg
+    vector<Msg> replies;
+    vector<sockaddr_in> reply_to;
+    vector<iovec> reply_iov;
+    vector<mmsghdr> reply_msgs;
+
+    SinkState st;
+    uint64_t syscalls = 0;
+
+    while (true) {
+        int n = rx.receive(sock);
+        if (n <= 0) { perror("recvmmsg"); return 1; }
+        ++syscalls;
+        uint64_t now_ns = pubsub::now_ns();
+
+        replies.clear();
+        reply_to.clear();
+        for (int i = 0; i < n; ++i) {
+            size_t len = rx.length(i);
+            // With GRO one slot may carry several same-sized datagrams
+            size_t seg = parse_cmsgs(rx.header(i), len, st.ovfl_latest);
+
+            for (size_t off = 0; off + sizeof(Msg) <= len; off += seg) {
+                Msg m;
+                memcpy(&m, rx.data(i) + off, sizeof(m));
+
+                if (!sink) {
+                    // set t_ns at reply time (so publisher can compute RTT)
+                    m.t_ns = now_ns;
+                    replies.push_back(m);
+                    reply_to.push_back(rx.source(i));
+                    continue;
+                }
+
+                if (m.seq == END_SEQ) {
+                    const StreamReport& report = st.on_end(syscalls);
+                    sendto(sock, &report, sizeof(report), 0, (const sockaddr*)&rx.source(i), sizeof(sockaddr_in));
+                    continue;
+                }
+                st.on_data(m, now_ns, syscalls);
+            }
+        }
+
+        if (!replies.empty()) {
+            reply_iov.resize(replies.size());
+            reply_msgs.resize(replies.size());
+            for (size_t i = 0; i < replies.size(); ++i) {
+                reply_iov[i] = {&replies[i], sizeof(Msg)};
+                msghdr& h = reply_msgs[i].msg_hdr;
+                h = msghdr{};
+                h.msg_name = &reply_to[i];
+                h.msg_namelen = sizeof(reply_to[i]);
+                h.msg_iov = &reply_iov[i];
+                h.msg_iovlen = 1;
+            }
+            int sent = sendmmsg(sock, reply_msgs.data(), (unsigned int)replies.size(), 0);
+            if (sent != (int)replies.size()) { perror("sendmmsg"); return 1; }
+        }
+    }
+}
+
+// Receive-side socket options shared by the single socket and --workers:
+// deep queue and drop counter for sinks, UDP_GRO on request
+static void configure_receive(int sock, bool sink, bool& gro) {
+    if (sink) {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &SINK_RCVBUF, sizeof(SINK_RCVBUF));
+#ifdef SO_RXQ_OVFL
+        int one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+#endif
+    }
+    if (gro) {
+#ifdef __linux__
+        int one = 1;
+        if (setsockopt(sock, IPPROTO_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+            perror("setsockopt(UDP_GRO)");
+            gro = false;
+        }
+#else
+        cerr << "UDP_GRO is only available on Linux, ignoring --gro\n";
+        gro = false;
+#endif
+    }
+}
+
+// --workers=N: how the kernel spreads datagrams over the SO_REUSEPORT group
+enum class Steering {
+    Hash, // Default: by flow 4-tuple, so one publisher flow lands on one worker
+    Cpu,  // SO_INCOMING_CPU: prefer the socket whose worker runs on the receiving CPU
+    Bpf,  // Reuseport cBPF program: socket index = receiving CPU % N
+};
+
+static const char* steering_name(Steering s) {
+    switch (s) {
+        case Steering::Hash: return "hash";
+        case Steering::Cpu: return "cpu";
+        case Steering::Bpf: return "bpf";
+    }
+    return "?";
+}
+
+// Per-worker counters, each on its own cache line. Only the owning worker
+// writes them; the END handler and shutdown read them to merge.
+struct alignas(64) WorkerStats {
+    atomic<uint64_t> received{0};
+    atomic<uint64_t> syscalls{0};
+    atomic<uint64_t> first_ns{UINT64_MAX}; // This stream; reset after each END
+    atomic<uint64_t> last_ns{0};
+    atomic<uint32_t> ovfl{0};
+    unsigned cpu = 0;
+};
+
+static void add_relaxed(atomic<uint64_t>& counter, uint64_t v) {
+    counter.store(counter.load(memory_order_relaxed) + v, memory_order_relaxed);
+}
+
+static void pin_to_cpu(unsigned cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        errno = rc;
+        perror("pthread_setaffinity_np");
+    }
+#else
+    (void)cpu; // No thread affinity API; the scheduler places the workers
+#endif
+}
+
+static volatile sig_atomic_t stop_workers = 0;
+
+// Merges the workers' counters into one StreamReport per stream
+class WorkerGroup {
+private:
+    vector<WorkerStats>& stats;
+    mutex end_lock;
+    uint64_t base_received = 0, base_syscalls = 0;
+    uint32_t base_ovfl = 0;
+    StreamReport last_report{END_SEQ, 0, 0, 0, 0, 0};
+
+    uint64_t total_received() const {
+        uint64_t sum = 0;
+        for (const WorkerStats& w : stats) sum += w.received.load(memory_order_relaxed);
+        return sum;
+    }
+
+public:
+    explicit WorkerGroup(vector<WorkerStats>& s) : stats(s) {}
+
+    // The END marker reaches one worker while datagrams sent before it may
+    // still sit in other workers' queues, so wait until the totals settle
+    StreamReport on_end() {
+        lock_guard<mutex> guard(end_lock);
+        uint64_t received = total_received();
+        for (uint64_t settled = UINT64_MAX; settled != received;) {
+            settled = received;
+            this_thread::sleep_for(chrono::milliseconds(10));
+            received = total_received();
+        }
+        if (received == base_received) return last_report; // Retried END
+
+        uint64_t syscalls = 0, first = UINT64_MAX, last = 0;
+        uint32_t ovfl = 0;
+        for (WorkerStats& w : stats) {
+            syscalls += w.syscalls.load(memory_order_relaxed);
+            first = min(first, w.first_ns.load(memory_order_relaxed));
+            last = max(last, w.last_ns.load(memory_order_relaxed));
+            ovfl += w.ovfl.load(memory_order_relaxed);
+            w.first_ns.store(UINT64_MAX, memory_order_relaxed);
+            w.last_ns.store(0, memory_order_relaxed);
+        }
+        // Sequence gaps are not tracked: flows interleave across workers
+        last_report = {END_SEQ, received - base_received, 0, syscalls - base_syscalls, last - first, ovfl - base_ovfl};
+        base_received = received;
+        base_syscalls = syscalls;
+        base_ovfl = ovfl;
+        return last_report;
+    }
+};
+
+static int run_workers(int port, size_t workers, size_t batch, bool gro, Steering steering, int busy_poll_us) {
+    unsigned cpus = max(1u, thread::hardware_concurrency());
+    vector<WorkerStats> stats(workers);
+    vector<int> socks;
+    for (size_t i = 0; i < workers; ++i) {
+        stats[i].cpu = (unsigned)(i % cpus);
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0) { perror("socket"); return 1; }
+        int one = 1;
+#ifdef SO_REUSEPORT
+        if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+            perror("setsockopt(SO_REUSEPORT)");
+            return 1;
+        }
+#else
+        cerr << "SO_REUSEPORT is not available, --workers needs it\n";
+        return 1;
+#endif
+        if (steering == Steering::Cpu) {
+#ifdef SO_INCOMING_CPU
+            int cpu = (int)stats[i].cpu;
+            if (setsockopt(sock, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0) {
+                perror("setsockopt(SO_INCOMING_CPU)");
+            }
+#else
+            cerr << "SO_INCOMING_CPU is not available, using hash steering\n";
+#endif
+        }
+        // Wake up now and then to notice shutdown
+        timeval tv{0, 100000};
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        configure_receive(sock, true, gro);
+        if (busy_poll_us > 0 && !enable_busy_poll(sock, busy_poll_us)) return 1;
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(port);
+        if (::bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) { perror("bind"); return 1; }
+        socks.push_back(sock);
+    }
+
+    if (steering == Steering::Bpf) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+        // Sockets are indexed in bind order, matching worker i on CPU i % cpus
+        sock_filter code[] = {
+            {BPF_LD | BPF_W | BPF_ABS, 0, 0, (uint32_t)(SKF_AD_OFF + SKF_AD_CPU)},
+            {BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t)workers},
+            {BPF_RET | BPF_A, 0, 0, 0},
+        };
+        sock_fprog prog{(unsigned short)(sizeof(code) / sizeof(code[0])), code};
+        if (setsockopt(socks[0], SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+            perror("setsockopt(SO_ATTACH_REUSEPORT_CBPF)");
+            return 1;
+        }
+#else
+        cerr << "Reuseport BPF is not available, using hash steering\n";
+#endif
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = [](int) { stop_workers = 1; };
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    WorkerGroup group(stats);
+    vector<thread> threads;
+    for (size_t i = 0; i < workers; ++i) {
+        threads.emplace_back([&, i] {
+            WorkerStats& w = stats[i];
+            pin_to_cpu(w.cpu);
+            BatchReceiver rx(batch, gro);
+            uint32_t ovfl_latest = 0;
+            auto account = [&w](uint64_t received, uint64_t now_ns) {
+                if (!received) return;
+                if (w.first_ns.load(memory_order_relaxed) == UINT64_MAX) w.first_ns.store(now_ns, memory_order_relaxed);
+                w.last_ns.store(now_ns, memory_order_relaxed);
+                add_relaxed(w.received, received);
+            };
+            while (!stop_workers) {
+                int n = rx.receive(socks[i]);
+                if (n < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+                    perror("recvmmsg");
+                    return;
+                }
+                add_relaxed(w.syscalls, 1);
+                uint64_t now_ns = pubsub::now_ns();
+                uint64_t received = 0;
+                for (int k = 0; k < n; ++k) {
+                    size_t len = rx.length(k);
+                    size_t seg = parse_cmsgs(rx.header(k), len, ovfl_latest);
+                    for (size_t off = 0; off + sizeof(Msg) <= len; off += seg) {
+                        Msg m;
+                        memcpy(&m, rx.data(k) + off, sizeof(m));
+                        if (m.seq != END_SEQ) {
+                            ++received;
+                            continue;
+                        }
+                        account(received, now_ns);
+                        received = 0;
+                        StreamReport report = group.on_end();
+                        sendto(socks[i], &report, sizeof(report), 0, (const sockaddr*)&rx.source(k), sizeof(sockaddr_in));
+                    }
+                }
+                account(received, now_ns);
+                w.ovfl.store(ovfl_latest, memory_order_relaxed);
+            }
+        });
+    }
+    for (thread& t : threads) t.join();
+
+    // Shutdown: per-worker totals, then merged
+    uint64_t received = 0, syscalls = 0, drops = 0;
+    for (size_t i = 0; i < workers; ++i) {
+        const WorkerStats& w = stats[i];
+        cout << "worker=" << i << " cpu=" << w.cpu
+             << " received=" << w.received.load()
+             << " syscalls=" << w.syscalls.load()
+             << " kernel_drops=" << w.ovfl.load() << "\n";
+        received += w.received.load();
+        syscalls += w.syscalls.load();
+        drops += w.ovfl.load();
+        close(socks[i]);
+    }
+    cout << "workers=" << workers << " steering=" << steering_name(steering)
+         << " received=" << received << " syscalls=" << syscalls << " kernel_drops=" << drops << "\n";
+    return 0;
+}
+
+// --reliable: in-order delivery for one publisher at a time. A new source
+// address is a new publisher run, whose sequence numbers start again at 0.
+class ReliableReceiver {
+private:
+    vector<Msg> early;     // Reorder buffer, indexed by seq % capacity
+    vector<bool> present;
+    sockaddr_in peer{};
+    uint64_t expected = 0;    // Next sequence number to deliver
+    uint64_t nacked_upto = 0; // Everything below has been Nacked or delivered
+
+    void reset(const sockaddr_in& src) {
+        peer = src;
+        expected = nacked_upto = 0;
+        fill(present.begin(), present.end(), false);
+    }
+
+public:
+    uint64_t delivered = 0, duplicates = 0, nacks = 0, overflows = 0;
+
+    explicit ReliableReceiver(size_t capacity) : early(capacity), present(capacity, false) {}
+
+    // Handles one data message; echo() is called for each message delivered
+    // (and for duplicates, whose earlier echo may have been lost)
+    template <typename Echo, typename SendNack>
+    void on_msg(const Msg& m, const sockaddr_in& src, Echo&& echo, SendNack&& send_nack) {
+        if (src.sin_addr.s_addr != peer.sin_addr.s_addr || src.sin_port != peer.sin_port) reset(src);
+        size_t capacity = early.size();
+
+        if (m.seq < expected) {
+            ++duplicates;
+            echo(m);
+            return;
+        }
+        if (m.seq == expected) {
+            echo(m);
+            ++expected;
+            ++delivered;
+            while (present[expected % capacity]) {
+                present[expected % capacity] = false;
+                echo(early[expected % capacity]);
+                ++expected;
+                ++delivered;
+            }
+            nacked_upto = max(nacked_upto, expected);
+            return;
+        }
+        if (m.seq - expected >= capacity) {
+            // No room; the publisher's timer resends it once the gap closes
+            ++overflows;
+            return;
+        }
+        if (present[m.seq % capacity]) {
+            ++duplicates;
+            return;
+        }
+        early[m.seq % capacity] = m;
+        present[m.seq % capacity] = true;
+        // Nack each missing range once; the publisher's timer covers lost Nacks
+        uint64_t first = max(nacked_upto, expected);
+        if (m.seq > first) {
+            send_nack(Nack{NACK_SEQ, first, m.seq - first});
+            ++nacks;
+        }
+        nacked_upto = max(nacked_upto, m.seq + 1);
+    }
+};
+
+static int run_reliable(int sock, size_t reorder_buffer, LossInjector& loss) {
+    ReliableReceiver rx(reorder_buffer);
+    // Wake up now and then to release datagrams the loss injector holds back
+    timeval tv{0, (suseconds_t)(REORDER_DELAY_NS / 1000)};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (true) {
+        Msg m;
+        sockaddr_in src{};
+        socklen_t srclen = sizeof(src);
+        ssize_t rec = recvfrom(sock, &m, sizeof(m), 0, (sockaddr*)&src, &srclen);
+        uint64_t now_ns = pubsub::now_ns();
+        loss.poll(sock, now_ns);
+        if (rec < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            perror("recvfrom");
+            return 1;
+        }
+        if (rec != sizeof(m)) continue;
+
+        rx.on_msg(
+            m, src,
+            [&](Msg reply) {
+                // set t_ns at reply time, as in plain ping-pong
+                reply.t_ns = now_ns;
+                loss.send(sock, &reply, sizeof(reply), src, now_ns);
+            },
+            [&](const Nack& nack) { loss.send(sock, &nack, sizeof(nack), src, now_ns); });
+    }
+}
+
+// --oneway: one-way latency per message; repeated END markers (the
+// publisher retries until every subscriber reported) get the same report
+static int run_oneway(int sock) {
+    pubsub::Histogram latencies;
+    uint64_t expected_seq = 0, gaps = 0;
+    LatencyReport last_report{END_SEQ, (uint64_t)getpid(), 0, 0, 0, 0, 0, 0};
+
+    while (true) {
+        Msg m;
+        sockaddr_in src{};
+        socklen_t srclen = sizeof(src);
+        ssize_t rec = recvfrom(sock, &m, sizeof(m), 0, (sockaddr*)&src, &srclen);
+        uint64_t now_ns = pubsub::now_ns();
+        if (rec < 0) {
+            if (errno == EINTR) continue;
+            perror("recvfrom");
+            return 1;
+        }
+        if (rec != sizeof(m)) continue;
+
+        if (m.seq == END_SEQ) {
+            if (latencies.count()) {
+                last_report = {END_SEQ, (uint64_t)getpid(), latencies.count(), gaps, (uint64_t)latencies.mean(),
+                               latencies.value_at_percentile(50), latencies.value_at_percentile(99),
+                               latencies.max()};
+                latencies.reset();
+                expected_seq = gaps = 0;
+            }
+            sendto(sock, &last_report, sizeof(last_report), 0, (sockaddr*)&src, srclen);
+            continue;
+        }
+        latencies.record(now_ns > m.t_ns ? now_ns - m.t_ns : 0);
+        if (m.seq > expected_seq) gaps += m.seq - expected_seq;
+        expected_seq = max(expected_seq, m.seq + 1);
+    }
+}
+
+#ifdef HAVE_IO_URING
+constexpr unsigned URING_DEPTH = 256;     // Submission queue entries
+constexpr unsigned URING_BUFFERS = 1024;  // Provided receive buffers (power of two)
+constexpr unsigned REPLY_SLOTS = 128;     // Echoes in flight at once
+constexpr uint16_t RECV_GROUP = 0;
+constexpr uint64_t RECV_TAG = UINT64_MAX; // user_data of the multishot receive; sends use their slot index
 
-struct Msg {
-    uint64_t seq;
-    uint64_t t_ns;
+// An outgoing echo or report. SENDMSG reads everything here asynchronously,
+// so a slot stays reserved until its completion arrives.
+struct ReplySlot {
+    char data[sizeof(StreamReport)];
+    size_t len;
+    sockaddr_in dst;
+    iovec iov;
+    msghdr hdr;
 };
 
+static int run_uring(int sock, bool sink, bool sqpoll) {
+    IoUring ring;
+    if (!ring.init(URING_DEPTH, sqpoll) || !ring.register_files(&sock, 1)) return 1;
+    ProvidedBufferRing bufs;
+    if (!bufs.init(ring, RECV_GROUP, URING_BUFFERS, MAX_DATAGRAM)) return 1;
+
+    // Only the lengths matter: they size the name and control areas the
+    // kernel lays out in front of each payload
+    msghdr tmpl{};
+    tmpl.msg_namelen = sizeof(sockaddr_in);
+    tmpl.msg_controllen = CMSG_SPACE(sizeof(uint32_t)); // SO_RXQ_OVFL
+
+    auto arm_recv = [&] {
+        io_uring_sqe* sqe;
+        while (!(sqe = ring.get_sqe())) ring.submit(0);
+        prep_recvmsg_multishot(sqe, 0, &tmpl, RECV_GROUP);
+        sqe->user_data = RECV_TAG;
+    };
+    arm_recv();
+
+    vector<ReplySlot> slots(REPLY_SLOTS);
+    vector<uint32_t> free_slots;
+    for (uint32_t i = 0; i < REPLY_SLOTS; ++i) free_slots.push_back(REPLY_SLOTS - 1 - i);
+    // Echoes that found no free slot wait here until sends complete
+    deque<ReplySlot> backlog;
+
+    auto queue_reply = [&](const void* data, size_t len, const sockaddr_in& dst) {
+        ReplySlot r;
+        memcpy(r.data, data, len);
+        r.len = len;
+        r.dst = dst;
+        backlog.push_back(r);
+    };
+
+    SinkState st;
+    bool ok = true;
+
+    while (ok) {
+        // Sends queued last round go out with the wait: one syscall per wakeup
+        ring.submit_and_wait();
+        io_uring_cqe* cqe = ring.wait_cqe();
+        if (!cqe) { perror("io_uring_enter"); return 1; }
+        uint64_t now_ns = pubsub::now_ns();
+
+        for (; cqe; ring.cqe_seen(), cqe = ring.peek_cqe()) {
+            if (cqe->user_data != RECV_TAG) {
+                if (cqe->res < 0) {
+                    errno = -cqe->res;
+                    perror("io_uring sendmsg");
+                }
+                free_slots.push_back((uint32_t)cqe->user_data);
+                continue;
+            }
+
+            if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+                errno = -cqe->res;
+                perror("io_uring recvmsg");
+                ok = false;
+                break;
+            }
+            if (cqe->flags & IORING_CQE_F_BUFFER) {
+                uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                char* buf = bufs.buffer(bid);
+                auto* out = reinterpret_cast<io_uring_recvmsg_out*>(buf);
+                char* name = buf + sizeof(*out);
+                char* control = name + tmpl.msg_namelen;
+                char* payload = control + tmpl.msg_controllen;
+
+                msghdr view{};
+                view.msg_control = control;
+                view.msg_controllen = out->controllen;
+                parse_cmsgs(view, out->payloadlen, st.ovfl_latest);
+
+                sockaddr_in src{};
+                memcpy(&src, name, min<size_t>(out->namelen, sizeof(src)));
+                if (out->payloadlen >= sizeof(Msg)) {
+                    Msg m;
+                    memcpy(&m, payload, sizeof(m));
+                    if (!sink) {
+                        m.t_ns = now_ns;
+                        queue_reply(&m, sizeof(m), src);
+                    } else if (m.seq == END_SEQ) {
+                        const StreamReport& report = st.on_end(ring.enters);
+                        queue_reply(&report, sizeof(report), src);
+                    } else {
+                        st.on_data(m, now_ns, ring.enters);
+                    }
+                }
+                bufs.recycle(bid);
+            }
+            // Multishot ends when the buffer ring runs dry (-ENOBUFS) or on error
+            if (!(cqe->flags & IORING_CQE_F_MORE)) arm_recv();
+        }
+
+        while (!backlog.empty() && !free_slots.empty()) {
+            io_uring_sqe* sqe = ring.get_sqe();
+            if (!sqe) break;
+            uint32_t idx = free_slots.back();
+            free_slots.pop_back();
+            ReplySlot& r = slots[idx];
+            r = backlog.front();
+            backlog.pop_front();
+            r.iov = {r.data, r.len};
+            r.hdr = msghdr{};
+            r.hdr.msg_name = &r.dst;
+            r.hdr.msg_namelen = sizeof(r.dst);
+            r.hdr.msg_iov = &r.iov;
+            r.hdr.msg_iovlen = 1;
+            prep_sendmsg(sqe, 0, &r.hdr);
+            sqe->user_data = idx;
+        }
+    }
+    return 1;
+}
+#endif
+
+#ifdef HAVE_TIMESTAMPING
+// --timestamping: echo each ping as a TimestampedEcho carrying our kernel RX
+// stamp and the time recvmsg() returned, so the publisher can split its RTT
+static int run_timestamped(int sock) {
+    if (!enable_timestamping(sock, false, false)) return 1;
+    alignas(cmsghdr) char control[TIMESTAMP_CONTROL];
+    char buf[MAX_DATAGRAM];
+    sockaddr_in src{};
+    iovec iov{buf, sizeof(buf)};
+
+    while (true) {
+        msghdr h{};
+        h.msg_name = &src;
+        h.msg_namelen = sizeof(src);
+        h.msg_iov = &iov;
+        h.msg_iovlen = 1;
+        h.msg_control = control;
+        h.msg_controllen = sizeof(control);
+        ssize_t rec = recvmsg(sock, &h, 0);
+        uint64_t rx_user = realtime_ns();
+        if (rec < 0) {
+            if (errno == EINTR) continue;
+            perror("recvmsg");
+            return 1;
+        }
+        if (rec < (ssize_t)sizeof(Msg)) continue;
+
+        Msg m;
+        memcpy(&m, buf, sizeof(m));
+        TimestampedEcho echo{m.seq, m.t_ns, parse_timestamps(h).sw_ns, rx_user};
+        sendto(sock, &echo, sizeof(echo), 0, (const sockaddr*)&src, sizeof(src));
+    }
+}
+#endif
+
 int main(int argc, char** argv) {
-    if (argc < 2) { cerr << "Usage: " << argv[0] << " <listen_port>\n"; return 1; }
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " <listen_port> [--sink] [--batch=N] [--gro] [--io=blocking|uring] [--sqpoll]"
+             << " [--reliable] [--reorder-buffer=N] [--loss=P] [--reorder=P] [--seed=N] [--oneway] [--group=IP]"
+             << " [--interface=IP] [--workers=N] [--steer=hash|cpu|bpf] [--busy-poll=US] [--timestamping]\n";
+        return 1;
+    }
     int port = stoi(argv[1]);
+    bool sink = false;
+    bool gro = false;
+    bool uring = false;
+    bool sqpoll = false;
+    bool reliable = false;
+    size_t batch = 1;
+    size_t reorder_buffer = DEFAULT_REORDER_BUFFER;
+    double loss_pct = 0, reorder_pct = 0;
+    uint64_t seed = DEFAULT_LOSS_SEED;
+    bool oneway = false;
+    string group, iface;
+    size_t workers = 0;
+    Steering steering = Steering::Hash;
+    int busy_poll_us = 0;
+    bool timestamping = false;
+    for (int a = 2; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "--sink") sink = true;
+        else if (arg.rfind("--busy-poll=", 0) == 0) busy_poll_us = max(0, stoi(arg.substr(12)));
+        else if (arg == "--timestamping") timestamping = true;
+        else if (arg.rfind("--workers=", 0) == 0) workers = max<size_t>(1, stoul(arg.substr(10)));
+        else if (arg == "--steer=hash") steering = Steering::Hash;
+        else if (arg == "--steer=cpu") steering = Steering::Cpu;
+        else if (arg == "--steer=bpf") steering = Steering::Bpf;
+        else if (arg == "--oneway") oneway = true;
+        else if (arg.rfind("--group=", 0) == 0) group = arg.substr(8), oneway = true;
+        else if (arg.rfind("--interface=", 0) == 0) iface = arg.substr(12);
+        else if (arg == "--reliable") reliable = true;
+        else if (arg.rfind("--reorder-buffer=", 0) == 0) reorder_buffer = max<size_t>(1, stoul(arg.substr(17)));
+        else if (arg.rfind("--loss=", 0) == 0) loss_pct = parse_percent(arg.substr(7));
+        else if (arg.rfind("--reorder=", 0) == 0) reorder_pct = parse_percent(arg.substr(10));
+        else if (arg.rfind("--seed=", 0) == 0) seed = stoull(arg.substr(7));
+        else if (arg == "--gro") gro = true;
+        else if (arg == "--sqpoll") sqpoll = true;
+        else if (arg == "--io=uring") uring = true;
+        else if (arg == "--io=blocking") uring = false;
+        else if (arg.rfind("--batch=", 0) == 0) batch = max<size_t>(1, stoul(arg.substr(8)));
+        else {
+            cerr << "Unknown option " << arg << "\n";
+            return 1;
+        }
+    }
+#ifndef HAVE_IO_URING
+    if (uring) {
+        cerr << "io_uring support not compiled in, using --io=blocking\n";
+        uring = false;
+    }
+#endif
+#ifndef HAVE_TIMESTAMPING
+    if (timestamping) {
+        cerr << "SO_TIMESTAMPING is only available on Linux, ignoring --timestamping\n";
+        timestamping = false;
+    }
+#endif
+    if (timestamping && (sink || uring || reliable || oneway || workers)) {
+        cerr << "--timestamping is a blocking ping-pong mode; it cannot be combined with --sink, --io=uring,"
+             << " --reliable, --oneway or --workers\n";
+        return 1;
+    }
+    if (workers && (!sink || uring)) {
+        cerr << "--workers needs --sink and the blocking engine\n";
+        return 1;
+    }
+    if (oneway && (sink || uring || reliable)) {
+        cerr << "--oneway/--group cannot be combined with --sink, --io=uring or --reliable\n";
+        return 1;
+    }
+    if (reliable && (sink || uring)) {
+        cerr << "--reliable is a blocking ping-pong mode; it cannot be combined with --sink or --io=uring\n";
+        return 1;
+    }
+    if (!reliable && (loss_pct > 0 || reorder_pct > 0)) {
+        cerr << "--loss/--reorder need --reliable, ignoring them\n";
+    }
+    if (uring && gro) {
+        // GRO super-datagrams would need MAX_GRO_BUFFER-sized provided buffers
+        cerr << "--gro is not supported with --io=uring, ignoring it\n";
+        gro = false;
+    }
+
+    if (workers) {
+        cout << "subscriber_udp listening on port " << port << " (sink) workers=" << workers
+             << " steering=" << steering_name(steering) << " batch=" << batch << (gro ? " gro" : "") << endl;
+        return run_workers(port, workers, batch, gro, steering, busy_poll_us);
+    }
 
     int sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock < 0) { perror("socket"); return 1; }
 
+    if (!group.empty()) {
+        // Every socket in the reuse group receives its own copy of each multicast datagram
+        int one = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+#ifdef SO_REUSEPORT
+        setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+#endif
+    }
+
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
     addr.sin_addr.s_addr = INADDR_ANY;
     addr.sin_port = htons(port);
     if (::bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) { perror("bind"); return 1; }
 
-    cout << "subscriber_udp listening on port " << port << "\n";
-    while (true) {
-        sockaddr_in src{};
-        socklen_t srclen = sizeof(src);
-        Msg m;
-        ssize_t rec = recvfrom(sock, &m, sizeof(m), 0, (sockaddr*)&src, &srclen);
-        if (rec <= 0) { perror("recvfrom"); break; }
-        // set t_ns at reply time (so publisher can compute RTT)
-        m.t_ns = (uint64_t)chrono::duration_cast<ns>(clk::now().time_since_epoch()).count();
-        ssize_t sent = sendto(sock, &m, sizeof(m), 0, (sockaddr*)&src, srclen);
-        if (sent != sizeof(m)) { perror("sendto"); break; }
+    if (!group.empty()) {
+        ip_mreq mreq{};
+        if (inet_pton(AF_INET, group.c_str(), &mreq.imr_multiaddr) != 1) {
+            cerr << "Invalid multicast group " << group << "\n";
+            return 1;
+        }
+        mreq.imr_interface.s_addr = INADDR_ANY;
+        if (!iface.empty()) inet_pton(AF_INET, iface.c_str(), &mreq.imr_interface);
+        if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            perror("setsockopt(IP_ADD_MEMBERSHIP)");
+            return 1;
+        }
+    }
+
+    if (oneway) {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &SINK_RCVBUF, sizeof(SINK_RCVBUF));
     }
+    configure_receive(sock, sink, gro);
+    if (busy_poll_us > 0 && !enable_busy_poll(sock, busy_poll_us)) return 1;
+
+    cout << "subscriber_udp listening on port " << port << (sink ? " (sink)" : "");
+    if (busy_poll_us > 0) cout << " busy_poll_us=" << busy_poll_us;
+    if (oneway) cout << " oneway" << (group.empty() ? "" : " group=" + group) << "\n";
+    else if (reliable) cout << " reliable reorder_buffer=" << reorder_buffer << " loss=" << loss_pct << "% reorder=" << reorder_pct << "%\n";
+    else if (uring) cout << " io=uring" << (sqpoll ? " sqpoll" : "") << "\n";
+    else if (timestamping) cout << " timestamping\n";
+    else cout << " batch=" << batch << (gro ? " gro" : "") << "\n";
+    cout.flush();
+
+    int rc;
+    if (oneway) {
+        rc = run_oneway(sock);
+    } else if (reliable) {
+        // Offset the seed so our pattern differs from a publisher using the same one
+        LossInjector loss(loss_pct, reorder_pct, seed + 1);
+        rc = run_reliable(sock, reorder_buffer, loss);
+    }
+#ifdef HAVE_IO_URING
+    else if (uring) rc = run_uring(sock, sink, sqpoll);
+#endif
+#ifdef HAVE_TIMESTAMPING
+    else if (timestamping) rc = run_timestamped(sock);
+#endif
+    else rc = run_blocking(sock, sink, batch, gro);
 
     close(sock);
-    return 0;
+    return rc;
 }
@@ -0,0 +1,151 @@
+// Kernel busy polling and SO_TIMESTAMPING for the UDP binaries
+//
+// --busy-poll=US sets SO_BUSY_POLL (and SO_PREFER_BUSY_POLL): a blocking
+// receive spins on the device queue for up to US microseconds before
+// sleeping, which trades a core for the wakeup latency. It only acts on
+// NAPI-driven devices; loopback has none, so there it changes nothing.
+//
+// --timestamping asks the kernel to stamp each datagram in software where it
+// enters and leaves the stack (SCM_TIMESTAMPING, CLOCK_REALTIME). TX stamps
+// come back on the socket error queue, tagged with a per-socket counter
+// (SOF_TIMESTAMPING_OPT_ID). With --hw-timestamps=IFACE the NIC is told to
+// stamp too (SIOCSHWTSTAMP), and its raw PHC stamps are reported next to the
+// software ones. PHC time is not CLOCK_REALTIME, so hardware stamps are only
+// compared with each other.
+
+#pragma once
+
+#include <sys/socket.h>
+#include <time.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#define HAVE_TIMESTAMPING 1
+#endif
+
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+// Subscriber -> publisher echo in --timestamping mode: the ping's own fields
+// plus when it reached the subscriber's kernel and userspace
+struct TimestampedEcho {
+    uint64_t seq;
+    uint64_t t_ns;         // Publisher's send time, echoed back unchanged
+    uint64_t rx_kernel_ns; // Subscriber's software RX stamp, 0 if none
+    uint64_t rx_user_ns;   // Subscriber's clock when recvmsg() returned
+};
+
+// Same clock as the kernel's software stamps
+inline uint64_t realtime_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1'000'000'000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Returns false (after perror) if the option is not supported
+inline bool enable_busy_poll(int sock, int usec) {
+#ifdef SO_BUSY_POLL
+    if (setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0) {
+        perror("setsockopt(SO_BUSY_POLL)");
+        return false;
+    }
+    int one = 1;
+    // Older kernels lack it; plain SO_BUSY_POLL still works there
+    setsockopt(sock, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one));
+    return true;
+#else
+    (void)sock;
+    (void)usec;
+    fprintf(stderr, "SO_BUSY_POLL is only available on Linux\n");
+    return false;
+#endif
+}
+
+// One datagram's kernel stamps; 0 where the kernel gave none
+struct KernelStamps {
+    uint64_t sw_ns = 0;
+    uint64_t hw_ns = 0;
+    uint32_t id = 0; // TX only: OPT_ID counter, i.e. the socket's n-th send
+};
+
+#ifdef HAVE_TIMESTAMPING
+
+// Asks the NIC behind `iface` to stamp all TX and RX packets
+inline bool enable_hw_timestamps(int sock, const std::string& iface) {
+    hwtstamp_config cfg{};
+    cfg.tx_type = HWTSTAMP_TX_ON;
+    cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+    ifreq ifr{};
+    strncpy(ifr.ifr_name, iface.c_str(), sizeof(ifr.ifr_name) - 1);
+    ifr.ifr_data = reinterpret_cast<char*>(&cfg);
+    if (ioctl(sock, SIOCSHWTSTAMP, &ifr) < 0) {
+        perror("ioctl(SIOCSHWTSTAMP)");
+        return false;
+    }
+    return true;
+}
+
+// With `tx` false only received datagrams are stamped, so a side that never
+// reads its error queue does not fill it up
+inline bool enable_timestamping(int sock, bool hardware, bool tx = true) {
+    int flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+    if (tx) flags |= SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (hardware) flags |= SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE;
+    if (hardware && tx) flags |= SOF_TIMESTAMPING_TX_HARDWARE;
+    if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+        perror("setsockopt(SO_TIMESTAMPING)");
+        return false;
+    }
+    return true;
+}
+
+// Control space for one SCM_TIMESTAMPING plus one IP_RECVERR (TX) message
+constexpr size_t TIMESTAMP_CONTROL = CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(sock_extended_err)) + 64;
+
+inline uint64_t timespec_ns(const timespec& ts) {
+    return (uint64_t)ts.tv_sec * 1'000'000'000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Picks SCM_TIMESTAMPING (ts[0] software, ts[2] raw hardware) and, on the
+// error queue, the OPT_ID of the send it belongs to
+inline KernelStamps parse_timestamps(msghdr& h) {
+    KernelStamps out;
+    for (cmsghdr* c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(&h, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPING) {
+            scm_timestamping ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            out.sw_ns = timespec_ns(ts.ts[0]);
+            out.hw_ns = timespec_ns(ts.ts[2]);
+        } else if (c->cmsg_level == IPPROTO_IP && c->cmsg_type == IP_RECVERR) {
+            sock_extended_err err;
+            memcpy(&err, CMSG_DATA(c), sizeof(err));
+            if (err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) out.id = err.ee_data;
+        }
+    }
+    return out;
+}
+
+// Next TX stamp from the error queue, without blocking. Software and
+// hardware stamps of one send arrive as separate messages.
+inline bool read_tx_timestamp(int sock, KernelStamps& out) {
+    alignas(cmsghdr) char control[TIMESTAMP_CONTROL];
+    msghdr h{};
+    h.msg_control = control;
+    h.msg_controllen = sizeof(control);
+    if (recvmsg(sock, &h, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return false;
+    out = parse_timestamps(h);
+    return true;
+}
+
+#endif // HAVE_TIMESTAMPING
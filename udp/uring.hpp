@@ -0,0 +1,339 @@
+// Minimal io_uring wrapper for the UDP binaries
+//
+// Talks to the kernel through the raw io_uring_setup/enter/register syscalls
+// and <linux/io_uring.h>, so there is no liburing dependency. It covers what
+// the UDP engine needs: the submission/completion rings, registered files and
+// buffers, provided buffer rings for multishot receive, and optional SQPOLL.
+//
+// HAVE_IO_URING is defined when the kernel headers are new enough (multishot
+// recvmsg and buffer rings, Linux 6.0+); the binaries fall back to the
+// blocking path otherwise.
+
+#pragma once
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+// Multishot recv (6.0) postdates buffer rings (5.19), and the latter is an
+// enum rather than a macro, so this one check covers both
+#ifdef IORING_RECV_MULTISHOT
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+constexpr unsigned SQPOLL_IDLE_MS = 2000; // Kernel poller sleeps after this long without work
+constexpr unsigned SQPOLL_SPINS = 4096;   // CQ polls before blocking in the kernel, e.g. when the poller shares our core
+
+class IoUring {
+private:
+    int ring_fd = -1;
+    bool sqpoll = false;
+    unsigned sq_entries = 0;
+
+    void* sq_ptr = MAP_FAILED;
+    size_t sq_len = 0;
+    void* cq_ptr = MAP_FAILED;
+    size_t cq_len = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_len = 0;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_flags;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    unsigned sqe_tail = 0;    // SQEs handed out by get_sqe()
+    unsigned flushed_tail = 0; // SQEs made visible to the kernel
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        ++enters;
+        int rc = (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+        return rc < 0 ? -errno : rc;
+    }
+
+    int do_register(unsigned opcode, const void* arg, unsigned nr) {
+        return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr);
+    }
+
+    static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+public:
+    uint64_t enters = 0; // io_uring_enter() calls: the data-path syscalls
+
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqes_len);
+        if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr) munmap(cq_ptr, cq_len);
+        if (sq_ptr != MAP_FAILED) munmap(sq_ptr, sq_len);
+        if (ring_fd >= 0) close(ring_fd);
+    }
+
+    // Returns false (after perror) if io_uring is unavailable or disabled
+    bool init(unsigned entries, bool use_sqpoll) {
+        io_uring_params p{};
+        if (use_sqpoll) {
+            p.flags |= IORING_SETUP_SQPOLL;
+            p.sq_thread_idle = SQPOLL_IDLE_MS;
+        }
+        ring_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (ring_fd < 0) { perror("io_uring_setup"); return false; }
+        sqpoll = use_sqpoll;
+        sq_entries = p.sq_entries;
+
+        sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) sq_len = cq_len = sq_len > cq_len ? sq_len : cq_len;
+
+        sq_ptr = mmap(nullptr, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ptr == MAP_FAILED) { perror("mmap(sq ring)"); return false; }
+        cq_ptr = single_mmap ? sq_ptr
+                             : mmap(nullptr, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                                    IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) { perror("mmap(cq ring)"); return false; }
+        sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(
+            mmap(nullptr, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) { perror("mmap(sqes)"); return false; }
+
+        char* sq = static_cast<char*>(sq_ptr);
+        sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_flags = reinterpret_cast<unsigned*>(sq + p.sq_off.flags);
+        // Identity mapping: SQE i always sits in array slot i
+        unsigned* sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        for (unsigned i = 0; i < p.sq_entries; ++i) sq_array[i] = i;
+
+        char* cq = static_cast<char*>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        sqe_tail = flushed_tail = *sq_tail;
+        return true;
+    }
+
+    bool register_files(const int* fds, unsigned n) {
+        if (do_register(IORING_REGISTER_FILES, fds, n) < 0) { perror("io_uring_register(files)"); return false; }
+        return true;
+    }
+
+    bool register_buffers(const iovec* iovs, unsigned n) {
+        if (do_register(IORING_REGISTER_BUFFERS, iovs, n) < 0) { perror("io_uring_register(buffers)"); return false; }
+        return true;
+    }
+
+    bool register_buffer_ring(const io_uring_buf_reg& reg) {
+        if (do_register(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) { perror("io_uring_register(pbuf ring)"); return false; }
+        return true;
+    }
+
+    // Zeroed SQE to fill in, or nullptr if the submission queue is full
+    io_uring_sqe* get_sqe() {
+        unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (sqe_tail - head >= sq_entries) return nullptr;
+        io_uring_sqe* sqe = &sqes[sqe_tail & *sq_mask];
+        memset(sqe, 0, sizeof(*sqe));
+        ++sqe_tail;
+        return sqe;
+    }
+
+    // Publishes queued SQEs and, if wait_nr > 0, blocks until that many
+    // completions are available. With SQPOLL this only enters the kernel to
+    // wake a sleeping poller or to block; otherwise one syscall does both.
+    int submit(unsigned wait_nr = 0) {
+        unsigned to_submit = sqe_tail - flushed_tail;
+        if (to_submit) {
+            __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+            flushed_tail = sqe_tail;
+        }
+        unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+        if (sqpoll) {
+            // Order the tail store before reading the poller's wakeup flag
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (__atomic_load_n(sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP) flags |= IORING_ENTER_SQ_WAKEUP;
+            if (!flags) return 0;
+        } else if (!to_submit && !wait_nr) {
+            return 0;
+        }
+        return enter(to_submit, wait_nr, flags);
+    }
+
+    // Flushes queued SQEs and blocks for at least one completion in a single
+    // io_uring_enter(); under SQPOLL only flushes (wait_cqe() then spins).
+    int submit_and_wait() {
+        return submit(sqpoll ? 0 : 1);
+    }
+
+    io_uring_cqe* peek_cqe() {
+        unsigned head = *cq_head;
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return nullptr;
+        return &cqes[head & *cq_mask];
+    }
+
+    void cqe_seen() {
+        __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+    }
+
+    // Next completion. Under SQPOLL we spin on the CQ ring instead of
+    // sleeping in the kernel, so the steady state makes no syscalls at all;
+    // only a completion that takes longer than SQPOLL_SPINS polls blocks.
+    io_uring_cqe* wait_cqe() {
+        io_uring_cqe* cqe;
+        unsigned spins = 0;
+        while (!(cqe = peek_cqe())) {
+            if (sqpoll && ++spins < SQPOLL_SPINS) {
+                submit(0);
+                cpu_relax();
+            } else {
+                int rc = submit(1);
+                if (rc < 0 && rc != -EINTR && rc != -EAGAIN && rc != -EBUSY) return nullptr;
+            }
+        }
+        return cqe;
+    }
+};
+
+// Provided buffer ring (IORING_REGISTER_PBUF_RING): the kernel picks a free
+// buffer for each multishot completion and reports its id in the CQE flags.
+class ProvidedBufferRing {
+private:
+    // Addressed as a plain io_uring_buf array: in C++ the header's
+    // __DECLARE_FLEX_ARRAY puts io_uring_buf_ring::bufs 8 bytes past the
+    // ring start. The kernel reads the tail from bufs[0].resv.
+    io_uring_buf* bufs = static_cast<io_uring_buf*>(MAP_FAILED);
+    size_t ring_len = 0;
+    char* storage = static_cast<char*>(MAP_FAILED);
+    size_t storage_len = 0;
+    unsigned entries = 0;
+    uint16_t tail = 0;
+
+    void add(uint16_t bid) {
+        io_uring_buf* b = &bufs[tail & (entries - 1)];
+        b->addr = (uint64_t)(uintptr_t)buffer(bid);
+        b->len = (uint32_t)buf_size;
+        b->bid = bid;
+        ++tail;
+    }
+
+    void publish() { __atomic_store_n(&bufs[0].resv, tail, __ATOMIC_RELEASE); }
+
+public:
+    size_t buf_size = 0;
+    uint16_t group = 0;
+
+    ProvidedBufferRing() = default;
+    ProvidedBufferRing(const ProvidedBufferRing&) = delete;
+    ProvidedBufferRing& operator=(const ProvidedBufferRing&) = delete;
+
+    ~ProvidedBufferRing() {
+        if (storage != MAP_FAILED) munmap(storage, storage_len);
+        if (bufs != MAP_FAILED) munmap(bufs, ring_len);
+    }
+
+    // `count` must be a power of two
+    bool init(IoUring& uring, uint16_t group_id, unsigned count, size_t size) {
+        entries = count;
+        buf_size = size;
+        group = group_id;
+        ring_len = count * sizeof(io_uring_buf);
+        bufs = static_cast<io_uring_buf*>(
+            mmap(nullptr, ring_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        storage_len = count * size;
+        storage = static_cast<char*>(
+            mmap(nullptr, storage_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0));
+        if (bufs == MAP_FAILED || storage == MAP_FAILED) { perror("mmap(buffer ring)"); return false; }
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = (uint64_t)(uintptr_t)bufs;
+        reg.ring_entries = count;
+        reg.bgid = group_id;
+        if (!uring.register_buffer_ring(reg)) return false;
+
+        for (unsigned i = 0; i < count; ++i) add((uint16_t)i);
+        publish();
+        return true;
+    }
+
+    char* buffer(uint16_t bid) { return storage + (size_t)bid * buf_size; }
+
+    // Hands a consumed buffer back to the kernel
+    void recycle(uint16_t bid) {
+        add(bid);
+        publish();
+    }
+};
+
+// Multishot receive with the sender's address: each completion lands in a
+// provided buffer laid out as io_uring_recvmsg_out | name | control | payload,
+// with name/control sized by `tmpl`.
+inline void prep_recvmsg_multishot(io_uring_sqe* sqe, int file_index, msghdr* tmpl, uint16_t group) {
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = file_index;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->addr = (uint64_t)(uintptr_t)tmpl;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = group;
+}
+
+// Multishot receive on a connected socket: the buffer holds only the payload
+inline void prep_recv_multishot(io_uring_sqe* sqe, int file_index, uint16_t group) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = file_index;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = group;
+}
+
+inline void prep_sendmsg(io_uring_sqe* sqe, int file_index, const msghdr* msg) {
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = file_index;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+}
+
+// write() from a registered buffer; on a connected UDP socket that is one datagram
+inline void prep_write_fixed(io_uring_sqe* sqe, int file_index, const void* buf, unsigned len, uint16_t buf_index) {
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->fd = file_index;
+    sqe->flags = IOSQE_FIXED_FILE;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->buf_index = buf_index;
+}
+
+#endif // HAVE_IO_URING
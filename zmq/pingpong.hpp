@@ -0,0 +1,168 @@
+// REQ-REP ping-pong pieces shared by zmq_publisher and zmq_subscriber, and
+// the DEALER-ROUTER variant that keeps a window of requests in flight
+//
+// MessagePool is a fixed arena of equally sized buffers for zero-copy sends:
+// a message built over a pool buffer carries a free function that hands the
+// buffer back once libzmq is done with it, on whichever thread that happens
+// (an I/O thread for tcp/ipc, the receiving thread for inproc).
+//
+// ContextOptions covers the context/socket knobs worth sweeping:
+//   --io-threads=N     ZMQ_IO_THREADS (default 1; inproc needs none)
+//   --io-cpus=A,B,...  pin the I/O threads (ZMQ_THREAD_AFFINITY_CPU_ADD)
+//   --affinity=MASK    ZMQ_AFFINITY: which I/O threads serve this socket
+
+#pragma once
+
+#include <zmq.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../common/clock.hpp"
+
+constexpr size_t MIN_PAYLOAD = sizeof(int64_t); // The send timestamp
+constexpr size_t MAX_PAYLOAD = 1 << 20;
+constexpr size_t POOL_BUFFERS = 16;             // Ping-pong has at most two messages in flight
+constexpr size_t POOL_MAX_BYTES = 64 << 20;     // Arena cap; sends past it fall back to copies
+constexpr const char* DEFAULT_PINGPONG_CONNECT = "tcp://127.0.0.1:5556";
+constexpr const char* DEFAULT_PINGPONG_BIND = "tcp://*:5556";
+constexpr int MAX_WINDOW = 1024;                // Outstanding DEALER requests
+
+class MessagePool {
+private:
+    struct alignas(64) Slot {
+        std::atomic<bool> in_use{false};
+        char* data = nullptr;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<char> storage;
+    size_t next = 0;
+
+    static void release(void*, void* hint) {
+        static_cast<Slot*>(hint)->in_use.store(false, std::memory_order_release);
+    }
+
+public:
+    MessagePool(size_t size, size_t count = POOL_BUFFERS) : slots(count), storage(size * count) {
+        for (size_t i = 0; i < count; ++i) slots[i].data = storage.data() + i * size;
+    }
+
+    // `wanted` buffers of `size` bytes, cut down to fit POOL_MAX_BYTES
+    static size_t buffers_for(size_t size, size_t wanted) {
+        return std::max<size_t>(1, std::min(wanted, POOL_MAX_BYTES / std::max<size_t>(1, size)));
+    }
+
+    MessagePool(const MessagePool&) = delete;
+    MessagePool& operator=(const MessagePool&) = delete;
+
+    // Points `msg` at a free buffer without copying anything; the caller
+    // then writes into msg.data() in place. False if every buffer is still
+    // in flight.
+    bool wrap(zmq::message_t& msg, size_t len) {
+        for (size_t tried = 0; tried < slots.size(); ++tried) {
+            Slot& slot = slots[next];
+            next = (next + 1) % slots.size();
+            if (slot.in_use.load(std::memory_order_acquire)) continue;
+            slot.in_use.store(true, std::memory_order_relaxed);
+            msg = zmq::message_t(slot.data, len, &release, &slot);
+            return true;
+        }
+        return false;
+    }
+};
+
+struct ContextOptions {
+    int io_threads = 1;
+    std::vector<int> io_cpus;
+    uint64_t affinity = 0; // 0: any I/O thread
+
+    // Consumes `arg` if it is one of ours
+    bool parse(const std::string& arg) {
+        if (arg.rfind("--io-threads=", 0) == 0) {
+            io_threads = std::max(0, std::stoi(arg.substr(13)));
+        } else if (arg.rfind("--io-cpus=", 0) == 0) {
+            std::stringstream list(arg.substr(10));
+            std::string cpu;
+            while (std::getline(list, cpu, ',')) io_cpus.push_back(std::stoi(cpu));
+        } else if (arg.rfind("--affinity=", 0) == 0) {
+            affinity = std::stoull(arg.substr(11), nullptr, 0);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Construct the context with `io_threads`, then call this before its
+    // first socket starts the I/O threads
+    void apply(zmq::context_t& ctx) const {
+        for (int cpu : io_cpus) {
+#ifdef ZMQ_THREAD_AFFINITY_CPU_ADD
+            if (zmq_ctx_set(ctx.handle(), ZMQ_THREAD_AFFINITY_CPU_ADD, cpu) != 0) {
+                std::cerr << "ZMQ_THREAD_AFFINITY_CPU_ADD " << cpu << ": " << zmq_strerror(zmq_errno()) << "\n";
+            }
+#else
+            std::cerr << "libzmq lacks ZMQ_THREAD_AFFINITY_CPU_ADD, ignoring --io-cpus=" << cpu << "\n";
+#endif
+        }
+    }
+
+    void apply(zmq::socket_t& sock) const {
+        if (affinity) sock.set(zmq::sockopt::affinity, affinity);
+    }
+};
+
+// REP side: echo every request with the first 8 bytes replaced by our
+// receive time. With zero_copy the received message itself goes back, so the
+// payload is never copied; otherwise it is copied into a new message like an
+// application that builds its reply would. Returns when the context shuts
+// down (inproc) and loops forever otherwise.
+inline void echo_loop(zmq::socket_t& sock, bool zero_copy) {
+    try {
+        while (true) {
+            zmq::message_t msg;
+            if (!sock.recv(msg)) continue;
+            uint64_t echo_ts = pubsub::now_ns();
+            if (zero_copy) {
+                if (msg.size() >= sizeof(echo_ts)) memcpy(msg.data(), &echo_ts, sizeof(echo_ts));
+                sock.send(msg, zmq::send_flags::none);
+            } else {
+                zmq::message_t reply(msg.data(), msg.size());
+                if (reply.size() >= sizeof(echo_ts)) memcpy(reply.data(), &echo_ts, sizeof(echo_ts));
+                sock.send(reply, zmq::send_flags::none);
+            }
+        }
+    } catch (const zmq::error_t& e) {
+        if (e.num() != ETERM) throw;
+    }
+}
+
+// ROUTER side of the windowed mode: each request arrives as [routing id]
+// [payload] and goes back unchanged to the same peer. The DEALER matches
+// replies by the sequence number in the payload, so nothing is stamped here.
+// Without zero_copy the payload is copied into a new reply, as in echo_loop.
+inline void router_echo_loop(zmq::socket_t& sock, bool zero_copy) {
+    try {
+        while (true) {
+            zmq::message_t id, msg;
+            if (!sock.recv(id)) continue;
+            if (!id.more() || !sock.recv(msg)) continue;
+            sock.send(id, zmq::send_flags::sndmore);
+            if (zero_copy) {
+                sock.send(msg, zmq::send_flags::none);
+            } else {
+                zmq::message_t reply(msg.data(), msg.size());
+                sock.send(reply, zmq::send_flags::none);
+            }
+        }
+    } catch (const zmq::error_t& e) {
+        if (e.num() != ETERM) throw;
+    }
+}
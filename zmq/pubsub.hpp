@@ -0,0 +1,89 @@
+// PUB/SUB wire format shared by zmq_publisher, zmq_subscriber and zmq_proxy
+// (--pubsub)
+//
+// A data message is one frame: a TOPIC_LEN-byte topic name ("t000".."t999")
+// followed by a TopicMsg. ZeroMQ matches subscriptions as byte prefixes of
+// the frame, so "t003" selects one topic and "t00" the ten topics t000-t009.
+// Single frames also keep ZMQ_CONFLATE usable (it drops multipart messages).
+//
+// Two control topics, to which every subscriber subscribes, frame a run:
+//   SYNC  repeated by the publisher until --subscribers=N of them answered
+//         Ready, so no subscription is still in flight when timing starts
+//   END!  the run is over; each subscriber answers with a PubSubReport
+// Answers go over a PUSH socket to the publisher's PULL report endpoint. A
+// report ends with the subscriber's latency histogram, which the publisher
+// merges across subscribers for fleet-wide percentiles.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+constexpr size_t TOPIC_LEN = 4;
+constexpr int MAX_TOPICS = 1000;
+constexpr char SYNC_TOPIC[] = "SYNC";
+constexpr char END_TOPIC[] = "END!";
+
+constexpr const char* DEFAULT_DATA_BIND = "tcp://*:5556";
+constexpr const char* DEFAULT_DATA_CONNECT = "tcp://127.0.0.1:5556";
+constexpr const char* DEFAULT_REPORT_BIND = "tcp://*:5557";
+constexpr const char* DEFAULT_REPORT_CONNECT = "tcp://127.0.0.1:5557";
+constexpr const char* DEFAULT_PROXY_FRONTEND = "tcp://*:5558"; // XSUB: publishers connect here
+constexpr const char* DEFAULT_PROXY_BACKEND = "tcp://*:5559";  // XPUB: subscribers connect here
+
+struct TopicMsg {
+    uint64_t seq;  // Per topic, so each subscriber can count its own drops
+    uint64_t t_ns; // Publisher's send time
+};
+
+constexpr size_t DATA_FRAME = TOPIC_LEN + sizeof(TopicMsg);
+
+// Subscriber -> publisher on the report channel
+enum class ReportKind : uint64_t { Ready = 1, Report = 2 };
+
+struct Ready {
+    ReportKind kind; // Ready
+    uint64_t id;     // Subscriber pid
+};
+
+// Answer to END!, followed by `topics` TopicReport entries, then the one-way
+// latency over all topics as a pubsub::Histogram (encode(), ns)
+struct PubSubReport {
+    ReportKind kind;     // Report
+    uint64_t id;         // Subscriber pid
+    uint64_t received;   // Data messages this run
+    uint64_t gaps;       // Per-topic sequence numbers skipped (HWM or conflate drops)
+    uint64_t elapsed_ns; // First to last data message
+    uint64_t p50_ns;     // One-way latency over all topics
+    uint64_t p99_ns;
+    uint64_t max_ns;
+    uint64_t topics;
+};
+
+struct TopicReport {
+    uint64_t topic;
+    uint64_t received;
+    uint64_t gaps;
+    uint64_t next_seq; // One past the last seq seen: the publisher adds tail drops
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+};
+
+inline std::string topic_name(int topic) {
+    char name[8];
+    snprintf(name, sizeof(name), "t%03d", topic);
+    return name;
+}
+
+// Topic index of a data frame, or -1 for control topics
+inline int topic_index(const char* frame) {
+    if (frame[0] != 't') return -1;
+    int topic = 0;
+    for (size_t i = 1; i < TOPIC_LEN; ++i) {
+        if (frame[i] < '0' || frame[i] > '9') return -1;
+        topic = topic * 10 + (frame[i] - '0');
+    }
+    return topic;
+}
@@ -0,0 +1,55 @@
+// Usage: ./zmq_proxy [--frontend=EP] [--backend=EP] [--hwm=N]
+// XSUB/XPUB forwarder for the --pubsub mode: publishers connect to the
+// frontend (default tcp://*:5558), subscribers to the backend (default
+// tcp://*:5559). Subscriptions flow upstream through the XPUB/XSUB pair, so
+// filtering still happens at the publisher. --hwm=N sets the high-water
+// marks on both sides (default 1000); a slow subscriber then loses messages
+// at the proxy instead of at the publisher.
+
+#include <zmq.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include "pubsub.hpp"
+
+using namespace std;
+
+constexpr int DEFAULT_HWM = 1000; // libzmq's own default
+
+int main(int argc, char** argv) {
+    string frontend_ep = DEFAULT_PROXY_FRONTEND;
+    string backend_ep = DEFAULT_PROXY_BACKEND;
+    int hwm = DEFAULT_HWM;
+    for (int a = 1; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg.rfind("--frontend=", 0) == 0) frontend_ep = arg.substr(11);
+        else if (arg.rfind("--backend=", 0) == 0) backend_ep = arg.substr(10);
+        else if (arg.rfind("--hwm=", 0) == 0) hwm = max(0, stoi(arg.substr(6)));
+        else {
+            cerr << "Usage: " << argv[0] << " [--frontend=EP] [--backend=EP] [--hwm=N]\n";
+            return 1;
+        }
+    }
+
+    zmq::context_t ctx{1};
+    zmq::socket_t frontend(ctx, zmq::socket_type::xsub);
+    zmq::socket_t backend(ctx, zmq::socket_type::xpub);
+    for (zmq::socket_t* sock : {&frontend, &backend}) {
+        sock->set(zmq::sockopt::sndhwm, hwm);
+        sock->set(zmq::sockopt::rcvhwm, hwm);
+    }
+    frontend.bind(frontend_ep);
+    backend.bind(backend_ep);
+
+    cout << "ZeroMQ proxy " << frontend_ep << " (XSUB) -> " << backend_ep << " (XPUB) hwm=" << hwm << "\n";
+    cout.flush();
+
+    try {
+        zmq::proxy(frontend, backend);
+    } catch (const zmq::error_t& e) {
+        cerr << "zmq_proxy: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
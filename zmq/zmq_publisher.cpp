@@ -1,74 +1,437 @@
-// Usage: ./zmq_publisher <count>
+// Usage: ./zmq_publisher <count> [--payload=N] [--endpoint=EP] [--zero-copy] [--io-threads=N]
+//                        [--io-cpus=A,B] [--affinity=MASK]
+//        ./zmq_publisher <count> --window=N [--payload=N] [--endpoint=EP] [--zero-copy] ...
+//        ./zmq_publisher <count> --pubsub [--subscribers=N] [--topics=N] [--hwm=N]
+//                        [--interval-us=N] [--bind=EP | --connect=EP] [--report=EP]
 // ZeroMQ REQ-REP ping-pong latency test
+//
+// --payload=N  request size in bytes, 8 B to 1 MiB (default 8: the timestamp)
+// --endpoint=EP  where the REP subscriber listens (default
+//            tcp://127.0.0.1:5556); ipc://path works the same way, and an
+//            inproc://name endpoint runs the echo on a second thread here
+// --zero-copy  build each request in a MessagePool buffer (see
+//            pingpong.hpp) that libzmq takes over instead of copying
+// --io-threads=N, --io-cpus=A,B, --affinity=MASK  ZMQ_IO_THREADS, I/O thread
+//            CPU pinning and the socket's I/O thread mask
+//
+// --window=N DEALER instead of REQ, against zmq_subscriber --router: keep up
+//            to N (1-1024) requests in flight, each carrying its sequence
+//            number, and time every reply against that sequence's send time.
+//            Prints msgs/sec and p50/p99/p99.9/p99.99 RTT for the window.
+//
+// --pubsub   PUB/SUB fan-out instead (see pubsub.hpp): send <count> messages
+//            round-robin over --topics=N topics (default 8) to whatever
+//            subscribers are connected, then collect a report from each of
+//            --subscribers=N (default 1). Prints per-subscriber and per-topic
+//            throughput, one-way latency and drops, and percentiles over all
+//            subscribers from their latency histograms merged.
+// --hwm=N    ZMQ_SNDHWM of the PUB socket (default 1000). A subscriber whose
+//            queue is full loses messages: PUB never blocks.
+// --interval-us=N  pace sends (default 0: as fast as possible)
+// --bind=EP  data endpoint to bind (default tcp://*:5556); --connect=EP
+//            connects instead, e.g. to a zmq_proxy frontend
+// --report=EP  PULL endpoint the subscribers report to (default tcp://*:5557)
 
 #include <zmq.hpp>
+#include <algorithm>
 #include <chrono>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <thread>
 #include <vector>
 #include <string>
 
+#include "../common/clock.hpp"
+#include "../common/stats.hpp"
+#include "pingpong.hpp"
+#include "pubsub.hpp"
+
 using namespace std;
-using ns = chrono::nanoseconds;
-using clk = chrono::high_resolution_clock;
+using pubsub::clk;
+using pubsub::now_ns;
+
+constexpr int DEFAULT_TOPICS = 8;
+constexpr int DEFAULT_HWM = 1000;       // libzmq's own default
+constexpr int CONTROL_INTERVAL_MS = 100; // SYNC / END! resend period
+constexpr int SYNC_RETRIES = 100;
+constexpr int REPORT_RETRIES = 50;
+
+static void send_control(zmq::socket_t& pub, const char* topic) {
+    pub.send(zmq::buffer(topic, TOPIC_LEN), zmq::send_flags::none);
+}
+
+// One subscriber's PubSubReport, its per-topic entries and its latency
+// histogram
+struct SubscriberResult {
+    PubSubReport report;
+    vector<TopicReport> topics;
+    pubsub::Histogram latency_ns;
+};
+
+static int run_pubsub(int count, size_t subscribers, int topics, int hwm, uint64_t interval_ns,
+                      const string& data_ep, bool connect, const string& report_ep) {
+    zmq::context_t ctx{1};
+    zmq::socket_t pub(ctx, zmq::socket_type::pub);
+    pub.set(zmq::sockopt::sndhwm, hwm);
+    pub.set(zmq::sockopt::linger, 0);
+    if (connect) pub.connect(data_ep);
+    else pub.bind(data_ep);
+
+    zmq::socket_t reports(ctx, zmq::socket_type::pull);
+    reports.set(zmq::sockopt::rcvtimeo, CONTROL_INTERVAL_MS);
+    reports.set(zmq::sockopt::linger, 0);
+    reports.bind(report_ep);
+
+    // Subscriptions reach PUB asynchronously ("slow joiner"): anything sent
+    // before they arrive is silently dropped, so wait until all answer SYNC
+    set<uint64_t> ready;
+    for (int attempt = 0; ready.size() < subscribers && attempt < SYNC_RETRIES; ++attempt) {
+        send_control(pub, SYNC_TOPIC);
+        zmq::message_t msg;
+        while (ready.size() < subscribers && reports.recv(msg)) {
+            Ready r;
+            if (msg.size() != sizeof(r)) continue;
+            memcpy(&r, msg.data(), sizeof(r));
+            if (r.kind == ReportKind::Ready) ready.insert(r.id);
+        }
+    }
+    if (ready.size() < subscribers) {
+        cerr << "Only " << ready.size() << " of " << subscribers << " subscribers answered SYNC\n";
+        return 1;
+    }
+
+    vector<uint64_t> seqs(topics, 0);
+    vector<string> names;
+    for (int t = 0; t < topics; ++t) names.push_back(topic_name(t));
+    char frame[DATA_FRAME];
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < count; ++i) {
+        int t = i % topics;
+        if (interval_ns) {
+            uint64_t due = start + i * interval_ns;
+            while (now_ns() < due) { /* busy-wait: pacing without sleep jitter */ }
+        }
+        TopicMsg m{seqs[t]++, now_ns()};
+        memcpy(frame, names[t].data(), TOPIC_LEN);
+        memcpy(frame + TOPIC_LEN, &m, sizeof(m));
+        pub.send(zmq::buffer(frame, sizeof(frame)), zmq::send_flags::none);
+    }
+    double send_s = (now_ns() - start) / 1e9;
+
+    // END! may itself be dropped at a full subscriber queue, so repeat it
+    map<uint64_t, SubscriberResult> results;
+    for (int attempt = 0; results.size() < subscribers && attempt < REPORT_RETRIES; ++attempt) {
+        send_control(pub, END_TOPIC);
+        zmq::message_t msg;
+        while (results.size() < subscribers && reports.recv(msg)) {
+            SubscriberResult r;
+            if (msg.size() < sizeof(r.report)) continue;
+            memcpy(&r.report, msg.data(), sizeof(r.report));
+            size_t entries = sizeof(r.report) + r.report.topics * sizeof(TopicReport);
+            if (r.report.kind != ReportKind::Report || msg.size() < entries) continue;
+            r.topics.resize(r.report.topics);
+            memcpy(r.topics.data(), msg.data<char>() + sizeof(r.report), r.topics.size() * sizeof(TopicReport));
+            if (r.latency_ns.decode_add(msg.data<char>() + entries, msg.size() - entries) != msg.size() - entries) {
+                continue;
+            }
+            results[r.report.id] = move(r);
+        }
+    }
+    if (results.size() < subscribers) {
+        cerr << "Only " << results.size() << " of " << subscribers << " subscribers reported\n";
+    }
+
+    // Per topic, over the subscribers that received it
+    struct TopicTotals {
+        size_t subscribers = 0;
+        uint64_t received = 0, drops = 0, p50_sum = 0, worst_p99 = 0;
+    };
+    vector<TopicTotals> per_topic(topics);
+    uint64_t total_received = 0, total_drops = 0, max_drops = 0, worst_p99 = 0;
+    double recv_pps_sum = 0, p50_sum = 0;
+    pubsub::Histogram merged_ns; // Every message to every subscriber
+    for (const auto& entry : results) {
+        const SubscriberResult& r = entry.second;
+        uint64_t drops = 0;
+        for (const TopicReport& tr : r.topics) {
+            if (tr.topic >= (uint64_t)topics) continue;
+            // Gaps inside the stream plus whatever never arrived after the last one
+            uint64_t topic_drops = tr.gaps + (seqs[tr.topic] - tr.next_seq);
+            drops += topic_drops;
+            TopicTotals& tt = per_topic[tr.topic];
+            ++tt.subscribers;
+            tt.received += tr.received;
+            tt.drops += topic_drops;
+            tt.p50_sum += tr.p50_ns;
+            tt.worst_p99 = max(tt.worst_p99, tr.p99_ns);
+        }
+        double recv_pps = r.report.elapsed_ns ? r.report.received * 1e9 / r.report.elapsed_ns : 0;
+        cout << "ZeroMQ pubsub subscriber=" << r.report.id
+             << " topics=" << r.topics.size()
+             << " received=" << r.report.received
+             << " drops=" << drops
+             << " recv_pps=" << recv_pps
+             << " p50_one_way_us=" << r.report.p50_ns / 1000.0
+             << " p99_one_way_us=" << r.report.p99_ns / 1000.0
+             << " p9999_one_way_us=" << r.latency_ns.value_at_percentile(99.99) / 1000.0
+             << " max_one_way_us=" << r.report.max_ns / 1000.0 << "\n";
+        merged_ns.add(r.latency_ns);
+        total_received += r.report.received;
+        total_drops += drops;
+        max_drops = max(max_drops, drops);
+        worst_p99 = max(worst_p99, r.report.p99_ns);
+        recv_pps_sum += recv_pps;
+        p50_sum += r.report.p50_ns / 1000.0;
+    }
+    for (int t = 0; t < topics; ++t) {
+        const TopicTotals& tt = per_topic[t];
+        if (!tt.subscribers) continue;
+        cout << "ZeroMQ pubsub topic=" << names[t]
+             << " subscribers=" << tt.subscribers
+             << " received=" << tt.received
+             << " drops=" << tt.drops
+             << " avg_p50_one_way_us=" << tt.p50_sum / 1000.0 / tt.subscribers
+             << " worst_p99_one_way_us=" << tt.worst_p99 / 1000.0 << "\n";
+    }
+
+    size_t n = max<size_t>(results.size(), 1);
+    cout << "ZeroMQ pubsub mode=" << (connect ? "proxy" : "direct")
+         << " subscribers=" << subscribers
+         << " reports=" << results.size()
+         << " topics=" << topics
+         << " hwm=" << hwm
+         << " count=" << count
+         << " sent_pps=" << (send_s > 0 ? count / send_s : 0)
+         << " avg_recv_pps=" << recv_pps_sum / n
+         << " avg_p50_one_way_us=" << p50_sum / n
+         << " worst_p99_one_way_us=" << worst_p99 / 1000.0
+         << " merged_p50_one_way_us=" << merged_ns.value_at_percentile(50) / 1000.0
+         << " merged_p99_one_way_us=" << merged_ns.value_at_percentile(99) / 1000.0
+         << " merged_p9999_one_way_us=" << merged_ns.value_at_percentile(99.99) / 1000.0
+         << " merged_max_one_way_us=" << merged_ns.max() / 1000.0
+         << " total_received=" << total_received
+         << " total_drops=" << total_drops
+         << " max_drops=" << max_drops << "\n";
+    return 0;
+}
+
+static int run_window(int count, int window, size_t payload, const string& endpoint, bool zero_copy,
+                      const ContextOptions& ctx_opts) {
+    // Declared before the context so it outlives any message libzmq still
+    // holds: their free function writes into the pool
+    optional<MessagePool> pool;
+    if (zero_copy) {
+        pool.emplace(payload, MessagePool::buffers_for(payload, max<size_t>(POOL_BUFFERS, 2 * window)));
+    }
+    zmq::context_t ctx{ctx_opts.io_threads};
+    ctx_opts.apply(ctx);
+    zmq::socket_t sock(ctx, zmq::socket_type::dealer);
+    ctx_opts.apply(sock);
+    // The window, not the HWM, bounds what is queued
+    sock.set(zmq::sockopt::sndhwm, 0);
+    sock.set(zmq::sockopt::rcvhwm, 0);
+    sock.set(zmq::sockopt::linger, 0);
+    
+    bool inproc = endpoint.rfind("inproc://", 0) == 0;
+    zmq::socket_t echo_sock;
+    thread echo_thread;
+    if (inproc) {
+        echo_sock = zmq::socket_t(ctx, zmq::socket_type::router);
+        echo_sock.set(zmq::sockopt::sndhwm, 0);
+        echo_sock.set(zmq::sockopt::rcvhwm, 0);
+        echo_sock.bind(endpoint);
+        echo_thread = thread([&echo_sock, zero_copy] { router_echo_loop(echo_sock, zero_copy); });
+    }
+    sock.connect(endpoint);
+    
+    // Send time per sequence number; a reply's first 8 bytes say which one
+    vector<uint64_t> sent_ns(count);
+    pubsub::Histogram rtts;
+    vector<char> request(payload, 'x');
+    uint64_t pool_misses = 0, out_of_order = 0;
+    
+    cout << "ZeroMQ publisher sending " << count << " messages, window " << window << "...\n";
+    
+    uint64_t sent = 0, next_expected = 0;
+    auto start = clk::now();
+    while (rtts.count() < (uint64_t)count) {
+        while (sent < (uint64_t)count && sent - rtts.count() < (uint64_t)window) {
+            zmq::message_t msg;
+            if (pool && pool->wrap(msg, payload)) {
+                memcpy(msg.data(), &sent, sizeof(sent));
+            } else {
+                pool_misses += zero_copy;
+                memcpy(request.data(), &sent, sizeof(sent));
+                msg = zmq::message_t(request.data(), payload);
+            }
+            sent_ns[sent] = now_ns();
+            sock.send(msg, zmq::send_flags::none);
+            ++sent;
+        }
+        
+        zmq::message_t reply;
+        sock.recv(reply);
+        uint64_t now = now_ns();
+        uint64_t seq;
+        if (reply.size() < sizeof(seq)) continue;
+        memcpy(&seq, reply.data(), sizeof(seq));
+        if (seq >= sent) continue;
+        if (seq != next_expected) ++out_of_order;
+        next_expected = seq + 1;
+        rtts.record(now - sent_ns[seq]);
+    }
+    double elapsed_s = chrono::duration<double>(clk::now() - start).count();
+    
+    if (inproc) {
+        sock.close();
+        ctx.shutdown();
+        echo_thread.join();
+        echo_sock.close();
+    }
+    
+    pubsub::LatencySummary rtt = pubsub::summarize(rtts);
+    cout << "ZeroMQ window endpoint=" << endpoint
+         << " payload=" << payload
+         << " zero_copy=" << (zero_copy ? 1 : 0)
+         << " window=" << window
+         << " count=" << rtt.count
+         << " msgs_per_sec=" << rtt.count / elapsed_s
+         << " p50_RTT_us=" << rtt.p50_us
+         << " p99_RTT_us=" << rtt.p99_us
+         << " p999_RTT_us=" << rtt.p999_us
+         << " p9999_RTT_us=" << rtt.p9999_us
+         << " max_RTT_us=" << rtt.max_us
+         << " out_of_order=" << out_of_order
+         << " pool_misses=" << pool_misses << "\n";
+    return 0;
+}
+
+static void print_usage(const char* prog) {
+    cerr << "Usage: " << prog << " <count> [--payload=N] [--endpoint=EP] [--zero-copy] [--io-threads=N]"
+         << " [--io-cpus=A,B] [--affinity=MASK]\n"
+         << "       " << prog << " <count> --window=N [--payload=N] [--endpoint=EP] [--zero-copy] ...\n"
+         << "       " << prog << " <count> --pubsub [--subscribers=N] [--topics=N] [--hwm=N]"
+         << " [--interval-us=N] [--bind=EP | --connect=EP] [--report=EP]\n";
+}
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <count>\n";
+        print_usage(argv[0]);
         return 1;
     }
     
     int count = stoi(argv[1]);
+    bool pubsub = false;
+    size_t subscribers = 1;
+    int topics = DEFAULT_TOPICS;
+    int hwm = DEFAULT_HWM;
+    uint64_t interval_us = 0;
+    string data_ep = DEFAULT_DATA_BIND;
+    bool connect = false;
+    string report_ep = DEFAULT_REPORT_BIND;
+    size_t payload = MIN_PAYLOAD;
+    string endpoint = DEFAULT_PINGPONG_CONNECT;
+    bool zero_copy = false;
+    int window = 0;
+    ContextOptions ctx_opts;
+    for (int a = 2; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "--pubsub") pubsub = true;
+        else if (ctx_opts.parse(arg)) continue;
+        else if (arg.rfind("--payload=", 0) == 0) payload = min(max<size_t>(MIN_PAYLOAD, stoul(arg.substr(10))), MAX_PAYLOAD);
+        else if (arg.rfind("--endpoint=", 0) == 0) endpoint = arg.substr(11);
+        else if (arg == "--zero-copy") zero_copy = true;
+        else if (arg.rfind("--window=", 0) == 0) window = min(max(1, stoi(arg.substr(9))), MAX_WINDOW);
+        else if (arg.rfind("--subscribers=", 0) == 0) subscribers = max<size_t>(1, stoul(arg.substr(14)));
+        else if (arg.rfind("--topics=", 0) == 0) topics = min(max(1, stoi(arg.substr(9))), MAX_TOPICS);
+        else if (arg.rfind("--hwm=", 0) == 0) hwm = max(0, stoi(arg.substr(6)));
+        else if (arg.rfind("--interval-us=", 0) == 0) interval_us = stoull(arg.substr(14));
+        else if (arg.rfind("--bind=", 0) == 0) data_ep = arg.substr(7), connect = false;
+        else if (arg.rfind("--connect=", 0) == 0) data_ep = arg.substr(10), connect = true;
+        else if (arg.rfind("--report=", 0) == 0) report_ep = arg.substr(9);
+        else {
+            cerr << "Unknown option " << arg << "\n";
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (pubsub) return run_pubsub(count, subscribers, topics, hwm, interval_us * 1000, data_ep, connect, report_ep);
+    if (window) return run_window(count, window, payload, endpoint, zero_copy, ctx_opts);
     
+    // Before the context, as in run_window
+    optional<MessagePool> pool;
+    if (zero_copy) pool.emplace(payload, MessagePool::buffers_for(payload, POOL_BUFFERS));
+
     // Create ZeroMQ context and socket
-    zmq::context_t ctx{1};
+    zmq::context_t ctx{ctx_opts.io_threads};
+    ctx_opts.apply(ctx);
     zmq::socket_t sock(ctx, zmq::socket_type::req);
+    ctx_opts.apply(sock);
+    
+    // inproc only reaches sockets of the same context: echo from a thread
+    bool inproc = endpoint.rfind("inproc://", 0) == 0;
+    zmq::socket_t echo_sock;
+    thread echo_thread;
+    if (inproc) {
+        echo_sock = zmq::socket_t(ctx, zmq::socket_type::rep);
+        echo_sock.bind(endpoint);
+        echo_thread = thread([&echo_sock, zero_copy] { echo_loop(echo_sock, zero_copy); });
+    }
     
     // Connect to subscriber
-    sock.connect("tcp://127.0.0.1:5556");
+    sock.connect(endpoint);
     
-    vector<double> rtts;
-    rtts.reserve(count);
+    pubsub::Histogram rtts;
+    // Without --zero-copy the request is built here and copied into each message
+    vector<char> request(payload, 'x');
+    uint64_t pool_misses = 0;
     
     cout << "ZeroMQ publisher sending " << count << " messages...\n";
     
+    auto start = clk::now();
     for (int i = 0; i < count; ++i) {
         // Record send time
-        auto send_time = clk::now();
-        long send_ts = chrono::duration_cast<ns>(send_time.time_since_epoch()).count();
+        uint64_t send_ts = now_ns();
         
         // Create and send message
-        zmq::message_t msg(sizeof(long));
-        memcpy(msg.data(), &send_ts, sizeof(send_ts));
+        zmq::message_t msg;
+        if (pool && pool->wrap(msg, payload)) {
+            memcpy(msg.data(), &send_ts, sizeof(send_ts));
+        } else {
+            pool_misses += zero_copy;
+            memcpy(request.data(), &send_ts, sizeof(send_ts));
+            msg = zmq::message_t(request.data(), payload);
+        }
         sock.send(msg, zmq::send_flags::none);
         
         // Receive reply
         zmq::message_t reply;
         sock.recv(reply);
         
-        // Calculate RTT
-        auto recv_time = clk::now();
-        auto rtt_duration = recv_time - send_time;
-        double rtt_us = chrono::duration_cast<chrono::microseconds>(rtt_duration).count();
-        rtts.push_back(rtt_us);
+        // Calculate RTT in ns; the reply's first 8 bytes are the subscriber's echo time
+        rtts.record(now_ns() - send_ts);
+    }
+    double elapsed_s = chrono::duration<double>(clk::now() - start).count();
+    
+    if (inproc) {
+        sock.close();
+        ctx.shutdown(); // Wakes the echo thread with ETERM
+        echo_thread.join();
+        echo_sock.close();
     }
     
     // Calculate statistics
-    double sum = 0;
-    for (double rtt : rtts) sum += rtt;
-    double avg = sum / rtts.size();
-    
-    // Sort for percentiles
-    sort(rtts.begin(), rtts.end());
-    double median = rtts[rtts.size() / 2];
-    double p95 = rtts[static_cast<size_t>(rtts.size() * 0.95)];
-    double p99 = rtts[static_cast<size_t>(rtts.size() * 0.99)];
-    
-    cout << "ZeroMQ ping-pong count=" << rtts.size() 
-         << " avg_RTT_us=" << avg 
-         << " median_RTT_us=" << median
-         << " p95_RTT_us=" << p95
-         << " p99_RTT_us=" << p99
-         << " avg_one_way_us=" << (avg/2.0) << "\n";
+    uint64_t replies = rtts.count();
+    cout << "ZeroMQ ping-pong endpoint=" << endpoint
+         << " payload=" << payload
+         << " zero_copy=" << (zero_copy ? 1 : 0)
+         << " io_threads=" << ctx_opts.io_threads;
+    pubsub::print_rtt_fields(cout, pubsub::summarize(rtts));
+    cout << " msgs_per_sec=" << replies / elapsed_s
+         << " pool_misses=" << pool_misses << "\n";
     
     return 0;
 }
@@ -1,41 +1,217 @@
-// Usage: ./zmq_subscriber
+// Usage: ./zmq_subscriber [--router] [--endpoint=EP] [--zero-copy] [--io-threads=N] [--io-cpus=A,B]
+//                         [--affinity=MASK]
+//        ./zmq_subscriber --pubsub [--subscribe=P1,P2,...] [--hwm=N] [--conflate] [--slow-us=N]
+//                         [--connect=EP] [--report=EP]
 // ZeroMQ REQ-REP ping-pong latency test - subscriber (REP socket)
+//
+// --endpoint=EP  bind here (default tcp://*:5556; ipc://path also works)
+// --zero-copy  send each request back as the reply instead of copying it
+//            (see echo_loop() in pingpong.hpp)
+// --io-threads=N, --io-cpus=A,B, --affinity=MASK  as for zmq_publisher
+// --router   ROUTER instead of REP, for zmq_publisher --window=N: echo each
+//            request unchanged to its sender without waiting in lock-step
+//
+// --pubsub   SUB side of the PUB/SUB fan-out (see pubsub.hpp): record one-way
+//            latency and sequence gaps per topic and, on END!, report them to
+//            the publisher
+// --subscribe=P1,P2  topic prefixes to subscribe to (default: all topics)
+// --hwm=N    ZMQ_RCVHWM (default 1000)
+// --conflate ZMQ_CONFLATE: keep only the newest message, e.g. a price feed
+//            where stale values are worthless
+// --slow-us=N  spend N µs on each message, to play the slow subscriber
+// --connect=EP  data endpoint (default tcp://127.0.0.1:5556, or a zmq_proxy
+//            backend); --report=EP is the publisher's report endpoint
+//            (default tcp://127.0.0.1:5557)
 
 #include <zmq.hpp>
-#include <chrono>
+#include <unistd.h>
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../common/clock.hpp"
+#include "../common/histogram.hpp"
+#include "pingpong.hpp"
+#include "pubsub.hpp"
 
 using namespace std;
-using ns = chrono::nanoseconds;
-using clk = chrono::high_resolution_clock;
+using pubsub::now_ns;
 
-int main(int argc, char** argv) {
-    // Create ZeroMQ context and socket
+constexpr int DEFAULT_HWM = 1000; // libzmq's own default
+constexpr int TOPIC_SIGNIFICANT_DIGITS = 2; // Per-topic histograms: ~30 KiB each instead of ~220 KiB
+
+struct TopicState {
+    uint64_t received = 0, gaps = 0, next_seq = 0;
+    unique_ptr<pubsub::Histogram> latency_ns; // Allocated on the topic's first message
+};
+
+static int run_pubsub(const vector<string>& prefixes, int hwm, bool conflate, uint64_t slow_ns,
+                      const string& data_ep, const string& report_ep) {
     zmq::context_t ctx{1};
-    zmq::socket_t sock(ctx, zmq::socket_type::rep);
-    
-    // Bind to port 5556
-    sock.bind("tcp://*:5556");
-    
-    cout << "ZeroMQ subscriber listening on tcp://*:5556\n";
-    
+    zmq::socket_t sub(ctx, zmq::socket_type::sub);
+    if (conflate) {
+        // Subscriptions travel on the socket's outbound queue, which conflates
+        // too: only the last one would reach the publisher. Take everything
+        // and filter below instead.
+        sub.set(zmq::sockopt::conflate, 1);
+        sub.set(zmq::sockopt::subscribe, "");
+    } else {
+        sub.set(zmq::sockopt::rcvhwm, hwm);
+        for (const string& prefix : prefixes) sub.set(zmq::sockopt::subscribe, prefix);
+        sub.set(zmq::sockopt::subscribe, SYNC_TOPIC);
+        sub.set(zmq::sockopt::subscribe, END_TOPIC);
+    }
+    sub.connect(data_ep);
+    auto subscribed = [&](const char* frame) {
+        for (const string& prefix : prefixes) {
+            if (memcmp(frame, prefix.data(), min(prefix.size(), TOPIC_LEN)) == 0) return true;
+        }
+        return false;
+    };
+
+    zmq::socket_t reports(ctx, zmq::socket_type::push);
+    reports.set(zmq::sockopt::linger, 0);
+    reports.connect(report_ep);
+
+    cout << "ZeroMQ subscriber (pubsub) connected to " << data_ep << " prefixes=" << prefixes.size()
+         << (conflate ? " conflate" : "") << " slow_us=" << slow_ns / 1000 << "\n";
+    cout.flush();
+
+    const Ready ready{ReportKind::Ready, (uint64_t)getpid()};
+    vector<TopicState> topics(MAX_TOPICS);
+    pubsub::Histogram all_ns;
+    uint64_t received = 0, first_ns = 0, last_ns = 0;
+    vector<char> last_report;
+
     while (true) {
-        // Receive message
         zmq::message_t msg;
-        sock.recv(msg);
-        
-        // Extract timestamp from message
-        long send_ts;
-        memcpy(&send_ts, msg.data(), sizeof(send_ts));
-        
-        // Update timestamp to current time (echo)
-        long echo_ts = chrono::duration_cast<ns>(clk::now().time_since_epoch()).count();
-        
-        // Send echo back
-        zmq::message_t reply(sizeof(long));
-        memcpy(reply.data(), &echo_ts, sizeof(echo_ts));
-        sock.send(reply, zmq::send_flags::none);
+        if (!sub.recv(msg)) continue;
+        uint64_t now = now_ns();
+        if (msg.size() < TOPIC_LEN) continue;
+        const char* frame = msg.data<char>();
+
+        int t = topic_index(frame);
+        if (t >= 0 && msg.size() == DATA_FRAME) {
+            if (conflate && !subscribed(frame)) continue;
+            TopicMsg m;
+            memcpy(&m, frame + TOPIC_LEN, sizeof(m));
+            TopicState& ts = topics[t];
+            if (m.seq > ts.next_seq) ts.gaps += m.seq - ts.next_seq;
+            ts.next_seq = max(ts.next_seq, m.seq + 1);
+            ++ts.received;
+            if (!ts.latency_ns) {
+                ts.latency_ns.reset(new pubsub::Histogram(pubsub::DEFAULT_HIGHEST_NS, TOPIC_SIGNIFICANT_DIGITS));
+            }
+            uint64_t latency = now > m.t_ns ? now - m.t_ns : 0;
+            ts.latency_ns->record(latency);
+            all_ns.record(latency);
+            if (received++ == 0) first_ns = now;
+            last_ns = now;
+            if (slow_ns) {
+                while (now_ns() - now < slow_ns) { /* busy-wait: simulated per-message work */ }
+            }
+            continue;
+        }
+
+        if (memcmp(frame, SYNC_TOPIC, TOPIC_LEN) == 0) {
+            reports.send(zmq::buffer(&ready, sizeof(ready)), zmq::send_flags::none);
+        } else if (memcmp(frame, END_TOPIC, TOPIC_LEN) == 0) {
+            // Repeated END! markers (the publisher retries) get the same report
+            if (received > 0 || last_report.empty()) {
+                PubSubReport report{ReportKind::Report, (uint64_t)getpid(), received, 0, last_ns - first_ns, 0, 0, 0, 0};
+                vector<TopicReport> entries;
+                for (int i = 0; i < MAX_TOPICS; ++i) {
+                    TopicState& ts = topics[i];
+                    if (!ts.received) continue;
+                    report.gaps += ts.gaps;
+                    entries.push_back({(uint64_t)i, ts.received, ts.gaps, ts.next_seq,
+                                       ts.latency_ns->value_at_percentile(50), ts.latency_ns->value_at_percentile(99)});
+                    ts.received = ts.gaps = ts.next_seq = 0;
+                    ts.latency_ns->reset();
+                }
+                report.p50_ns = all_ns.value_at_percentile(50);
+                report.p99_ns = all_ns.value_at_percentile(99);
+                report.max_ns = all_ns.max();
+                report.topics = entries.size();
+
+                last_report.resize(sizeof(report) + entries.size() * sizeof(TopicReport));
+                memcpy(last_report.data(), &report, sizeof(report));
+                if (!entries.empty()) {
+                    memcpy(last_report.data() + sizeof(report), entries.data(), entries.size() * sizeof(TopicReport));
+                }
+                all_ns.encode(last_report);
+                all_ns.reset();
+                received = 0;
+            }
+            reports.send(zmq::buffer(last_report.data(), last_report.size()), zmq::send_flags::none);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    bool pubsub = false;
+    vector<string> prefixes;
+    int hwm = DEFAULT_HWM;
+    bool conflate = false;
+    uint64_t slow_us = 0;
+    string data_ep = DEFAULT_DATA_CONNECT;
+    string report_ep = DEFAULT_REPORT_CONNECT;
+    string endpoint = DEFAULT_PINGPONG_BIND;
+    bool zero_copy = false;
+    bool router = false;
+    ContextOptions ctx_opts;
+    for (int a = 1; a < argc; ++a) {
+        string arg = argv[a];
+        if (arg == "--pubsub") pubsub = true;
+        else if (ctx_opts.parse(arg)) continue;
+        else if (arg.rfind("--endpoint=", 0) == 0) endpoint = arg.substr(11);
+        else if (arg == "--zero-copy") zero_copy = true;
+        else if (arg == "--router") router = true;
+        else if (arg.rfind("--subscribe=", 0) == 0) {
+            stringstream list(arg.substr(12));
+            string prefix;
+            while (getline(list, prefix, ',')) prefixes.push_back(prefix);
+        }
+        else if (arg.rfind("--hwm=", 0) == 0) hwm = max(0, stoi(arg.substr(6)));
+        else if (arg == "--conflate") conflate = true;
+        else if (arg.rfind("--slow-us=", 0) == 0) slow_us = stoull(arg.substr(10));
+        else if (arg.rfind("--connect=", 0) == 0) data_ep = arg.substr(10);
+        else if (arg.rfind("--report=", 0) == 0) report_ep = arg.substr(9);
+        else {
+            cerr << "Usage: " << argv[0] << " [--router] [--endpoint=EP] [--zero-copy] [--io-threads=N]"
+                 << " [--io-cpus=A,B] [--affinity=MASK]\n"
+                 << "       " << argv[0] << " --pubsub [--subscribe=P1,P2,...] [--hwm=N] [--conflate]"
+                 << " [--slow-us=N] [--connect=EP] [--report=EP]\n";
+            return 1;
+        }
     }
+    if (pubsub) {
+        // Default: every data topic (they all start with 't')
+        if (prefixes.empty()) prefixes.push_back("t");
+        return run_pubsub(prefixes, hwm, conflate, slow_us * 1000, data_ep, report_ep);
+    }
+
+    // Create ZeroMQ context and socket
+    zmq::context_t ctx{ctx_opts.io_threads};
+    ctx_opts.apply(ctx);
+    zmq::socket_t sock(ctx, router ? zmq::socket_type::router : zmq::socket_type::rep);
+    ctx_opts.apply(sock);
+    if (router) {
+        // The publisher's window bounds what is queued
+        sock.set(zmq::sockopt::sndhwm, 0);
+        sock.set(zmq::sockopt::rcvhwm, 0);
+    }
+    
+    sock.bind(endpoint);
+    
+    cout << "ZeroMQ subscriber listening on " << endpoint << (router ? " router" : "")
+         << (zero_copy ? " zero_copy" : "") << "\n";
+    cout.flush();
     
+    if (router) router_echo_loop(sock, zero_copy);
+    else echo_loop(sock, zero_copy);
     return 0;
 }